@@ -0,0 +1,405 @@
+//  ********************************************************************
+//  This file is part of GTS (Good Transcript Selector).
+//
+//  GTS is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Portculis is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with GTS.  If not, see <http://www.gnu.org/licenses/>.
+//  *******************************************************************
+
+#pragma once
+
+#include <stdio.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+
+#include <boost/exception/all.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/timer/timer.hpp>
+using boost::make_shared;
+using boost::shared_ptr;
+using boost::timer::auto_cpu_timer;
+
+#include "io/binary.hpp"
+#include "io/mapped_file.hpp"
+#include "gff.hpp"
+#include "fln.hpp"
+using gts::io::BinaryReader;
+using gts::io::BinaryWriter;
+using gts::io::MappedFile;
+using gts::io::MappedFilePtr;
+using gts::gff::GFF;
+using gts::gff::GFFArena;
+using gts::gff::GFFList;
+using gts::gff::GFFModel;
+using gts::gff::GFFModelPtr;
+using gts::gff::GFFPtr;
+
+namespace gts {
+
+const char CACHE_MAGIC[8] = { 'G', 'T', 'S', 'C', 'A', 'C', 'H', 'E' };
+
+// Bump whenever the layout of any cached structure changes
+const uint32_t CACHE_VERSION = 6;
+
+// Amount of data hashed from each end of a source file
+const size_t CACHE_HASH_SAMPLE = 1 << 20;
+
+inline uint64_t fnv1a(const char* data, size_t size, uint64_t hash) {
+
+    for(size_t i = 0; i < size; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+
+/**
+ * Identifies the version of a source file that a cache was built from.
+ * Hashing all of a multi GB input would take about as long as parsing it, so
+ * only the first and last MB are hashed.  Together with the size and
+ * modification time this catches any realistic change to the file.
+ */
+struct SourceFingerprint {
+
+    uint64_t size;
+    int64_t mtime;
+    uint64_t hash;
+
+    SourceFingerprint() : size(0), mtime(0), hash(0) {}
+
+    SourceFingerprint(const string& path) {
+
+        size = boost::filesystem::file_size(path);
+        mtime = boost::filesystem::last_write_time(path);
+
+        MappedFile file(path);
+        const char* b = file.begin();
+        const char* e = file.end();
+
+        if (file.GetSize() <= 2 * CACHE_HASH_SAMPLE) {
+            hash = fnv1a(b, file.GetSize(), FNV_OFFSET_BASIS);
+        }
+        else {
+            hash = fnv1a(b, CACHE_HASH_SAMPLE, FNV_OFFSET_BASIS);
+            hash = fnv1a(e - CACHE_HASH_SAMPLE, CACHE_HASH_SAMPLE, hash);
+        }
+    }
+
+    bool operator==(const SourceFingerprint& other) const {
+        return size == other.size && mtime == other.mtime && hash == other.hash;
+    }
+
+    void write(BinaryWriter& out) const {
+        out.put<uint64_t>(size);
+        out.put<int64_t>(mtime);
+        out.put<uint64_t>(hash);
+    }
+
+    void read(BinaryReader& in) {
+        size = in.get<uint64_t>();
+        mtime = in.get<int64_t>();
+        hash = in.get<uint64_t>();
+    }
+};
+
+/**
+ * Binary cache of parsed input files.  The first time a file is loaded the
+ * parsed structures are serialised into the cache directory.  Subsequent loads
+ * of the same, unmodified, file memory map the cache and rebuild the
+ * structures directly, skipping text parsing entirely.  Stale or corrupt
+ * cache files are ignored and rewritten.
+ */
+class InputCache {
+
+private:
+
+    string dir;
+
+public:
+
+    InputCache(const string& dir) : dir(dir) {
+        boost::filesystem::create_directories(dir);
+    }
+
+    virtual ~InputCache() {}
+
+    string GetDir() const {
+        return dir;
+    }
+
+    /**
+     * Returns the linked gene model for the GFF3 file at path
+     */
+    GFFModelPtr loadGFFModel(const string& path, uint16_t threads) {
+
+        ParseLog ignored;
+        GFFModelPtr geneModel = loadGFFModel(path, threads, ignored, false);
+        ignored.report(cerr);
+
+        return geneModel;
+    }
+
+    /**
+     * As above, but counts skipped records in log as GFFModel::load does.
+     * Records skipped on the first load aren't counted again when the model
+     * comes from the cache.  Lenient loads are cached apart from strict ones,
+     * so a strict run never silently picks up a model with records missing.
+     */
+    GFFModelPtr loadGFFModel(const string& path, uint16_t threads, ParseLog& log, bool lenient) {
+        return loadGFFModel(path, threads, log, lenient, GFFModel::DEFAULT_MAX_ORPHANS);
+    }
+
+    /**
+     * As above, but holding back no more than maxOrphans records at once, see
+     * GFFModel::load.  A model read from the cache gets the same limit.  A
+     * cache file that can't be read back, for whatever reason, is ignored and
+     * the model is rebuilt from scratch.
+     */
+    GFFModelPtr loadGFFModel(const string& path, uint16_t threads, ParseLog& log, bool lenient, size_t maxOrphans) {
+
+        SourceFingerprint fingerprint(path);
+        const string cachePath = getCachePath(path, lenient ? "model-lenient" : "model");
+
+        {
+            MappedFilePtr file;
+            BinaryReader in;
+
+            if (open(cachePath, fingerprint, file, in)) {
+
+                try {
+                    auto_cpu_timer timer(1, " = Wall time taken: %ws\n");
+                    GFFModelPtr geneModel = GFFModel::readBinary(in, file);
+                    geneModel->setMaxOrphans(maxOrphans);
+                    cout << " - Found " << geneModel->getNbGenes() << " genes and " << geneModel->getTotalNbTranscripts() << " transcripts" << endl;
+                    return geneModel;
+                }
+                catch(std::exception& e) {
+                    // A truncated or stale cache can fail anywhere in reading
+                    // or linking, the partly built model is simply dropped
+                    cerr << "Ignoring corrupt cache file: " << cachePath << endl;
+                }
+            }
+        }
+
+        GFFModelPtr geneModel = GFFModel::load(path, threads, log, lenient, maxOrphans);
+
+        BinaryWriter out;
+        writeHeader(out, fingerprint);
+        geneModel->writeBinary(out);
+        save(cachePath, out);
+
+        return geneModel;
+    }
+
+    /**
+     * Loads only the transcript records from the GTF file at path, which is
+     * all GTS needs from the GTF, into arena
+     */
+    void loadGTFTranscripts(const string& path, GFFList& transcripts, GFFArena& arena, uint16_t threads) {
+        loadGTFTranscripts(path, transcripts, arena, threads, NULL);
+    }
+
+    /**
+     * As above, but leniently if a log is given, see GFF::load
+     */
+    void loadGTFTranscripts(const string& path, GFFList& transcripts, GFFArena& arena, uint16_t threads, ParseLog* log) {
+
+        SourceFingerprint fingerprint(path);
+        const string cachePath = getCachePath(path, log ? "transcripts-lenient" : "transcripts");
+
+        {
+            MappedFilePtr file;
+            BinaryReader in;
+
+            if (open(cachePath, fingerprint, file, in)) {
+
+                try {
+                    auto_cpu_timer timer(1, " = Wall time taken: %ws\n");
+                    GFFList cached;
+                    // Read into an arena of our own, so that nothing is left
+                    // behind in arena if the cache turns out to be corrupt.
+                    // Records point at their lines in the cache.
+                    GFFArena read;
+                    read.keep(file);
+                    const size_t nbTranscripts = in.getVarint();
+                    cached.reserve(nbTranscripts);
+                    for(size_t i = 0; i < nbTranscripts; i++) {
+                        cached.push_back(GFF::readBinary(in, read));
+                    }
+                    arena.adopt(read);
+                    transcripts.insert(transcripts.end(), cached.begin(), cached.end());
+                    cout << " - Loaded " << cached.size() << " transcripts" << endl;
+                    return;
+                }
+                catch(std::exception& e) {
+                    cerr << "Ignoring corrupt cache file: " << cachePath << endl;
+                }
+            }
+        }
+
+        GFFList loaded;
+        GFF::load(gts::gff::GTF, path, loaded, arena, gts::gff::TRANSCRIPT, threads, log);
+
+        BinaryWriter out;
+        writeHeader(out, fingerprint);
+        out.putVarint(loaded.size());
+        BOOST_FOREACH(GFFPtr gff, loaded) {
+            gff->writeBinary(out);
+        }
+        save(cachePath, out);
+
+        transcripts.insert(transcripts.end(), loaded.begin(), loaded.end());
+    }
+
+    void loadDBAnnots(const string& path, vector< shared_ptr<DBAnnot> >& dbannots, uint16_t threads) {
+        loadDBAnnots(path, dbannots, threads, NULL);
+    }
+
+    /**
+     * As above, but leniently if a log is given, see DBAnnot::load
+     */
+    void loadDBAnnots(const string& path, vector< shared_ptr<DBAnnot> >& dbannots, uint16_t threads, ParseLog* log) {
+
+        SourceFingerprint fingerprint(path);
+        const string cachePath = getCachePath(path, log ? "dbannot-lenient" : "dbannot");
+
+        {
+            MappedFilePtr file;
+            BinaryReader in;
+
+            if (open(cachePath, fingerprint, file, in)) {
+
+                try {
+                    auto_cpu_timer timer(1, " = Wall time taken: %ws\n\n");
+                    vector< shared_ptr<DBAnnot> > cached;
+                    const size_t nbRecords = in.getVarint();
+                    cached.reserve(nbRecords);
+                    for(size_t i = 0; i < nbRecords; i++) {
+                        cached.push_back(DBAnnot::readBinary(in));
+                    }
+                    dbannots.insert(dbannots.end(), cached.begin(), cached.end());
+                    cout << " - Found " << cached.size() << " DB Annot records." << endl;
+                    return;
+                }
+                catch(std::exception& e) {
+                    cerr << "Ignoring corrupt cache file: " << cachePath << endl;
+                }
+            }
+        }
+
+        vector< shared_ptr<DBAnnot> > loaded;
+        DBAnnot::load(path, loaded, threads, log);
+
+        BinaryWriter out;
+        writeHeader(out, fingerprint);
+        out.putVarint(loaded.size());
+        BOOST_FOREACH(shared_ptr<DBAnnot> db, loaded) {
+            db->writeBinary(out);
+        }
+        save(cachePath, out);
+
+        dbannots.insert(dbannots.end(), loaded.begin(), loaded.end());
+    }
+
+protected:
+
+    /**
+     * Cache files are named after the source file, with a hash of its
+     * absolute path to keep identically named inputs from different
+     * directories apart
+     */
+    string getCachePath(const string& path, const string& kind) const {
+
+        const string absPath = boost::filesystem::absolute(path).string();
+
+        char pathHash[17];
+        snprintf(pathHash, sizeof(pathHash), "%016llx",
+                (unsigned long long)fnv1a(absPath.c_str(), absPath.size(), FNV_OFFSET_BASIS));
+
+        const string name = boost::filesystem::path(path).filename().string() +
+                "." + kind + "." + pathHash + ".gtsc";
+
+        return (boost::filesystem::path(dir) / name).string();
+    }
+
+    void writeHeader(BinaryWriter& out, const SourceFingerprint& fingerprint) const {
+
+        out.putBytes(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        out.put<uint32_t>(CACHE_VERSION);
+        fingerprint.write(out);
+    }
+
+    /**
+     * Maps the cache file at cachePath and positions in at the start of its
+     * payload.  Returns false if there is no usable cache, i.e. it doesn't
+     * exist, was written by a different version of GTS or was built from a
+     * different version of the source file.
+     */
+    bool open(const string& cachePath, const SourceFingerprint& fingerprint, MappedFilePtr& file, BinaryReader& in) const {
+
+        if (!boost::filesystem::exists(cachePath)) {
+            return false;
+        }
+
+        cout << " - Loading from cache: " << cachePath << endl;
+
+        try {
+            file = boost::make_shared<MappedFile>(cachePath);
+            in = BinaryReader(file->begin(), file->end());
+
+            if (!in.matchBytes(CACHE_MAGIC, sizeof(CACHE_MAGIC)) || in.get<uint32_t>() != CACHE_VERSION) {
+                cout << " - Cache was written by a different version of GTS, rebuilding" << endl;
+                return false;
+            }
+
+            SourceFingerprint cached;
+            cached.read(in);
+
+            if (!(cached == fingerprint)) {
+                cout << " - Source file has changed since it was cached, rebuilding" << endl;
+                return false;
+            }
+        }
+        catch(gts::io::IOException& e) {
+            cerr << "Ignoring unreadable cache file: " << cachePath << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    void save(const string& cachePath, const BinaryWriter& out) const {
+
+        try {
+            out.save(cachePath);
+            cout << " - Cached " << out.GetSize() << " bytes to: " << cachePath << endl;
+        }
+        catch(std::exception& e) {
+            // A cache we can't write shouldn't stop the run
+            cerr << "Could not write cache file: " << cachePath << endl;
+        }
+    }
+};
+
+}
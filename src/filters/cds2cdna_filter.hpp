@@ -70,10 +70,9 @@ protected:
             
             GFFList goodTranscripts;
             
-            BOOST_FOREACH(GFFPtr transcript, *gene->GetChildList()) {
+            BOOST_FOREACH(GFFPtr transcript, gene->GetChildList()) {
                 
                 const string transcriptId = transcript->GetId();
-                const string rootId = transcript->GetRootId();
                 
                 int32_t cdsLength = transcript->GetLengthOfAllTypes(CDS);
                 int32_t cdnaLength = transcript->GetLengthOfAllTypes(EXON);
@@ -95,13 +94,16 @@ protected:
                     goodTranscripts.push_back(transcript);
                     nbLongEnough++;
                 }
+                else {
+                    exclude(transcript);
+                }
             }
             
             // We only want genes with 1 or more good transcript
             if (goodTranscripts.size() >= 1) {                
                 
                 // Copy gene without child info
-                GFFPtr newGene = make_shared<GFF>(*gene);
+                GFFPtr newGene = out.getArena()->copy(*gene);
 
                 BOOST_FOREACH(GFFPtr goodTranscript, goodTranscripts) {
                     newGene->addChild(goodTranscript);
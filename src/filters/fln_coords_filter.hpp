@@ -77,10 +77,10 @@ protected:
             
             GFFList goodTranscripts;
             
-            BOOST_FOREACH(GFFPtr transcript, *gene->GetChildList()) {
+            BOOST_FOREACH(GFFPtr transcript, gene->GetChildList()) {
                 
                 const string transcriptId = transcript->GetId();
-                const string rootId = transcript->GetRootId();
+                const uint32_t rootId = transcript->GetRootIdHandle(maps.ids);
                 
                 int32_t cdsLength = transcript->GetLengthOfAllTypes(CDS);
 
@@ -124,13 +124,16 @@ protected:
                     goodTranscripts.push_back(transcript);
                     nbConsistent++;
                 }
+                else {
+                    exclude(transcript);
+                }
             }
             
             // We only want genes with 1 or more good transcript
             if (goodTranscripts.size() >= 1) {                
                 
                 // Copy gene without child info
-                GFFPtr newGene = make_shared<GFF>(*gene);
+                GFFPtr newGene = out.getArena()->copy(*gene);
 
                 BOOST_FOREACH(GFFPtr goodTranscript, goodTranscripts) {
                     newGene->addChild(goodTranscript);
@@ -75,7 +75,7 @@ protected:
     /**
     * Adds all transcripts that are share ORFs to the provided set.
     */
-    void addMORFs(GFFList& transcripts, unordered_set<GFFPtr>& morfs) {
+    void addMORFs(const GFFList& transcripts, unordered_set<GFFPtr>& morfs) {
 
         for(size_t i = 0; i < transcripts.size(); i++) {
 
@@ -114,21 +114,24 @@ protected:
             unordered_set<GFFPtr> morfs;
 
             // Identify all those transcripts which share open reading frames
-            addMORFs(*(gene->GetChildList()), morfs);
+            addMORFs(gene->GetChildList(), morfs);
 
-            BOOST_FOREACH(GFFPtr transcript, *(gene->GetChildList())) {
+            BOOST_FOREACH(GFFPtr transcript, gene->GetChildList()) {
 
                 // Only add the transcript if it doesn't share an open reading frame with another transcript in this gene
                 if (morfs.find(transcript) == morfs.end()) {
                     goodTranscripts.push_back(transcript);
                 }
+                else {
+                    exclude(transcript);
+                }
             }
 
             // We only want genes with 1 transcript and at least 1 5' and 3' UTR
             if (goodTranscripts.size() >= 1) {
 
                 // Copy gene without child info
-                GFFPtr newGene = make_shared<GFF>(*gene);
+                GFFPtr newGene = out.getArena()->copy(*gene);
 
                 BOOST_FOREACH(GFFPtr goodTranscript, goodTranscripts) {
                     newGene->addChild(goodTranscript);
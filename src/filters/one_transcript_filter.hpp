@@ -64,7 +64,7 @@ protected:
             int32_t maxCdsLength = 0;
             GFFPtr longestTranscript;
             
-            BOOST_FOREACH(GFFPtr transcript, *(gene->GetChildList())) {
+            BOOST_FOREACH(GFFPtr transcript, gene->GetChildList()) {
 
                 int32_t cdsLength = transcript->GetLengthOfAllTypes(CDS);
                 
@@ -77,10 +77,16 @@ protected:
             if (longestTranscript) {
 
                 // Copy gene without child info
-                GFFPtr newGene = make_shared<GFF>(*gene);
+                GFFPtr newGene = out.getArena()->copy(*gene);
 
                 newGene->addChild(longestTranscript);
                 
+                BOOST_FOREACH(GFFPtr transcript, gene->GetChildList()) {
+                    if (transcript != longestTranscript) {
+                        exclude(transcript);
+                    }
+                }
+                
                 out.addGene(newGene);
             }
             else {
@@ -54,11 +54,6 @@ protected:
     
     void filterInternal(GFFModel& in, Maps& maps, GFFModel& out) {
         
-        GFFPtr lastOkGene;
-        
-        bool first = true;
-        bool ok = true;
-
         stringstream ss;
         
         ss << " - Window Size: " << this->windowSize << endl;
@@ -70,8 +65,8 @@ protected:
             BOOST_FOREACH(GFFPtr gene2, *(fullModel->getGeneList())) {
                 
                 if (gene1 != gene2 && 
-                    !boost::equals(gene1->GetId(), gene2->GetId()) &&
-                    boost::equals(gene1->GetSeqId(), gene2->GetSeqId())) {
+                    gene1->GetSeqIdHandle() == gene2->GetSeqIdHandle() &&
+                    !boost::equals(gene1->GetId(), gene2->GetId())) {
                 
                     // This is probably overkill but let's test everything just to be sure!
                     int32_t startDiff = abs(gene1->GetStart() - gene2->GetStart());
@@ -95,6 +90,9 @@ protected:
             if (overlapCount == 0) {
                 out.addGene(gene1);
             }
+            else {
+                excludeAll(gene1);
+            }
         }
                 
         ss << " - Checking " << in.getNbGenes() << " passed genes against the " << fullModel->getNbGenes() << " genes present in original model" << endl
@@ -55,24 +55,27 @@ protected:
             
             if (gffGeneStrand != '.') {
                 
-                GFFListPtr transcripts = gene->GetChildList();
-                BOOST_FOREACH(GFFPtr transcript, *transcripts) {
+                const GFFList& transcripts = gene->GetChildList();
+                BOOST_FOREACH(GFFPtr transcript, transcripts) {
 
                     const char gffTranscriptStrand = transcript->GetStrand();
-                    const char gtfTranscriptStrand = maps.gtfMap[transcript->GetRootId()]->GetStrand();
+                    const char gtfTranscriptStrand = maps.gtfMap[transcript->GetRootIdHandle(maps.ids)]->GetStrand();
 
                     if (gffTranscriptStrand == gffGeneStrand &&
                         (gffTranscriptStrand == gtfTranscriptStrand || gtfTranscriptStrand == '.')) {
 
                         goodTranscripts.push_back(transcript);
                     } 
+                    else {
+                        exclude(transcript);
+                    }
                 }
 
                 // We only want genes with 1 or more good transcript
                 if (goodTranscripts.size() >= 1) {                
 
                     // Copy gene without child info
-                    GFFPtr newGene = make_shared<GFF>(*gene);
+                    GFFPtr newGene = out.getArena()->copy(*gene);
 
                     BOOST_FOREACH(GFFPtr goodTranscript, goodTranscripts) {
                         newGene->addChild(goodTranscript);
@@ -81,6 +84,9 @@ protected:
                     out.addGene(newGene);
                 }
             }
+            else {
+                excludeAll(gene);
+            }
         }
         
         stringstream ss;
@@ -26,12 +26,17 @@ using namespace gts::gff;
 typedef boost::error_info<struct TranscriptFilterError,string> TranscriptFilterErrorInfo;
 struct TranscriptFilterException: virtual boost::exception, virtual std::exception { };
 
-typedef boost::unordered_map<string, shared_ptr<DBAnnot> > DBAnnotIdMap;
+// Keyed by handles in Maps::ids, so transcripts are looked up by their root
+// id handle without building any strings
+typedef boost::unordered_map<uint32_t, GFFPtr> GFFHandleMap;
+typedef boost::unordered_map<uint32_t, shared_ptr<DBAnnot> > DBAnnotHandleMap;
 
 struct Maps {
-   GFFIdMap gtfMap;
-   DBAnnotIdMap uniqFlnCds;
-   DBAnnotIdMap uniqFlnNcCds;   
+   // Root transcript and FLN ids seen in this run, freed with the maps
+   StringPool ids;
+   GFFHandleMap gtfMap;
+   DBAnnotHandleMap uniqFlnCds;
+   DBAnnotHandleMap uniqFlnNcCds;   
 };
 
 class TranscriptFilter {
@@ -46,7 +51,12 @@ public:
         
         auto_cpu_timer timer(1, "Wall time taken: %ws\n\n");
         
+        excluded.clear();
         filterInternal(in, maps, out);
+        
+        // Filters only drop genes and transcripts, keeping the rest in the
+        // order they were in, so a sorted input needn't be sorted again
+        out.setSorted(in.isSorted());
     }
     
     virtual string getName() = 0;
@@ -57,10 +67,29 @@ public:
         return report;
     }
     
+    /**
+     * The transcripts in the input the last call to filter left out of its
+     * output
+     */
+    const GFFList& getExcluded() const {
+        return excluded;
+    }
+    
 
 protected:    
     
     string report;
+    GFFList excluded;
+    
+    void exclude(GFFPtr transcript) {
+        excluded.push_back(transcript);
+    }
+    
+    void excludeAll(GFFPtr gene) {
+        BOOST_FOREACH(GFFPtr transcript, gene->GetChildList()) {
+            excluded.push_back(transcript);
+        }
+    }
     
     virtual void filterInternal(GFFModel& in, Maps& maps, GFFModel& out) = 0; 
 };
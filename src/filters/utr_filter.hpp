@@ -62,7 +62,7 @@ protected:
 
             GFFList goodTranscripts;
 
-            BOOST_FOREACH(GFFPtr transcript, *(gene->GetChildList())) {
+            BOOST_FOREACH(GFFPtr transcript, gene->GetChildList()) {
 
                 GFFListPtr utr5List = transcript->GetAllOfType(UTR5);
                 GFFListPtr utr3List = transcript->GetAllOfType(UTR3);
@@ -70,13 +70,16 @@ protected:
                 if (!utr5List->empty() && !utr3List->empty()) {
                     goodTranscripts.push_back(transcript);
                 }
+                else {
+                    exclude(transcript);
+                }
             }
 
             // We only want genes with at least 1 5' and 3' UTR
             if (goodTranscripts.size() >= 1) {
 
                 // Copy gene without child info
-                GFFPtr newGene = make_shared<GFF>(*gene);
+                GFFPtr newGene = out.getArena()->copy(*gene);
 
                 BOOST_FOREACH(GFFPtr goodTranscript, goodTranscripts) {
                     newGene->addChild(goodTranscript);
@@ -47,6 +47,7 @@ namespace bfs = boost::filesystem;
 #include "gff.hpp"
 using gts::gff::GTF;
 using gts::gff::GFF;
+using gts::gff::GFFArena;
 using gts::gff::GFFList;
 using gts::gff::GFFPtr;
 
@@ -64,8 +65,11 @@ void fix(GFFList& input, GFFList& output) {
     
     BOOST_FOREACH(GFFPtr gtf, input) {
         
+        // Records left alone are written out exactly as they were read
         const string transcriptId = gtf->GetRootTranscriptId();
-        gtf->SetTranscriptId(transcriptId);        
+        if (transcriptId != gtf->GetTranscriptId()) {
+            gtf->SetTranscriptId(transcriptId);
+        }
         output.push_back(gtf);
     }
     cout << " - Keeping " << output.size() << " out of " << input.size() << " genbank records" << endl;
@@ -82,6 +86,7 @@ int main(int argc, char *argv[]) {
         // Portculis args
         string inputFile;
         string outputFile;
+        uint16_t threads;
         
         bool version;
         bool help;
@@ -93,6 +98,8 @@ int main(int argc, char *argv[]) {
                     "Input GTF file from PASA to be fixed")
                 ("output,o", po::value<string>(&outputFile),
                     "The output genbank file")
+                ("threads", po::value<uint16_t>(&threads)->default_value(1),
+                    "The number of threads to use when parsing the input")
                 ("version", po::bool_switch(&version)->default_value(false), "Print version string")
                 ("help", po::bool_switch(&help)->default_value(false), "Produce help message")
                 ;
@@ -131,8 +138,9 @@ int main(int argc, char *argv[]) {
         
         // Load genbank file to filter
         cout << "Loading GTF file" << endl;
+        GFFArena arena;
         GFFList gtfs;
-        GFF::load(gts::gff::GTF, inputFile, gtfs);
+        GFF::load(gts::gff::GTF, inputFile, gtfs, arena, gts::gff::ANY, threads);
         
         // Keeping only 
         cout << "Fixing GTF" << endl;
@@ -30,6 +30,17 @@ using std::vector;
 using boost::lexical_cast;
 using boost::shared_ptr;
 
+#include "io/binary.hpp"
+#include "io/file_buffer.hpp"
+#include "io/tokenizer.hpp"
+#include "parse_log.hpp"
+using gts::io::BinaryReader;
+using gts::io::BinaryWriter;
+using gts::io::DelimSet;
+using gts::io::FileBuffer;
+using gts::io::StrRef;
+using gts::ParseLog;
+
 namespace gts {
 
     
@@ -52,36 +63,36 @@ enum FLNStatus {
 };
 
 
-static FLNStatus flnStatusFromString(string& s) {
+static FLNStatus flnStatusFromString(const StrRef& s) {
     
-    if (boost::iequals(s, "Internal")) {
+    if (s.iequals("Internal")) {
         return INTERNAL;
     }
-    else if (boost::iequals(s, "Complete")) {
+    else if (s.iequals("Complete")) {
         return COMPLETE;
     }
-    else if (boost::iequals(s, "Putative Complete")) {
+    else if (s.iequals("Putative Complete")) {
         return PUTATIVE_COMPLETE;
     }
-    else if (boost::iequals(s, "C-terminus")) {
+    else if (s.iequals("C-terminus")) {
         return CTERM;
     }
-    else if (boost::iequals(s, "N-terminus")) {
+    else if (s.iequals("N-terminus")) {
         return NTERM;
     }
-    else if (boost::iequals(s, "Putative C-terminus")) {
+    else if (s.iequals("Putative C-terminus")) {
         return NTERM;
     }
-    else if (boost::iequals(s, "Misassembled")) {
+    else if (s.iequals("Misassembled")) {
         return MISASSEMBLED;
     }
-    else if (boost::iequals(s, "coding")) {
+    else if (s.iequals("coding")) {
         return CODING;
     }
-    else if (boost::iequals(s, "putative_coding")) {
+    else if (s.iequals("putative_coding")) {
         return PUTATIVE_CODING;
     }
-    else if (boost::iequals(s, "unknown")) {
+    else if (s.iequals("unknown")) {
         return UNKNOWN;
     }
     else {
@@ -162,33 +173,92 @@ public:
 
 
     
+    void writeBinary(BinaryWriter& out) const {
+        out.putString(id);
+        out.put<int32_t>(fastaLength);
+        out.put<uint8_t>(status);
+        out.put<int32_t>(orfStart);
+        out.put<int32_t>(orfEnd);
+        out.put<int32_t>(sStart);
+        out.put<int32_t>(sEnd);
+    }
+    
+    static shared_ptr<DBAnnot> readBinary(BinaryReader& in) {
+        shared_ptr<DBAnnot> db = make_shared<DBAnnot>();
+        in.getString(db->id);
+        db->fastaLength = in.get<int32_t>();
+        db->status = static_cast<FLNStatus>(in.get<uint8_t>());
+        db->orfStart = in.get<int32_t>();
+        db->orfEnd = in.get<int32_t>();
+        db->sStart = in.get<int32_t>();
+        db->sEnd = in.get<int32_t>();
+        return db;
+    }
+    
     static shared_ptr<DBAnnot> parse(const string& line) {
-        vector<string> parts;
-        boost::split( parts, line, boost::is_any_of("\t"), boost::token_compress_off );
+        return parse(StrRef(line.data(), line.data() + line.size()), NULL);
+    }
+    
+    static shared_ptr<DBAnnot> parse(const StrRef& line) {
+        return parse(line, NULL);
+    }
+    
+    /**
+     * Parses a single DB Annot line.  Malformed lines throw an FLNException,
+     * unless a log is given, in which case they are counted there and a null
+     * pointer is returned.
+     */
+    static shared_ptr<DBAnnot> parse(const StrRef& line, ParseLog* log) {
+        
+        static const DelimSet TAB("\t");
+        
+        const size_t MAX_PARTS = 18;
+        StrRef parts[MAX_PARTS];
+        const size_t nbParts = gts::io::split(line, TAB, parts, MAX_PARTS, false);
 
-        if (parts.size() < 8 || parts.size() > 18) {
+        if (nbParts < 8 || nbParts > MAX_PARTS) {
+            
+            if (log != NULL) {
+                log->add("Incorrect number of columns", line.b, line.e);
+                return shared_ptr<DBAnnot>();
+            }
+            
             BOOST_THROW_EXCEPTION(FLNException() << FLNErrorInfo(string(
                 "Could not parse GFF line due to incorrect number of columns. Expected at least 8 columns.  Found ") + 
-                    lexical_cast<string>(parts.size()) + " columns.  Line: " + line));
+                    lexical_cast<string>(nbParts) + " columns.  Line: " + line.str()));
         }
         
         shared_ptr<DBAnnot> db = make_shared<DBAnnot>();
         
-        db->SetId(parts[0]);
-        db->SetFastaLength(lexical_cast<int32_t>(parts[1]));
+        parts[0].assignTo(db->id);
         db->SetStatus(flnStatusFromString(parts[4]));
         
-        if (db->GetStatus() != MISASSEMBLED && parts.size() >= 14) {
-            db->SetOrfStart(parts[12].empty() ? -1 : lexical_cast<int32_t>(parts[12]));
-            db->SetOrfEnd(parts[13].empty() ? -1 : lexical_cast<int32_t>(parts[13]));
+        int32_t orfStart = -1, orfEnd = -1, ss = -1, se = -1;
+        
+        const bool hasOrf = db->GetStatus() != MISASSEMBLED && nbParts >= 14;
+        const bool hasSubject = hasOrf && nbParts >= 16;
+        
+        if (!gts::io::tryToInt(parts[1], db->fastaLength) || 
+                (hasOrf && (!toCoord(parts[12], orfStart) || !toCoord(parts[13], orfEnd))) ||
+                (hasSubject && (!toCoord(parts[14], ss) || !toCoord(parts[15], se)))) {
             
-            if (parts.size() >= 16) {
-                int32_t ss = parts[14].empty() ? -1 : lexical_cast<int32_t>(parts[14]);
-                int32_t se = parts[15].empty() ? -1 : lexical_cast<int32_t>(parts[15]);
-
-                db->SetSStart(ss < se ? ss : se);
-                db->SetSEnd(ss < se ? se : ss);
+            if (log != NULL) {
+                log->add("Invalid number", line.b, line.e);
+                return shared_ptr<DBAnnot>();
             }
+            
+            BOOST_THROW_EXCEPTION(FLNException() << FLNErrorInfo(string(
+                "Could not parse DB Annot line due to an invalid number.  Line: ") + line.str()));
+        }
+        
+        if (hasOrf) {
+            db->SetOrfStart(orfStart);
+            db->SetOrfEnd(orfEnd);
+        }
+        
+        if (hasSubject) {
+            db->SetSStart(ss < se ? ss : se);
+            db->SetSEnd(ss < se ? se : ss);
         }
                   
         return db;
@@ -198,24 +268,62 @@ public:
     
     
     static void load(const string& path, vector< shared_ptr<DBAnnot> >& dbannots) {
+        load(path, dbannots, 1);
+    }
+    
+    static void load(const string& path, vector< shared_ptr<DBAnnot> >& dbannots, uint16_t threads) {
+        load(path, dbannots, threads, NULL);
+    }
+    
+    /**
+     * Loads every record, after the header line, from the file at path.  If a
+     * log is given malformed lines are counted there and skipped, otherwise
+     * the first one aborts the load.
+     */
+    static void load(const string& path, vector< shared_ptr<DBAnnot> >& dbannots, uint16_t threads, ParseLog* log) {
     
         auto_cpu_timer timer(1, " = Wall time taken: %ws\n\n");
         cout << " - Loading FLN DBAnnot: " << path << endl;
         
-        std::ifstream file(path.c_str());
-        std::string line;
-        std::getline(file, line); // Ignore the header line
-        while (std::getline(file, line)) {            
-            boost::trim(line);
+        FileBuffer file(path, threads);
+        const char* end = file.end();
+        
+        // Ignore the header line
+        const char* p = file.begin();
+        if (p != end) {
+            p = gts::io::findLineEnd(p, end) + 1;
+        }
+        
+        while (p < end) {
+            const char* lineEnd = gts::io::findLineEnd(p, end);
+            StrRef line = gts::io::trim(StrRef(p, lineEnd));
             if (!line.empty()) {
-                dbannots.push_back(parse(line));
+                shared_ptr<DBAnnot> db = parse(line, log);
+                if (db) {
+                    dbannots.push_back(db);
+                }
             }
+            p = lineEnd + 1;
         }
-        file.close();
         
         cout << " - Found " << dbannots.size() << " DB Annot records." << endl;
     }
     
+private:
+    
+    /**
+     * Empty ORF and subject columns mean the value is missing, i.e. -1
+     */
+    static bool toCoord(const StrRef& s, int32_t& value) {
+        
+        if (s.empty()) {
+            value = -1;
+            return true;
+        }
+        
+        return gts::io::tryToInt(s, value);
+    }
+    
 };
 
 class NonCoding {
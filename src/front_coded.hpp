@@ -0,0 +1,473 @@
+//  ********************************************************************
+//  This file is part of GTS (Good Transcript Selector).
+//
+//  GTS is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Portculis is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with GTS.  If not, see <http://www.gnu.org/licenses/>.
+//  *******************************************************************
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+#include <boost/atomic.hpp>
+#include <boost/exception/all.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "io/binary.hpp"
+using gts::io::BinaryReader;
+using gts::io::BinaryWriter;
+
+namespace gts {
+
+typedef boost::error_info<struct IdStoreError,string> IdStoreErrorInfo;
+struct IdStoreException: virtual boost::exception, virtual std::exception { };
+
+/**
+ * An immutable, sorted set of distinct strings, stored front-coded.  Strings
+ * are kept in blocks of BLOCK_SIZE.  The first of each block is stored in
+ * full, every other one as the length of the prefix it shares with the one
+ * before, followed by the rest.  Ids in GFF files share long prefixes, so
+ * this takes a fraction of the room separate strings would.
+ *
+ * A string's index is its position in sorted order.  Lookups binary search
+ * the first string of each block, then scan a single block.
+ */
+class FrontCodedDictionary {
+
+public:
+
+    static const uint32_t BLOCK_SIZE = 16;
+
+    // Returned by find for strings that aren't in the dictionary
+    static const uint32_t NONE = 0xFFFFFFFF;
+
+private:
+
+    vector<char> bytes;
+
+    // Where each block starts in bytes
+    vector<uint32_t> blocks;
+
+    uint32_t size;
+
+public:
+
+    FrontCodedDictionary() : size(0) {}
+
+    /**
+     * Builds a dictionary of the distinct strings in strings, which are
+     * sorted, and have duplicates removed, in the process
+     */
+    FrontCodedDictionary(vector<string>& strings) : size(0) {
+
+        std::sort(strings.begin(), strings.end());
+        strings.erase(std::unique(strings.begin(), strings.end()), strings.end());
+
+        if (strings.size() >= NONE) {
+            BOOST_THROW_EXCEPTION(IdStoreException() << IdStoreErrorInfo(string(
+                "Too many strings for a front-coded dictionary")));
+        }
+
+        for(size_t i = 0; i < strings.size(); i++) {
+
+            const string& s = strings[i];
+
+            if (i % BLOCK_SIZE == 0) {
+                blocks.push_back(bytes.size());
+                putVarint(s.size());
+                bytes.insert(bytes.end(), s.begin(), s.end());
+            }
+            else {
+                const string& last = strings[i - 1];
+                const size_t shared = std::mismatch(s.begin(), s.begin() + std::min(s.size(), last.size()), last.begin()).first - s.begin();
+
+                putVarint(shared);
+                putVarint(s.size() - shared);
+                bytes.insert(bytes.end(), s.begin() + shared, s.end());
+            }
+        }
+
+        size = strings.size();
+
+        vector<char>(bytes).swap(bytes);
+    }
+
+    uint32_t GetSize() const {
+        return size;
+    }
+
+    /**
+     * Bytes taken by the encoded strings and block index
+     */
+    size_t GetBytes() const {
+        return bytes.size() + blocks.size() * sizeof(uint32_t);
+    }
+
+    /**
+     * Decodes the string at index into buffer, reusing its storage
+     */
+    void decode(uint32_t index, string& buffer) const {
+
+        const char* p = readFirst(&bytes[blocks[index / BLOCK_SIZE]], end(), buffer);
+
+        for(uint32_t i = index % BLOCK_SIZE; i > 0; i--) {
+            p = readNext(p, end(), buffer);
+        }
+    }
+
+    /**
+     * The index of s, or NONE if it isn't in the dictionary
+     */
+    uint32_t find(const string& s) const {
+
+        if (blocks.empty()) {
+            return NONE;
+        }
+
+        // The last block whose first string isn't after s
+        size_t lo = 0;
+        size_t hi = blocks.size();
+
+        while (hi - lo > 1) {
+
+            const size_t mid = lo + (hi - lo) / 2;
+
+            const char* p = &bytes[blocks[mid]];
+            const size_t len = getLength(p, end());
+
+            if (compare(p, len, s) <= 0) {
+                lo = mid;
+            }
+            else {
+                hi = mid;
+            }
+        }
+
+        string buffer;
+        const char* p = readFirst(&bytes[blocks[lo]], end(), buffer);
+        const uint32_t first = lo * BLOCK_SIZE;
+        const uint32_t last = std::min<uint32_t>(first + BLOCK_SIZE, size);
+
+        for(uint32_t i = first; i < last; i++) {
+
+            if (i > first) {
+                p = readNext(p, end(), buffer);
+            }
+
+            const int c = buffer.compare(s);
+
+            if (c == 0) {
+                return i;
+            }
+            else if (c > 0) {
+                break;
+            }
+        }
+
+        return NONE;
+    }
+
+    void writeBinary(BinaryWriter& out) const {
+
+        out.putVarint(size);
+        out.putVarint(bytes.size());
+        out.putBytes(bytes.empty() ? NULL : &bytes[0], bytes.size());
+    }
+
+    /**
+     * Reads back a dictionary written by writeBinary.  The block index isn't
+     * stored, it's rebuilt from the strings, checking every length against
+     * the bytes left so corrupt data throws an IOException rather than
+     * being read past.
+     */
+    void readBinary(BinaryReader& in) {
+
+        size = in.getVarint();
+
+        const char* b;
+        const char* e;
+        in.getRange(b, e);
+        bytes.assign(b, e);
+
+        blocks.clear();
+        blocks.reserve((size + BLOCK_SIZE - 1) / BLOCK_SIZE);
+
+        // Skip through each block to find where the next one starts
+        const char* p = begin();
+        size_t last = 0;
+
+        for(uint32_t i = 0; i < size; i++) {
+
+            if (i % BLOCK_SIZE == 0) {
+                blocks.push_back(p - begin());
+                last = getLength(p, end());
+                p += last;
+            }
+            else {
+                const size_t shared = getVarint(p, end());
+                const size_t len = getLength(p, end());
+
+                if (shared > last) {
+                    corrupt();
+                }
+
+                last = shared + len;
+                p += len;
+            }
+        }
+
+        if (p != end()) {
+            corrupt();
+        }
+    }
+
+private:
+
+    void putVarint(size_t value) {
+
+        while (value >= 0x80) {
+            bytes.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+
+        bytes.push_back(static_cast<char>(value));
+    }
+
+    const char* begin() const {
+        return bytes.empty() ? NULL : &bytes[0];
+    }
+
+    const char* end() const {
+        return begin() + bytes.size();
+    }
+
+    static void corrupt() {
+        BOOST_THROW_EXCEPTION(gts::io::IOException() << gts::io::IOErrorInfo(string(
+            "Corrupt front-coded dictionary in binary data")));
+    }
+
+    static size_t getVarint(const char*& p, const char* end) {
+
+        size_t value = 0;
+
+        for(uint32_t shift = 0; shift < sizeof(size_t) * 8; shift += 7) {
+
+            if (p == end) {
+                corrupt();
+            }
+
+            const unsigned char b = static_cast<unsigned char>(*p++);
+            value |= static_cast<size_t>(b & 0x7f) << shift;
+
+            if (!(b & 0x80)) {
+                return value;
+            }
+        }
+
+        corrupt();
+        return 0;
+    }
+
+    /**
+     * Reads the length of the characters that follow, which must all be
+     * before end
+     */
+    static size_t getLength(const char*& p, const char* end) {
+
+        const size_t len = getVarint(p, end);
+
+        if (len > static_cast<size_t>(end - p)) {
+            corrupt();
+        }
+
+        return len;
+    }
+
+    static const char* readFirst(const char* p, const char* end, string& buffer) {
+
+        const size_t len = getLength(p, end);
+        buffer.assign(p, len);
+        return p + len;
+    }
+
+    static const char* readNext(const char* p, const char* end, string& buffer) {
+
+        const size_t shared = getVarint(p, end);
+        const size_t len = getLength(p, end);
+
+        if (shared > buffer.size()) {
+            corrupt();
+        }
+
+        buffer.resize(shared);
+        buffer.append(p, len);
+        return p + len;
+    }
+
+    static int compare(const char* p, size_t len, const string& s) {
+
+        const int c = memcmp(p, s.data(), std::min(len, s.size()));
+        return c != 0 ? c : len < s.size() ? -1 : len > s.size() ? 1 : 0;
+    }
+};
+
+/**
+ * Front-coded dictionaries that are kept for the life of the program, and
+ * numbered one after the other, so that a single uint32 picks out a string
+ * in any of them.  GFFModel::compact keeps feature ids here.
+ *
+ * Dictionaries are never freed, not even when the records using them are.
+ * Each call to GFFModel::compact that finds ids to store adds one, so it's
+ * meant to be called once on each model that's kept until the end, as gts
+ * --compact does, not on short lived or streamed models.  Adding only fails
+ * once the store holds 2^32 - 1 strings.
+ *
+ * Adding a dictionary takes a lock, but decoding doesn't.  The table of
+ * dictionaries is published with release ordering, and grows by being
+ * copied into a bigger one, so a reader always sees a table at least as
+ * full as the count it read.  Replaced tables are kept until the store is
+ * destroyed, as readers may still be using them.
+ */
+class IdStore : boost::noncopyable {
+
+private:
+
+    static const uint32_t INITIAL_CAPACITY = 16;
+
+    struct Entry {
+
+        // Index of the first string in dictionary
+        uint32_t base;
+        const FrontCodedDictionary* dictionary;
+
+        bool operator<(uint32_t index) const {
+            return base < index;
+        }
+    };
+
+    boost::atomic<Entry*> entries;
+    boost::atomic<uint32_t> count;
+    uint32_t capacity;
+    uint32_t total;
+    vector<Entry*> retired;
+    boost::mutex mutex;
+
+public:
+
+    IdStore() : entries(new Entry[INITIAL_CAPACITY]), count(0), capacity(INITIAL_CAPACITY), total(0) {}
+
+    virtual ~IdStore() {
+
+        Entry* table = entries.load(boost::memory_order_relaxed);
+        const uint32_t n = count.load(boost::memory_order_relaxed);
+
+        for(uint32_t i = 0; i < n; i++) {
+            delete table[i].dictionary;
+        }
+
+        delete[] table;
+
+        for(size_t i = 0; i < retired.size(); i++) {
+            delete[] retired[i];
+        }
+    }
+
+    /**
+     * The store shared by all GFF records
+     */
+    static IdStore& global() {
+        static IdStore store;
+        return store;
+    }
+
+    /**
+     * Takes ownership of dictionary, which mustn't be empty.  Returns the
+     * index its first string has in this store.
+     */
+    uint32_t add(FrontCodedDictionary* dictionary) {
+
+        boost::mutex::scoped_lock lock(mutex);
+
+        if (dictionary->GetSize() >= FrontCodedDictionary::NONE - total) {
+            delete dictionary;
+            BOOST_THROW_EXCEPTION(IdStoreException() << IdStoreErrorInfo(string(
+                "Id store is full")));
+        }
+
+        const uint32_t n = count.load(boost::memory_order_relaxed);
+        Entry* table = entries.load(boost::memory_order_relaxed);
+
+        if (n == capacity) {
+
+            Entry* bigger = new Entry[capacity * 2];
+            std::copy(table, table + n, bigger);
+
+            entries.store(bigger, boost::memory_order_release);
+            retired.push_back(table);
+
+            table = bigger;
+            capacity *= 2;
+        }
+
+        const uint32_t base = total;
+
+        table[n].base = base;
+        table[n].dictionary = dictionary;
+        total += dictionary->GetSize();
+
+        count.store(n + 1, boost::memory_order_release);
+
+        return base;
+    }
+
+    /**
+     * Decodes the string at index into buffer, reusing its storage
+     */
+    void decode(uint32_t index, string& buffer) const {
+
+        // The count first, as the table it's read from was published before it
+        const uint32_t n = count.load(boost::memory_order_acquire);
+        const Entry* table = entries.load(boost::memory_order_acquire);
+
+        // The last dictionary starting at or before index
+        const Entry* e = std::lower_bound(table, table + n, index + 1) - 1;
+        e->dictionary->decode(index - e->base, buffer);
+    }
+
+    /**
+     * Bytes taken by all the dictionaries
+     */
+    size_t GetBytes() const {
+
+        const uint32_t n = count.load(boost::memory_order_acquire);
+        const Entry* table = entries.load(boost::memory_order_acquire);
+
+        size_t bytes = 0;
+
+        for(uint32_t i = 0; i < n; i++) {
+            bytes += table[i].dictionary->GetBytes();
+        }
+
+        return bytes;
+    }
+};
+
+}
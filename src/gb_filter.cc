@@ -47,13 +47,15 @@ namespace bfs = boost::filesystem;
 #include "gff.hpp"
 #include "genbank.hpp"
 using gts::gff::GFF;
+using gts::gff::GFFArena;
+using gts::gff::GFFPtr;
 using gts::gff::GFF3;
 using gts::gb::Genbank;
 using gts::gb::Feature;
 using gts::gb::Property;
 
-typedef boost::unordered_map<string, shared_ptr<GFF> > GFFIdMap;
-typedef std::vector<shared_ptr<GFF> > GFFList;
+typedef boost::unordered_map<string, GFFPtr> GFFIdMap;
+typedef std::vector<GFFPtr> GFFList;
 typedef std::vector<shared_ptr<Genbank> > GBList;
 
 string helpHeader() {
@@ -86,7 +88,7 @@ void indexGff(GFFList& gffs, GFFIdMap& gffIdMap) {
     
     GFFIdMap gffAsmblMap;
     GFFIdMap gffMrnaMap;
-    BOOST_FOREACH(shared_ptr<GFF> gff, gffs) {
+    BOOST_FOREACH(GFFPtr gff, gffs) {
         vector<string> idElements;
         string id(gff->GetId());
         boost::split( idElements, id, boost::is_any_of("|"), boost::token_compress_on );                
@@ -129,6 +131,7 @@ int main(int argc, char *argv[]) {
         string passGffFile;
         string genbankFile;
         string outputFile;
+        uint16_t threads;
         
         bool version;
         bool help;
@@ -142,6 +145,8 @@ int main(int argc, char *argv[]) {
                     "The genbank file to filter")
                 ("out,o", po::value<string>(&outputFile),
                     "The output genbank file")
+                ("threads", po::value<uint16_t>(&threads)->default_value(1),
+                    "The number of threads to use when parsing the input")
                 ("version", po::bool_switch(&version)->default_value(false), "Print version string")
                 ("help", po::bool_switch(&help)->default_value(false), "Produce help message")
                 ;
@@ -181,7 +186,7 @@ int main(int argc, char *argv[]) {
         // Load genbank file to filter
         cout << "Loading genbank file" << endl;
         GBList genbank;
-        gts::gb::Genbank::load(genbankFile, genbank);
+        gts::gb::Genbank::load(genbankFile, genbank, threads);
         
         // Index genomic GFFs by Id
         cout << "Filtering unsuitable genbank records" << endl;
@@ -189,8 +194,9 @@ int main(int argc, char *argv[]) {
         filterGenbank(genbank, filteredGenbank);
         
         cout << "Loading GFF file" << endl;
-        vector<shared_ptr<GFF> > gffs;
-        GFF::load(GFF3, passGffFile, gffs, gts::gff::MRNA);
+        GFFArena arena;
+        vector<GFFPtr> gffs;
+        GFF::load(GFF3, passGffFile, gffs, arena, gts::gff::MRNA, threads);
         
         // Index genomic GFFs by Id
         cout << "Indexing GFF file" << endl;
@@ -42,6 +42,15 @@ using boost::shared_ptr;
 using boost::timer::auto_cpu_timer;
 using boost::unordered_map;
 
+#include "io/file_buffer.hpp"
+#include "io/tokenizer.hpp"
+#include "parse_log.hpp"
+using gts::io::DelimSet;
+using gts::io::FileBuffer;
+using gts::io::LineReader;
+using gts::io::StrRef;
+using gts::ParseLog;
+
 namespace gts{
 namespace gb {
 
@@ -64,7 +73,7 @@ enum BlockType {
     UNKNOWN_BLOCKTYPE
 };
 
-static BlockType blockTypeFromString(string & s) {
+static BlockType blockTypeFromString(const string& s) {
     if (boost::equals(s, "LOCUS")) {
         return LOCUS;
     }
@@ -513,17 +522,37 @@ public:
     
 private:
     
-    static bool readBlock(ifstream& in, string& currentLine, Block& block) {
+    /**
+     * The first whitespace delimited word on the line, as "iss >> word" would give
+     */
+    static string firstWord(const string& line) {
+        
+        static const DelimSet WHITESPACE(" \t\n\r\v\f");
         
-        std::istringstream iss(currentLine);
-        string word;
-        iss >> word;
+        const StrRef s = gts::io::trim(StrRef(line.data(), line.data() + line.size()));
+        return string(s.b, gts::io::findFirst(s.b, s.e, WHITESPACE));
+    }
+    
+    /**
+     * Reads the block starting at currentLine, leaving the first line of the
+     * next block in currentLine.  Returns false at the end of the file.  An
+     * unknown block type throws, unless there's a log to count it in, in which
+     * case its lines are read into a block of UNKNOWN_BLOCKTYPE to be dropped.
+     */
+    static bool readBlock(LineReader& in, string& currentLine, Block& block, ParseLog* log) {
+        
+        const string word = firstWord(currentLine);
          
         BlockType bt = blockTypeFromString(word);
         
         if (bt == UNKNOWN_BLOCKTYPE) {
-            BOOST_THROW_EXCEPTION(GenbankException() << GenbankErrorInfo(string(
-                        "Unknown block type detected: ") + word));
+            
+            if (log == NULL) {
+                BOOST_THROW_EXCEPTION(GenbankException() << GenbankErrorInfo(string(
+                            "Unknown block type detected: ") + word));
+            }
+            
+            log->add("Unknown block type", word);
         }
         
         block.name = bt;        
@@ -532,7 +561,7 @@ private:
         if (bt != END_RECORD) {
             
             string line;
-            while (getline(in, line)) {
+            while (in.next(line)) {
 
                 if (line.empty() || line[0] == ' ' || line[0] == '\t') {
                     // Add this line to the block
@@ -540,11 +569,7 @@ private:
                 }
                 else {
                 
-                    std::istringstream iss(line);
-                    string word;
-                    iss >> word;
-
-                    BlockType bt = blockTypeFromString(word);
+                    BlockType bt = blockTypeFromString(firstWord(line));
 
                     if (bt != UNKNOWN_BLOCKTYPE) {
                         // We got to another block (or something unknown) so override 
@@ -567,7 +592,11 @@ private:
     
 public:
    
-    static shared_ptr<Genbank> readRecord(ifstream& in) {
+    static shared_ptr<Genbank> readRecord(LineReader& in) {
+        return readRecord(in, NULL);
+    }
+    
+    static shared_ptr<Genbank> readRecord(LineReader& in, ParseLog* log) {
         
         shared_ptr<Genbank> gb = make_shared<Genbank>();
         
@@ -575,7 +604,7 @@ public:
         
         string line;
         
-        if (!getline(in, line)) {
+        if (!in.next(line)) {
             // Reached end of file
             return shared_ptr<Genbank>();
         }
@@ -584,12 +613,16 @@ public:
         while (!done) {
 
             shared_ptr<Block> b = make_shared<Block>();
-            done = !readBlock(in, line, *b);
+            done = !readBlock(in, line, *b, log);
             
             // Exit loop if this is an end record marker
             if (b->name == END_RECORD) {
                 done = true;
             }
+            else if (b->name == UNKNOWN_BLOCKTYPE) {
+                // Already counted by readBlock
+                continue;
+            }
             else {
             
                 switch (b->name) {
@@ -632,19 +665,33 @@ public:
     
     
     static void load(const string& path, std::vector< boost::shared_ptr<Genbank> >& genbank) {
+        load(path, genbank, 1);
+    }
+    
+    static void load(const string& path, std::vector< boost::shared_ptr<Genbank> >& genbank, uint16_t threads) {
+        load(path, genbank, threads, NULL);
+    }
+    
+    /**
+     * Loads every record from the file at path.  If a log is given, blocks of
+     * an unknown type are counted there and dropped, otherwise the first one
+     * aborts the load.
+     */
+    static void load(const string& path, std::vector< boost::shared_ptr<Genbank> >& genbank, uint16_t threads, ParseLog* log) {
     
         auto_cpu_timer timer(1, " = Wall time taken: %ws\n\n");
         cout << " - Loading Genbank: " << path << endl;
         
-        ifstream file(path.c_str());        
+        // Walk the lines of the (possibly inflated) file contents in place
+        FileBuffer buffer(path, threads);
+        LineReader file(buffer.begin(), buffer.end());
         
-        while (file.good()) {            
-            shared_ptr<Genbank> gb = readRecord(file);
+        while (!file.done()) {            
+            shared_ptr<Genbank> gb = readRecord(file, log);
             if (gb != NULL) {                
                 genbank.push_back(gb);                
             }
         }
-        file.close();
         
         cout << " - Loaded " << genbank.size() << " genbank records." << endl;
     }
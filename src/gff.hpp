@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <new>
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -30,20 +31,44 @@ using std::ofstream;
 using std::ostream;
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind/bind.hpp>
 #include <boost/exception/all.hpp>
+#include <boost/exception_ptr.hpp>
 #include <boost/timer/timer.hpp>
 #include <boost/foreach.hpp>
+#include <boost/function.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
 #include <boost/unordered_map.hpp>
-#include <boost/enable_shared_from_this.hpp>
+#include <boost/unordered_set.hpp>
 using boost::lexical_cast;
 using boost::timer::auto_cpu_timer;
 using boost::make_shared;
 using boost::shared_ptr;
 using boost::unordered_map;
 
+#include "front_coded.hpp"
+#include "parse_log.hpp"
+#include "string_pool.hpp"
+#include "io/binary.hpp"
+#include "io/file_buffer.hpp"
+#include "io/text_writer.hpp"
+#include "io/tokenizer.hpp"
+using gts::io::BinaryReader;
+using gts::io::BinaryWriter;
+using gts::io::DelimSet;
+using gts::io::FileBuffer;
+using gts::io::FileBufferPtr;
+using gts::io::MappedFilePtr;
+using gts::io::StrRef;
+using gts::io::TextWriter;
+using gts::ParseLog;
+using gts::StringPool;
+
 namespace gts {
 namespace gff {
 
@@ -89,44 +114,55 @@ enum GffType {
     ANY
 };
 
-static GffType gffTypeFromString(string& s) {
+/**
+ * Switching on the length, and then the first character, means at most two
+ * case insensitive comparisons are needed to identify any type
+ */
+static GffType gffTypeFromString(const StrRef& s) {
     
-    if (boost::iequals(s, "gene")) {
-        return GENE;
-    }
-    else if (boost::iequals(s, "mRNA")) {
-        return MRNA;
-    }
-    else if (boost::iequals(s, "miRNA")) {
-        return MIRNA;
-    }
-    else if (boost::iequals(s, "protein")) {
-        return PROTEIN;
-    }
-    else if (boost::iequals(s, "five_prime_utr")) {
-        return UTR5;
-    }
-    else if (boost::iequals(s, "three_prime_utr")) {
-        return UTR3;
-    }
-    else if (boost::iequals(s, "cds")) {
-        return CDS;
-    }
-    else if (boost::iequals(s, "transcript")) {
-        return TRANSCRIPT;
-    }
-    else if (boost::iequals(s, "exon")) {
-        return EXON;
-    }
-    else if (boost::iequals(s, "tss")) {
-        return TSS;
-    }
-    else if (boost::iequals(s, "tts")) {
-        return TTS;
-    }
-    else {
+    if (s.empty()) {
         return OTHER;
     }
+    
+    const char first = StrRef::toLower(s[0]);
+    
+    switch(s.size()) {
+        case 3:
+            if (first == 'c') {
+                return s.iequals("cds") ? CDS : OTHER;
+            }
+            else if (first == 't') {
+                return s.iequals("tss") ? TSS : s.iequals("tts") ? TTS : OTHER;
+            }
+            break;
+        case 4:
+            if (first == 'g') {
+                return s.iequals("gene") ? GENE : OTHER;
+            }
+            else if (first == 'm') {
+                return s.iequals("mRNA") ? MRNA : OTHER;
+            }
+            else if (first == 'e') {
+                return s.iequals("exon") ? EXON : OTHER;
+            }
+            break;
+        case 5:
+            return s.iequals("miRNA") ? MIRNA : OTHER;
+        case 7:
+            return s.iequals("protein") ? PROTEIN : OTHER;
+        case 10:
+            return s.iequals("transcript") ? TRANSCRIPT : OTHER;
+        case 14:
+            return s.iequals("five_prime_utr") ? UTR5 : OTHER;
+        case 15:
+            return s.iequals("three_prime_utr") ? UTR3 : OTHER;
+    }
+    
+    return OTHER;
+}
+
+inline GffType gffTypeFromString(const string& s) {
+    return gffTypeFromString(StrRef(s.data(), s.data() + s.size()));
 }
 
 static string gffTypeToString(GffType type) {
@@ -159,80 +195,562 @@ static string gffTypeToString(GffType type) {
     }    
 }
 
+/**
+ * The column 9 attributes that GFF records keep.  Everything else is ignored.
+ */
+enum AttribKey {
+    // GFF3
+    ATTR_ID,
+    ATTR_NAME,
+    ATTR_PARENT,
+    ATTR_ALIAS,
+    ATTR_NOTE,
+    ATTR_TARGET,
+    ATTR_GAP,
+    ATTR_DERIVES_FROM,
+    ATTR_INDEX,
+    // GTF / Cufflinks
+    ATTR_GENE_ID,
+    ATTR_TRANSCRIPT_ID,
+    ATTR_EXON_NUMBER,
+    ATTR_FPKM,
+    ATTR_FRAC,
+    ATTR_CONF_LO,
+    ATTR_CONF_HI,
+    ATTR_COVERAGE,
+    ATTR_OTHER
+};
+
+/**
+ * Identifies a GFF3 attribute key.  Like gffTypeFromString this switches on
+ * the length so each key needs at most two comparisons.
+ */
+static AttribKey gff3AttribKeyFromString(const StrRef& key) {
+    
+    switch(key.size()) {
+        case 2:
+            return key.iequals("ID") ? ATTR_ID : ATTR_OTHER;
+        case 3:
+            return key.iequals("Gap") ? ATTR_GAP : ATTR_OTHER;
+        case 4:
+            return key.iequals("Name") ? ATTR_NAME : key.iequals("Note") ? ATTR_NOTE : ATTR_OTHER;
+        case 5:
+            return key.iequals("Alias") ? ATTR_ALIAS : key.iequals("Index") ? ATTR_INDEX : ATTR_OTHER;
+        case 6:
+            return key.iequals("Parent") ? ATTR_PARENT : key.iequals("Target") ? ATTR_TARGET : ATTR_OTHER;
+        case 12:
+            return key.iequals("Derives_from") ? ATTR_DERIVES_FROM : ATTR_OTHER;
+    }
+    
+    return ATTR_OTHER;
+}
+
+/**
+ * Identifies a GTF attribute key, including those added by Cufflinks
+ */
+static AttribKey gtfAttribKeyFromString(const StrRef& key) {
+    
+    switch(key.size()) {
+        case 4:
+            return key.iequals("FPKM") ? ATTR_FPKM : key.iequals("frac") ? ATTR_FRAC : ATTR_OTHER;
+        case 7:
+            // gene_id, conf_lo and conf_hi
+            if (StrRef::toLower(key[0]) == 'g') {
+                return key.iequals("gene_id") ? ATTR_GENE_ID : ATTR_OTHER;
+            }
+            return key.iequals("conf_lo") ? ATTR_CONF_LO : key.iequals("conf_hi") ? ATTR_CONF_HI : ATTR_OTHER;
+        case 8:
+            return key.iequals("coverage") ? ATTR_COVERAGE : ATTR_OTHER;
+        case 11:
+            return key.iequals("exon_number") ? ATTR_EXON_NUMBER : ATTR_OTHER;
+        case 13:
+            return key.iequals("transcript_id") ? ATTR_TRANSCRIPT_ID : ATTR_OTHER;
+    }
+    
+    return ATTR_OTHER;
+}
+
+/**
+ * Decides which lines GFF::load keeps, by feature type, sequence id and
+ * coordinates.  It's evaluated on the raw columns of each line, before any
+ * attributes are parsed or a record is allocated.  Each criterion that's
+ * left empty matches everything.
+ */
+class GFFFilter {
+    
+public:
+    
+    /**
+     * A coordinate range on one sequence, or on all sequences if seqId is
+     * empty.  Features overlapping it by at least one base match.
+     */
+    struct Region {
+        string seqId;
+        int32_t start;
+        int32_t end;
+        
+        Region(const string& seqId, int32_t start, int32_t end) : seqId(seqId), start(start), end(end) {}
+    };
+    
+private:
+    
+    // Look up sequence ids without building a string for every line
+    struct SeqIdHash {
+        size_t operator()(const StrRef& s) const {
+            return boost::hash_range(s.b, s.e);
+        }
+        size_t operator()(const string& s) const {
+            return boost::hash_range(s.data(), s.data() + s.size());
+        }
+    };
+    
+    struct SeqIdEquals {
+        bool operator()(const StrRef& a, const string& b) const {
+            return a.size() == b.size() && memcmp(a.b, b.data(), b.size()) == 0;
+        }
+        bool operator()(const string& a, const string& b) const {
+            return a == b;
+        }
+    };
+    
+    static const uint32_t ALL_TYPES = 0xFFFFFFFF;
+    
+    // Bit i is set when GffType i is kept, or all bits when types aren't filtered
+    uint32_t types;
+    boost::unordered_set<string, SeqIdHash, SeqIdEquals> seqIds;
+    vector<Region> regions;
+    
+public:
+    
+    GFFFilter() : types(ALL_TYPES) {}
+    
+    /**
+     * Keeps only the given type, or everything for ANY.  Lets a single GffType
+     * be passed wherever a filter is expected.
+     */
+    GFFFilter(GffType type) : types(ALL_TYPES) {
+        if (type != ANY) {
+            types = 0;
+            addType(type);
+        }
+    }
+    
+    GFFFilter& addType(GffType type) {
+        types = types == ALL_TYPES ? 0 : types;
+        types |= 1u << type;
+        return *this;
+    }
+    
+    GFFFilter& addSeqId(const string& seqId) {
+        seqIds.insert(seqId);
+        return *this;
+    }
+    
+    GFFFilter& addRegion(const string& seqId, int32_t start, int32_t end) {
+        regions.push_back(Region(seqId, start, end));
+        return *this;
+    }
+    
+    bool keepsEverything() const {
+        return types == ALL_TYPES && seqIds.empty() && regions.empty();
+    }
+    
+    /**
+     * Whether the line should be kept.  Lines with too few columns to check
+     * are kept, so that the parser reports them.
+     */
+    bool matches(const StrRef& line) const {
+        
+        if (keepsEverything()) {
+            return true;
+        }
+        
+        static const DelimSet TAB("\t");
+        
+        // Only the first five columns are looked at, so the rest of the line,
+        // i.e. usually most of it, isn't even scanned
+        const size_t NB_COLUMNS = 5;
+        StrRef parts[NB_COLUMNS];
+        const size_t nbParts = gts::io::splitFirst(line, TAB, parts, NB_COLUMNS, true);
+        
+        if (nbParts < NB_COLUMNS) {
+            return true;
+        }
+        
+        if (types != ALL_TYPES && !(types & (1u << gffTypeFromString(parts[2])))) {
+            return false;
+        }
+        
+        if (!seqIds.empty() && seqIds.find(parts[0], SeqIdHash(), SeqIdEquals()) == seqIds.end()) {
+            return false;
+        }
+        
+        if (!regions.empty()) {
+            
+            int32_t start, end;
+            
+            if (!gts::io::parseInt(parts[3], start) || !gts::io::parseInt(parts[4], end)) {
+                return true;
+            }
+            
+            BOOST_FOREACH(const Region& r, regions) {
+                
+                if ((r.seqId.empty() || SeqIdEquals()(parts[0], r.seqId)) && start <= r.end && end >= r.start) {
+                    return true;
+                }
+            }
+            
+            return false;
+        }
+        
+        return true;
+    }
+    
+    string toString() const {
+        
+        vector<string> parts;
+        
+        if (types != ALL_TYPES) {
+            vector<string> names;
+            for(int t = GENE; t < ANY; t++) {
+                if (types & (1u << t)) {
+                    names.push_back(gffTypeToString(static_cast<GffType>(t)));
+                }
+            }
+            parts.push_back(string("type ") + boost::algorithm::join(names, ","));
+        }
+        
+        if (!seqIds.empty()) {
+            parts.push_back(string("seqId ") + boost::algorithm::join(vector<string>(seqIds.begin(), seqIds.end()), ","));
+        }
+        
+        BOOST_FOREACH(const Region& r, regions) {
+            parts.push_back(string("region ") + (r.seqId.empty() ? string("*") : r.seqId) + ":" + 
+                    lexical_cast<string>(r.start) + "-" + lexical_cast<string>(r.end));
+        }
+        
+        return boost::algorithm::join(parts, "; ");
+    }
+};
+
 class GFF;
+class GFFArena;
 class GFFModel;
 
-typedef boost::shared_ptr<gts::gff::GFF> GFFPtr;
+// GFF records are owned by the GFFArena they were created in, so are passed
+// around as plain pointers
+typedef gts::gff::GFF* GFFPtr;
+typedef boost::shared_ptr<gts::gff::GFFArena> GFFArenaPtr;
 typedef boost::shared_ptr<gts::gff::GFFModel> GFFModelPtr;
 
 typedef std::vector<GFFPtr> GFFList;
 typedef boost::unordered_map<string, GFFPtr> GFFIdMap;
 
+// Position of each shared feature already written to a binary cache
+typedef boost::unordered_map<GFFPtr, size_t> SharedIndex;
+
+// Shared features already written out as text
+typedef boost::unordered_set<const gts::gff::GFF*> SharedSet;
+
 typedef boost::shared_ptr<GFFList> GFFListPtr;
 typedef boost::shared_ptr<GFFIdMap> GFFIdMapPtr;
 
-class GFF : public boost::enable_shared_from_this<GFF> {
+/**
+ * Owns GFF records, allocating them in large blocks and destroying them all
+ * at once when the arena is cleared or destroyed.  This avoids per record
+ * heap allocations and reference counting, and lets records link to each
+ * other with plain pointers.  Not thread safe, so concurrent loaders each use
+ * their own arena and adopt the others' records afterwards.
+ */
+class GFFArena : boost::noncopyable {
     
 private:
     
-    // Enum indicating which format this file is: (GFF2, GFF3, GTF)
-    FileFormat fileFormat;
+    static const size_t BLOCK_SIZE = 4096;
     
-    // GFF2, GFF3 and GTF features
-    string seqId;
-    string source;    
-    GffType type;
-    int32_t start;
-    int32_t end;
-    double score;
-    char strand;
-    int8_t phase;
+    struct Block {
+        GFF* records;
+        size_t used;
+    };
+    
+    vector<Block> blocks;
+    size_t size;
+    
+    // Dictionary of the ids of genes and transcripts linked into models over
+    // this arena.  Only created once needed.
+    boost::scoped_ptr<StringPool> keys;
+    
+    // Input buffers that records' lines point into, with the bytes each holds
+    struct Buffer {
+        boost::shared_ptr<void> owner;
+        const char* begin;
+        const char* end;
+    };
+    
+    vector<Buffer> buffers;
+    
+public:
+    
+    GFFArena() : size(0) {}
+    
+    virtual ~GFFArena() {
+        clear();
+    }
+    
+    GFF* create(FileFormat fileFormat);
+    
+    /**
+     * Copies gff, but not its children, into this arena.  The copy keeps
+     * the line gff was read from if this arena keeps the buffer it's in, as
+     * a stage model over the same arena as its input does, so both are
+     * written out as they were read.  Otherwise it's written from its
+     * fields.
+     */
+    GFF* copy(const GFF& gff);
+    
+    /**
+     * Destroys the most recently created record, e.g. one that was parsed
+     * but then filtered out
+     */
+    void discardLast();
     
-    // GFF3 attributes
-    string id;
+    /**
+     * A dense integer standing for gff's id, shared by every record with
+     * that id that's keyed here.  Models index their genes and transcripts by
+     * these rather than hashing id strings over and over, so the id is only
+     * hashed the first time.  Keys are only meaningful within the arena that
+     * gave them, and are forgotten when it's cleared.
+     */
+    uint32_t keyOf(GFFPtr gff);
+    
+    /**
+     * The key of id, or StringPool::NONE if no record with that id has been
+     * keyed here
+     */
+    uint32_t findKey(const string& id) {
+        return keys ? keys->find(id) : StringPool::NONE;
+    }
+    
+    /**
+     * Creates the dictionary up front, so that keyOf can be called from
+     * several threads at once
+     */
+    void prepareKeys() {
+        if (!keys) {
+            keys.reset(new StringPool());
+        }
+    }
+    
+    /**
+     * Takes ownership of all the records held by other, leaving it empty.
+     * Records shouldn't have been keyed in other.
+     */
+    void adopt(GFFArena& other) {
+        blocks.insert(blocks.end(), other.blocks.begin(), other.blocks.end());
+        buffers.insert(buffers.end(), other.buffers.begin(), other.buffers.end());
+        size += other.size;
+        other.blocks.clear();
+        other.buffers.clear();
+        other.size = 0;
+    }
+    
+    /**
+     * Keeps buffer alive until this arena is cleared, so that records can
+     * point at the lines they were read from, see GFF::SetLine.  Works with
+     * anything that has begin() and end(), such as FileBuffer or MappedFile.
+     */
+    template<class T>
+    void keep(const boost::shared_ptr<T>& buffer) {
+        Buffer kept = { buffer, buffer->begin(), buffer->end() };
+        buffers.push_back(kept);
+    }
+    
+    /**
+     * True if p points into one of the buffers kept here
+     */
+    bool holds(const char* p) const {
+        BOOST_FOREACH(const Buffer& buffer, buffers) {
+            if (p >= buffer.begin && p < buffer.end) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    /**
+     * Destroys every record in this arena
+     */
+    void clear();
+    
+    size_t GetSize() const {
+        return size;
+    }
+    
+private:
+    
+    void* allocate();
+};
+
+// Receives each complete gene from GFFModel::stream
+typedef boost::function<void (GFFPtr)> GeneHandler;
+
+/**
+ * GFF3 attributes which most records don't have.  Stored separately from the
+ * GFF record and only allocated when at least one is present.
+ */
+struct GFF3Attribs {
     string cdsid;
     string name;
     string alias;
     string note;
-    string parentId;
     string target;
     string gap;
     bool circular;
     string derivesFrom;
     string index;
     
-    // GTF attributes
+    GFF3Attribs() : circular(false) {}
+};
+
+/**
+ * Attributes only present in GTF (and GFF2) records
+ */
+struct GTFAttribs {
     string geneId;
     string transcriptId;
-    
-    // Cufflinks GTF attributes
+};
+
+/**
+ * Attributes only present in Cufflinks GTF records.  Only allocated when a
+ * record has one of them, otherwise they all read as zero.  Which of them
+ * the record actually has is flagged in present, by bit(key), so only those
+ * are written out.
+ */
+struct CufflinksAttribs {
     uint16_t exonNumber;
     double fpkm;
     double frac;
     double confLo;
     double confHigh;    
     double coverage;
+    uint8_t present;
+    
+    CufflinksAttribs() : exonNumber(0), fpkm(0.0), frac(0.0), confLo(0.0), confHigh(0.0), coverage(0.0), present(0) {}
+    
+    static uint8_t bit(AttribKey key) {
+        return 1u << (key - ATTR_EXON_NUMBER);
+    }
+    
+    bool has(AttribKey key) const {
+        return present & bit(key);
+    }
+};
+
+class GFF {
+    
+private:
+    
+    // Enum indicating which format this file is: (GFF2, GFF3, GTF)
+    FileFormat fileFormat;
+    
+    // GFF2, GFF3 and GTF features.  Sequence ids and sources take few distinct
+    // values, so are held as handles into the global string pool
+    uint32_t seqId;
+    uint32_t source;
+    GffType type;
+    int32_t start;
+    int32_t end;
+    double score;
+    char strand;
+    int8_t phase;
+    
+    // Set on features with more than one parent transcript.  These are held
+    // once and listed as a child of every parent, with parent pointing at the
+    // first one they were attached to.
+    bool shared;
+    
+    // Flags which of id and parentId compact() has cut down to what can't be
+    // worked out from the parent, and whether what's left of id has been
+    // moved into the IdStore by storeIds
+    uint8_t compacted;
     
-    // Children
+    enum {
+        COMPACT_ID = 1,
+        COMPACT_PARENT_ID = 2,
+        COMPACT_STORED = 4
+    };
+    
+    // Key of this record's id in its arena's dictionary, once it's been
+    // linked into a model, otherwise StringPool::NONE
+    uint32_t key;
+    
+    // Handles of the root of id and of the GTF transcript id, in the pool
+    // whose serial is rootPool.  Worked out the first time they're asked
+    // for, then kept until the id they come from is set, or they're asked
+    // for from another pool.  StringPool::NONE until then.
+    mutable uint32_t rootId;
+    mutable uint32_t rootTranscriptId;
+    mutable uint32_t rootPool;
+    
+    // Stands in for the file format of a record in the binary cache, to mark
+    // a reference back to a shared feature that's already been written
+    enum { SHARED_REF = 0xFF };
+    
+    // Column 9 exactly as parsed.  Each attribute is only decoded from it,
+    // into the fields below, the first time it's asked for, and the keys
+    // decoded so far are flagged in decoded.  Emptied once everything has
+    // been decoded.
+    string attribs;
+    mutable uint32_t decoded;
+    
+    // Index of id in IdStore::global(), when flagged COMPACT_STORED
+    uint32_t storedId;
+    
+    // The line this record was read from, in a buffer kept by its arena,
+    // which is written back out as it was for as long as the record isn't
+    // modified.  NULL once anything's been set, and for records that were
+    // created rather than read.
+    const char* line;
+    uint32_t lineSize;
+    
+    // GFF3 attributes nearly every record has
+    mutable string id;
+    mutable string parentId;
+    
+    // Everything else is only allocated when present
+    mutable boost::scoped_ptr<GFF3Attribs> gff3;
+    mutable boost::scoped_ptr<GTFAttribs> gtf;
+    mutable boost::scoped_ptr<CufflinksAttribs> cufflinks;
+    
+    // Children.  The containers are only allocated once a child is added, as
+    // most records (exons, CDSes, UTRs) never have any.  All records belong to
+    // an arena so none of these links own anything.
     GFFPtr parent;
-    GFFIdMapPtr childMap;
-    GFFListPtr childList;
+    boost::scoped_ptr<GFFIdMap> childMap;
+    boost::scoped_ptr<GFFList> childList;
     
 public:
 
     GFF(FileFormat fileFormat) : 
         fileFormat(fileFormat),
-        seqId(""), 
-        source(""), 
+        seqId(StringPool::EMPTY), 
+        source(StringPool::EMPTY), 
         type(OTHER), 
         start(0), end(0),
         score(-1.0),
         strand('.'),
-        phase(-1) {
-            
-        childMap = make_shared<GFFIdMap>();
-        childList = make_shared<GFFList>();
-        
+        phase(-1),
+        shared(false),
+        compacted(0),
+        key(StringPool::NONE),
+        rootId(StringPool::NONE),
+        rootTranscriptId(StringPool::NONE),
+        rootPool(0),
+        decoded(0),
+        storedId(0),
+        line(NULL),
+        lineSize(0),
+        parent(NULL) {
     }
         
     GFF(const GFF& gff) : 
@@ -243,68 +761,62 @@ public:
         start(gff.start), end(gff.end),
         score(gff.score),
         strand(gff.strand),
-        phase(gff.phase) {
-        
-        id = gff.id;
-        cdsid = gff.cdsid;
-        name = gff.name;
-        alias = gff.alias;
-        note = gff.note;
-        parentId = gff.parentId;
-        target = gff.target;
-        gap = gff.gap;
-        circular = gff.circular;
-        derivesFrom = gff.derivesFrom;
-        index = gff.index;
-        
-        childMap = make_shared<GFFIdMap>();
-        childList = make_shared<GFFList>();
-        
-    }
-
-    virtual ~GFF() {
-
-        removeLinks();
-    }
-    
-    void removeLinks() {
-        
-        if (childList && !childList->empty()) {
-            BOOST_FOREACH(GFFPtr gff, *childList) {
-                if (gff) {
-                    gff->removeLinks();                
-                    gff.reset();
-                }
-            }
-            childList.reset();
+        phase(gff.phase),
+        shared(gff.shared),
+        compacted(0),
+        key(StringPool::NONE),
+        rootId(StringPool::NONE),
+        rootTranscriptId(StringPool::NONE),
+        rootPool(0),
+        decoded(0),
+        storedId(0),
+        line(NULL),
+        lineSize(0),
+        parent(NULL) {
+        
+        // The line isn't copied here, as the copy may outlive it, see
+        // GFFArena::copy
+        gff.decodeAll();
+        
+        id = gff.GetId();
+        parentId = gff.GetParentId();
+        
+        if (gff.gff3) {
+            gff3.reset(new GFF3Attribs(*gff.gff3));
         }
-        
-        if (childMap && !childMap->empty()) {
-           BOOST_FOREACH(GFFIdMap::value_type& i, *childMap) {
-                if (i.second) {
-                    i.second->removeLinks();                
-                    i.second.reset();
-                }
-            }
-            childList.reset(); 
+        if (gff.gtf) {
+            gtf.reset(new GTFAttribs(*gff.gtf));
+        }
+        if (gff.cufflinks) {
+            cufflinks.reset(new CufflinksAttribs(*gff.cufflinks));
         }
-        
-        
     }
+
+    virtual ~GFF() {}
         
     int8_t GetPhase() const {
         return phase;
     }
 
     void SetPhase(int8_t phase) {
+        line = NULL;
         this->phase = phase;
     }
 
+    bool IsShared() const {
+        return shared;
+    }
+
+    void SetShared(bool shared) {
+        this->shared = shared;
+    }
+
     double GetScore() const {
         return score;
     }
 
     void SetScore(double score) {
+        line = NULL;
         this->score = score;
     }
     
@@ -313,63 +825,165 @@ public:
     }
 
     void SetStrand(char strand) {
+        line = NULL;
         this->strand = strand;
     }
 
-    string GetSeqId() const {
+    const string& GetSeqId() const {
+        return StringPool::global().resolve(seqId);
+    }
+
+    uint32_t GetSeqIdHandle() const {
         return seqId;
     }
 
-    void SetSeqId(string seqId) {
-        this->seqId = seqId;
+    void SetSeqId(const string& seqId) {
+        line = NULL;
+        this->seqId = StringPool::global().intern(seqId);
     }
 
-    string GetSource() const {
+    const string& GetSource() const {
+        return StringPool::global().resolve(source);
+    }
+
+    uint32_t GetSourceHandle() const {
         return source;
     }
 
-    void SetSource(string source) {
-        this->source = source;
+    void SetSource(const string& source) {
+        line = NULL;
+        this->source = StringPool::global().intern(source);
     }
 
     
     double GetCoverage() const {
-        return coverage;
+        decode(ATTR_COVERAGE);
+        return cufflinks ? cufflinks->coverage : 0;
     }
 
     void SetCoverage(double coverage) {
-        this->coverage = coverage;
+        markDecoded(ATTR_COVERAGE);
+        cufflinksAttribs(ATTR_COVERAGE).coverage = coverage;
     }
 
     string GetId() const {
-        return id;
+        
+        decode(ATTR_ID);
+        
+        if (compacted & COMPACT_STORED) {
+            string stored;
+            IdStore::global().decode(storedId, stored);
+            return compacted & COMPACT_ID ? parent->GetId() + stored : stored;
+        }
+        
+        return compacted & COMPACT_ID ? parent->GetId() + id : id;
     }
 
     void SetId(string id) {
+        markDecoded(ATTR_ID);
+        compacted &= ~(COMPACT_ID | COMPACT_STORED);
+        key = StringPool::NONE;
+        rootId = StringPool::NONE;
         this->id = id;
     }
     
+    /**
+     * The key GFFArena::keyOf gave this record's id, or StringPool::NONE if
+     * it hasn't been given one yet, or its id has changed since
+     */
+    uint32_t GetKey() const {
+        return key;
+    }
+    
+    void SetKey(uint32_t key) {
+        this->key = key;
+    }
+
+    /**
+     * True unless this record still has the line it was read from, i.e. it
+     * was created rather than read, or something has been set since
+     */
+    bool IsModified() const {
+        return line == NULL;
+    }
+
+    /**
+     * Remembers [begin, end) as the line this record was parsed from, to be
+     * written back out as is until the record is modified.  The line must
+     * outlive the record, e.g. by being in a buffer its arena keeps.
+     */
+    void SetLine(const char* begin, const char* end) {
+
+        if (static_cast<size_t>(end - begin) <= 0xFFFFFFFF) {
+            line = begin;
+            lineSize = end - begin;
+        }
+    }
+
+    /**
+     * The line this record was read from, or an empty range once it's been
+     * modified, see IsModified
+     */
+    StrRef GetLine() const {
+        return line != NULL ? StrRef(line, line + lineSize) : StrRef();
+    }
+    
+    /**
+     * Forgets the line this record was read from, so it's written out from
+     * its fields from now on
+     */
+    void markModified() {
+        line = NULL;
+    }
+
+    /**
+     * The id up to the first '|', less anything up to and including "cds"
+     * and the character after it
+     */
     string GetRootId() const {
         
-        vector<string> idElements;
-        boost::split( idElements, id, boost::is_any_of("|"), boost::token_compress_on );
-        size_t pos = idElements[0].find("cds");
-        return pos != std::string::npos ? idElements[0].substr(pos+4) : idElements[0];        
+        const string id = GetId();
+        const StrRef root = rootIdOf(id);
+        return string(root.b, root.e);
+    }
+    
+    /**
+     * The handle of the root id in ids.  It's interned the first time it's
+     * asked for, then kept with the record until it's asked for from a
+     * different pool.
+     */
+    uint32_t GetRootIdHandle(StringPool& ids) const {
+        
+        useRootPool(ids);
+        
+        if (rootId == StringPool::NONE) {
+            
+            const string id = GetId();
+            const StrRef root = rootIdOf(id);
+            rootId = ids.intern(root.b, root.e);
+        }
+        
+        return rootId;
     }
 
     string GetName() const {
-        return name;
+        decode(ATTR_NAME);
+        return gff3 ? gff3->name : string();
     }
 
     void SetName(string name) {
-        this->name = name;
+        markDecoded(ATTR_NAME);
+        gff3Attribs().name = name;
     }
 
     string GetParentId() const {
-        return parentId;
+        decode(ATTR_PARENT);
+        return compacted & COMPACT_PARENT_ID ? parent->GetId() : parentId;
     }
 
     void SetParentId(string parent) {
+        markDecoded(ATTR_PARENT);
+        compacted &= ~COMPACT_PARENT_ID;
         this->parentId = parent;
     }
 
@@ -378,6 +992,7 @@ public:
     }
 
     void SetType(GffType type) {
+        line = NULL;
         this->type = type;
     }
     
@@ -386,6 +1001,7 @@ public:
     }
 
     void SetEnd(int32_t end) {
+        line = NULL;
         this->end = end;
     }
     
@@ -398,48 +1014,58 @@ public:
     }
 
     void SetStart(int32_t start) {
+        line = NULL;
         this->start = start;
     }
     
     string GetAlias() const {
-        return alias;
+        decode(ATTR_ALIAS);
+        return gff3 ? gff3->alias : string();
     }
 
     void SetAlias(string alias) {
-        this->alias = alias;
+        markDecoded(ATTR_ALIAS);
+        gff3Attribs().alias = alias;
     }
     
     string GetNote() const {
-        return note;
+        decode(ATTR_NOTE);
+        return gff3 ? gff3->note : string();
     }
 
     void SetNote(string note) {
-        this->note = note;
+        markDecoded(ATTR_NOTE);
+        gff3Attribs().note = note;
     }
 
 
     bool IsCircular() const {
-        return circular;
+        return gff3 ? gff3->circular : false;
     }
 
     void SetCircular(bool circular) {
-        this->circular = circular;
+        line = NULL;
+        gff3Attribs().circular = circular;
     }
     
     string GetDerivesFrom() const {
-        return derivesFrom;
+        decode(ATTR_DERIVES_FROM);
+        return gff3 ? gff3->derivesFrom : string();
     }
 
     void SetDerivesFrom(string derivesFrom) {
-        this->derivesFrom = derivesFrom;
+        markDecoded(ATTR_DERIVES_FROM);
+        gff3Attribs().derivesFrom = derivesFrom;
     }
     
     string GetIndex() const {
-        return index;
+        decode(ATTR_INDEX);
+        return gff3 ? gff3->index : string();
     }
 
     void SetIndex(string index) {
-        this->index = index;
+        markDecoded(ATTR_INDEX);
+        gff3Attribs().index = index;
     }
 
     FileFormat GetFileFormat() const {
@@ -447,88 +1073,130 @@ public:
     }
 
     void SetFileFormat(FileFormat fileFormat) {
+        // The raw attributes are interpreted according to the format
+        decodeAll();
+        line = NULL;
         this->fileFormat = fileFormat;
     }
 
     string GetGap() const {
-        return gap;
+        decode(ATTR_GAP);
+        return gff3 ? gff3->gap : string();
     }
 
     void SetGap(string gap) {
-        this->gap = gap;
+        markDecoded(ATTR_GAP);
+        gff3Attribs().gap = gap;
     }
 
     string GetGeneId() const {
-        return geneId;
+        decode(ATTR_GENE_ID);
+        return gtf ? gtf->geneId : string();
     }
 
     void SetGeneId(string geneId) {
-        this->geneId = geneId;
+        markDecoded(ATTR_GENE_ID);
+        gtfAttribs().geneId = geneId;
     }
 
     string GetTarget() const {
-        return target;
+        decode(ATTR_TARGET);
+        return gff3 ? gff3->target : string();
     }
 
     void SetTarget(string target) {
-        this->target = target;
+        markDecoded(ATTR_TARGET);
+        gff3Attribs().target = target;
     }
 
     string GetTranscriptId() const {
-        return transcriptId;
+        decode(ATTR_TRANSCRIPT_ID);
+        return gtf ? gtf->transcriptId : string();
     }
     
+    /**
+     * The transcript id when it has no '|', what follows it when there's
+     * one, and empty otherwise.  Runs of '|' count as one.
+     */
     string GetRootTranscriptId() const {
-        vector<string> idElements;
-        boost::split( idElements, transcriptId, boost::is_any_of("|"), boost::token_compress_on );
         
-        return idElements.size() == 1 ? idElements[0] :
-                    idElements.size() == 2 ? idElements[1] :
-                        "";
+        const string transcriptId = GetTranscriptId();
+        const StrRef root = rootTranscriptIdOf(transcriptId);
+        return string(root.b, root.e);
+    }
+    
+    /**
+     * The handle of the root transcript id in ids, kept with the record as
+     * GetRootIdHandle's is
+     */
+    uint32_t GetRootTranscriptIdHandle(StringPool& ids) const {
+        
+        useRootPool(ids);
+        
+        if (rootTranscriptId == StringPool::NONE) {
+            
+            const string transcriptId = GetTranscriptId();
+            const StrRef root = rootTranscriptIdOf(transcriptId);
+            rootTranscriptId = ids.intern(root.b, root.e);
+        }
+        
+        return rootTranscriptId;
     }
 
     void SetTranscriptId(string transcriptId) {
-        this->transcriptId = transcriptId;
+        markDecoded(ATTR_TRANSCRIPT_ID);
+        rootTranscriptId = StringPool::NONE;
+        gtfAttribs().transcriptId = transcriptId;
     }
     
     double GetConfHigh() const {
-        return confHigh;
+        decode(ATTR_CONF_HI);
+        return cufflinks ? cufflinks->confHigh : 0;
     }
 
     void SetConfHigh(double confHigh) {
-        this->confHigh = confHigh;
+        markDecoded(ATTR_CONF_HI);
+        cufflinksAttribs(ATTR_CONF_HI).confHigh = confHigh;
     }
 
     double GetConfLo() const {
-        return confLo;
+        decode(ATTR_CONF_LO);
+        return cufflinks ? cufflinks->confLo : 0;
     }
 
     void SetConfLo(double confLo) {
-        this->confLo = confLo;
+        markDecoded(ATTR_CONF_LO);
+        cufflinksAttribs(ATTR_CONF_LO).confLo = confLo;
     }
 
     uint16_t GetExonNumber() const {
-        return exonNumber;
+        decode(ATTR_EXON_NUMBER);
+        return cufflinks ? cufflinks->exonNumber : 0;
     }
 
     void SetExonNumber(uint16_t exonNumber) {
-        this->exonNumber = exonNumber;
+        markDecoded(ATTR_EXON_NUMBER);
+        cufflinksAttribs(ATTR_EXON_NUMBER).exonNumber = exonNumber;
     }
 
     double GetFpkm() const {
-        return fpkm;
+        decode(ATTR_FPKM);
+        return cufflinks ? cufflinks->fpkm : 0;
     }
 
     void SetFpkm(double fpkm) {
-        this->fpkm = fpkm;
+        markDecoded(ATTR_FPKM);
+        cufflinksAttribs(ATTR_FPKM).fpkm = fpkm;
     }
 
     double GetFrac() const {
-        return frac;
+        decode(ATTR_FRAC);
+        return cufflinks ? cufflinks->frac : 0;
     }
 
     void SetFrac(double frac) {
-        this->frac = frac;
+        markDecoded(ATTR_FRAC);
+        cufflinksAttribs(ATTR_FRAC).frac = frac;
     }
 
     void addChild(GFFPtr gff) {        
@@ -537,9 +1205,20 @@ public:
 
     void addChild(GFFPtr gff, bool noMap) {
         
-        string childId = gff->id;
+        gff->decode(ATTR_ID);
         
-        if (!noMap) {            
+        if (!childList) {
+            childList.reset(new GFFList());
+        }
+        
+        if (!noMap) {
+            
+            const string childId = gff->GetId();
+            
+            if (!childMap) {
+                childMap.reset(new GFFIdMap());
+            }
+            
             if (this->childMap->count(childId)) {
                 BOOST_THROW_EXCEPTION(GFFException() << GFFErrorInfo(string(
                     "Invalid GFF: Already seen this GFF in child map: ") + childId));
@@ -547,7 +1226,9 @@ public:
             (*(this->childMap))[childId] = gff;        
         }
         
-        gff->parent = shared_from_this();
+        if (!gff->shared || !gff->parent) {
+            gff->parent = this;
+        }
         this->childList->push_back(gff);
     }
     
@@ -555,8 +1236,12 @@ public:
         return this->childList ? this->childList->size() : 0;
     }
     
-    GFFListPtr GetChildList() const {
-        return childList;
+    /**
+     * Returns this record's children.  Records without children all share
+     * one empty list.
+     */
+    const GFFList& GetChildList() const {
+        return childList ? *childList : emptyList();
     }
     
     GFFListPtr GetAllChildren() const {
@@ -637,99 +1322,509 @@ public:
         }        
     }
 
-    GFFIdMapPtr GetChildMap() const {
-        return childMap;
+    const GFFIdMap& GetChildMap() const {
+        return childMap ? *childMap : emptyMap();
     }
 
 
     GFFPtr GetParent() {
         return this->parent;
     }
-
-
-
-    void writeGFF3Attribs(ostream& out) {
-        
-        vector<string> elems;
+    
+    /**
+     * Shrinks a linked feature by keeping only what its parent doesn't
+     * already tell us.  A Parent attribute naming the parent is dropped, and
+     * an ID starting with the parent's ID is cut down to the rest.  Both are
+     * rebuilt from the parent on access, so follow it if its ID changes.  The
+     * raw attributes are decoded, then dropped, first.  Shared features, and
+     * records without a parent, are left as they are.
+     */
+    void compact() {
+        
+        if (!parent || shared || compacted) {
+            return;
+        }
+        
+        decodeAll();
+        
+        const string parentOwnId = parent->GetId();
+        
+        if (parentOwnId.empty()) {
+            return;
+        }
+        
+        if (parentId == parentOwnId) {
+            string().swap(parentId);
+            compacted |= COMPACT_PARENT_ID;
+        }
+        
+        if (id.size() > parentOwnId.size() && id.compare(0, parentOwnId.size(), parentOwnId) == 0) {
+            string(id, parentOwnId.size()).swap(id);
+            compacted |= COMPACT_ID;
+        }
+    }
+    
+    /**
+     * Decodes every attribute now rather than the first time it's asked for.
+     * Reading a record from several threads at once is only safe after this.
+     */
+    void decodeAttributes() const {
+        decodeAll();
+    }
+    
+    /**
+     * Moves the ids of records, or what compact() left of them, into a
+     * front-coded dictionary in IdStore::global(), where they're decoded
+     * from on access.  Records with an empty id, or whose id is already
+     * stored, are skipped.  The dictionary lives as long as the program, so
+     * this is meant for models kept until the end.
+     */
+    static void storeIds(const GFFList& records) {
+        
+        vector<string> ids;
+        ids.reserve(records.size());
+        
+        BOOST_FOREACH(GFFPtr gff, records) {
+            gff->decode(ATTR_ID);
+            if (!(gff->compacted & COMPACT_STORED) && !gff->id.empty()) {
+                ids.push_back(gff->id);
+            }
+        }
         
-        elems.push_back(string("ID=") + id);
+        if (ids.empty()) {
+            return;
+        }
+        
+        FrontCodedDictionary* dictionary = new FrontCodedDictionary(ids);
+        const FrontCodedDictionary& lookup = *dictionary;
+        const uint32_t base = IdStore::global().add(dictionary);
         
-        if (!parentId.empty()) {
-            elems.push_back(string("Parent=") + parentId);
+        BOOST_FOREACH(GFFPtr gff, records) {
+            if (!(gff->compacted & COMPACT_STORED) && !gff->id.empty()) {
+                gff->storedId = base + lookup.find(gff->id);
+                gff->compacted |= COMPACT_STORED;
+                string().swap(gff->id);
+            }
         }
+    }
+
+
+
+private:
+    
+    /**
+     * Whether every Cufflinks numeric attribute in the raw GTF attributes
+     * attrs converts as setAttrib will convert it
+     */
+    static bool validNumericAttribs(const StrRef& attrs) {
+        
+        static const DelimSet SEMICOLON(";");
+        static const DelimSet SPACE(" ");
         
-        if (!name.empty()) {
-            elems.push_back(string("Name=") + name);
+        const char* p = attrs.b;
+        
+        while (p <= attrs.e) {
+            
+            const char* attrEnd = gts::io::findFirst(p, attrs.e, SEMICOLON);
+            
+            StrRef attr = gts::io::trim(StrRef(p, attrEnd));
+            p = attrEnd + 1;
+            
+            if (attr.empty()) {
+                continue;
+            }
+            
+            StrRef kv[2];
+            const size_t nbKv = gts::io::split(attr, SPACE, kv, 2, true);
+            
+            const AttribKey key = gtfAttribKeyFromString(kv[0]);
+            
+            if (key < ATTR_EXON_NUMBER || key > ATTR_COVERAGE) {
+                continue;
+            }
+            
+            // Strip the quotes surrounding the value, as decodeAttribs does
+            StrRef val = nbKv > 1 ? kv[1] : StrRef(attr.e, attr.e);
+            val = val.size() >= 2 ? StrRef(val.b + 1, val.e - 1) : StrRef(val.e, val.e);
+            
+            uint16_t exonNumber;
+            double value;
+            
+            if (key == ATTR_EXON_NUMBER ? !gts::io::tryToInt(val, exonNumber) : !gts::io::tryToDouble(val, value)) {
+                return false;
+            }
         }
         
-        if (!note.empty()) {
-            elems.push_back(string("Note=") + note);
+        return true;
+    }
+    
+    /**
+     * Counts a malformed line in log and returns NULL so the caller can skip
+     * it, or throws if there's no log to count it in
+     */
+    static GFFPtr reject(ParseLog* log, const char* problem, const char* begin, const char* end) {
+        
+        if (log == NULL) {
+            BOOST_THROW_EXCEPTION(GFFException() << GFFErrorInfo(string(
+                "Could not parse GFF line. ") + problem + ": " + string(begin, end)));
         }
         
-        if (!alias.empty()) {
-            elems.push_back(string("Alias=") + alias);
+        log->add(problem, begin, end);
+        return NULL;
+    }
+    
+    static uint32_t attribBit(AttribKey key) {
+        return 1u << key;
+    }
+    
+    /**
+     * Decodes key from the raw attributes unless that's already been done.
+     * Records that weren't parsed from text have nothing to decode.  The ids
+     * used to link records are nearly always asked for together, so they're
+     * decoded in the same pass.
+     */
+    void decode(AttribKey key) const {
+        
+        if (!attribs.empty() && !(decoded & attribBit(key))) {
+            
+            static const uint32_t LINK_GFF3 = (1u << ATTR_ID) | (1u << ATTR_PARENT);
+            static const uint32_t LINK_GTF = (1u << ATTR_GENE_ID) | (1u << ATTR_TRANSCRIPT_ID);
+            
+            const uint32_t bit = attribBit(key);
+            const uint32_t wanted = (bit & LINK_GFF3) ? LINK_GFF3 : (bit & LINK_GTF) ? LINK_GTF : bit;
+            
+            decodeAttribs(wanted & ~decoded);
+        }
+    }
+    
+    /**
+     * Decodes every attribute not yet decoded, then drops the raw attributes
+     */
+    void decodeAll() const {
+        
+        if (!attribs.empty()) {
+            decodeAttribs(~decoded);
+            string().swap(const_cast<GFF*>(this)->attribs);
         }
+    }
+    
+    /**
+     * Stops the raw attributes from overriding a value that's been set directly,
+     * which also means the record no longer matches the line it was read from
+     */
+    void markDecoded(AttribKey key) {
+        line = NULL;
+        decoded |= attribBit(key);
+    }
+    
+    /**
+     * Walks the raw attributes, storing the value of each key flagged in
+     * wanted.  Later occurrences of a key overwrite earlier ones.
+     */
+    void decodeAttribs(uint32_t wanted) const {
+        
+        static const DelimSet SEMICOLON(";");
+        static const DelimSet EQUALS("=");
+        static const DelimSet SPACE(" ");
+        
+        const StrRef attrs(attribs.data(), attribs.data() + attribs.size());
+        const char* p = attrs.b;
+        
+        while (p <= attrs.e) {
+            
+            const char* attrEnd = gts::io::findFirst(p, attrs.e, SEMICOLON);
+            
+            StrRef attr = gts::io::trim(StrRef(p, attrEnd));
+            
+            if (!attr.empty()) {
+                
+                StrRef kv[2];
+                
+                if (fileFormat == GFF3) {
+                    
+                    const size_t nbKv = gts::io::split(attr, EQUALS, kv, 2, true);
+                    
+                    const AttribKey key = gff3AttribKeyFromString(kv[0]);
+                    
+                    if (key != ATTR_OTHER && (wanted & attribBit(key))) {
+                        setAttrib(key, nbKv > 1 ? kv[1] : StrRef(attr.e, attr.e));
+                    }
+                }
+                else {
+                    
+                    const size_t nbKv = gts::io::split(attr, SPACE, kv, 2, true);
+                    
+                    const AttribKey key = gtfAttribKeyFromString(kv[0]);
+                    
+                    if (key != ATTR_OTHER && (wanted & attribBit(key))) {
                         
-        if (!target.empty()) {
-            elems.push_back(string("Target=") + target);
+                        // Strip the quotes surrounding the value
+                        StrRef val = nbKv > 1 ? kv[1] : StrRef(attr.e, attr.e);
+                        val = val.size() >= 2 ? StrRef(val.b + 1, val.e - 1) : StrRef(val.e, val.e);
+                        
+                        setAttrib(key, val);
+                    }
+                }
+            }
+            
+            p = attrEnd + 1;
+        }
+        
+        decoded |= wanted;
+    }
+    
+    void setAttrib(AttribKey key, const StrRef& val) const {
+        
+        switch(key) {
+            case ATTR_ID:
+                val.assignTo(id);
+                break;
+            case ATTR_NAME:
+                val.assignTo(gff3Attribs().name);
+                break;
+            case ATTR_PARENT:
+                val.assignTo(parentId);
+                break;
+            case ATTR_ALIAS:
+                val.assignTo(gff3Attribs().alias);
+                break;
+            case ATTR_NOTE:
+                val.assignTo(gff3Attribs().note);
+                break;
+            case ATTR_TARGET:
+                val.assignTo(gff3Attribs().target);
+                break;
+            case ATTR_GAP:
+                val.assignTo(gff3Attribs().gap);
+                break;
+            case ATTR_DERIVES_FROM:
+                val.assignTo(gff3Attribs().derivesFrom);
+                break;
+            case ATTR_INDEX:
+                val.assignTo(gff3Attribs().index);
+                break;
+            case ATTR_GENE_ID:
+                val.assignTo(gtfAttribs().geneId);
+                break;
+            case ATTR_TRANSCRIPT_ID:
+                val.assignTo(gtfAttribs().transcriptId);
+                break;
+            case ATTR_EXON_NUMBER:
+                cufflinksAttribs(ATTR_EXON_NUMBER).exonNumber = gts::io::toInt<uint16_t>(val);
+                break;
+            case ATTR_FPKM:
+                cufflinksAttribs(ATTR_FPKM).fpkm = gts::io::toDouble(val);
+                break;
+            case ATTR_FRAC:
+                cufflinksAttribs(ATTR_FRAC).frac = gts::io::toDouble(val);
+                break;
+            case ATTR_CONF_LO:
+                cufflinksAttribs(ATTR_CONF_LO).confLo = gts::io::toDouble(val);
+                break;
+            case ATTR_CONF_HI:
+                cufflinksAttribs(ATTR_CONF_HI).confHigh = gts::io::toDouble(val);
+                break;
+            case ATTR_COVERAGE:
+                cufflinksAttribs(ATTR_COVERAGE).coverage = gts::io::toDouble(val);
+                break;
+            default:
+                break;
+        }
+    }
+    
+    GFF3Attribs& gff3Attribs() const {
+        if (!gff3) {
+            gff3.reset(new GFF3Attribs());
+        }
+        return *gff3;
+    }
+    
+    GTFAttribs& gtfAttribs() const {
+        if (!gtf) {
+            gtf.reset(new GTFAttribs());
+        }
+        return *gtf;
+    }
+    
+    CufflinksAttribs& cufflinksAttribs() const {
+        if (!cufflinks) {
+            cufflinks.reset(new CufflinksAttribs());
+        }
+        return *cufflinks;
+    }
+    
+    /**
+     * As above, flagging key as present
+     */
+    CufflinksAttribs& cufflinksAttribs(AttribKey key) const {
+        CufflinksAttribs& a = cufflinksAttribs();
+        a.present |= CufflinksAttribs::bit(key);
+        return a;
+    }
+    
+    /**
+     * Forgets the root handles kept with this record unless they came from
+     * ids
+     */
+    void useRootPool(const StringPool& ids) const {
+        
+        if (rootPool != ids.GetSerial()) {
+            rootId = StringPool::NONE;
+            rootTranscriptId = StringPool::NONE;
+            rootPool = ids.GetSerial();
         }
+    }
+    
+    static StrRef rootIdOf(const string& id) {
+        
+        const size_t end = std::min(id.find('|'), id.size());
+        size_t pos = id.find("cds");
         
-        if (!gap.empty()) {
-            elems.push_back(string("Gap=") + gap);
+        if (pos != string::npos && pos + 3 > end) {
+            pos = string::npos;
         }
         
-        if (!derivesFrom.empty()) {
-            elems.push_back(string("Derives_from=") + derivesFrom);
+        if (pos != string::npos && pos + 4 > end) {
+            BOOST_THROW_EXCEPTION(GFFException() << GFFErrorInfo(string(
+                "Invalid ID, nothing follows \"cds\": ") + id));
         }
         
-        if (!index.empty()) {
-            elems.push_back(string("Index=") + index);
+        const char* b = id.data();
+        return StrRef(pos != string::npos ? b + pos + 4 : b, b + end);
+    }
+    
+    static StrRef rootTranscriptIdOf(const string& transcriptId) {
+        
+        const char* b = transcriptId.data();
+        const char* e = b + transcriptId.size();
+        
+        const size_t sep = transcriptId.find('|');
+        const size_t next = transcriptId.find_first_not_of('|', sep);
+        
+        return sep == string::npos ? StrRef(b, e) :
+               next == string::npos || transcriptId.find('|', next) != string::npos ? StrRef(e, e) :
+                   StrRef(b + next, e);
+    }
+    
+    static const GFFList& emptyList() {
+        static const GFFList empty;
+        return empty;
+    }
+    
+    static const GFFIdMap& emptyMap() {
+        static const GFFIdMap empty;
+        return empty;
+    }
+    
+public:
+    
+    void writeGFF3Attribs(ostream& out) {
+        
+        TextWriter writer(out, 4096);
+        writeGFF3Attribs(writer);
+    }
+    
+    void writeGFF3Attribs(TextWriter& out) {
+        
+        decodeAll();
+        
+        out.put("ID=", 3);
+        out.put(GetId());
+        
+        const string parents = GetParentId();
+        
+        if (!parents.empty()) {
+            out.put(";Parent=", 8);
+            out.put(parents);
+        }
+        
+        if (gff3) {
+            
+            const GFF3Attribs& a = *gff3;
+            
+            writeAttrib(out, ";Name=", a.name);
+            writeAttrib(out, ";Note=", a.note);
+            writeAttrib(out, ";Alias=", a.alias);
+            writeAttrib(out, ";Target=", a.target);
+            writeAttrib(out, ";Gap=", a.gap);
+            writeAttrib(out, ";Derives_from=", a.derivesFrom);
+            writeAttrib(out, ";Index=", a.index);
         }
-
-        out << boost::algorithm::join(elems, ";");        
     }
     
     void writeGTFAttribs(ostream& out) {
         
-        vector<string> elems;
+        TextWriter writer(out, 4096);
+        writeGTFAttribs(writer);
+    }
+    
+    void writeGTFAttribs(TextWriter& out) {
+        
+        decodeAll();
         
-        elems.push_back(string("gene_id \"") + geneId + "\"");
-        elems.push_back(string("transcript_id \"") + transcriptId + "\"");
+        out.put("gene_id \"", 9);
         
-        if (exonNumber >= 0) {
-            elems.push_back(string("exon_number \"") + boost::lexical_cast<string>(exonNumber) + "\"");
+        if (gtf) {
+            out.put(gtf->geneId);
         }
         
-        if (fpkm >= 0) {
-            elems.push_back(string("FPKM \"") + boost::lexical_cast<string>(fpkm) + "\"");
+        out.put("\";transcript_id \"", 17);
+        
+        if (gtf) {
+            out.put(gtf->transcriptId);
         }
         
-        if (frac >= 0.0) {
-            elems.push_back(string("frac \"") + boost::lexical_cast<string>(frac) + "\"");
+        out.put('"');
+        
+        // Only the Cufflinks attributes the record has
+        if (!cufflinks) {
+            return;
         }
         
-        if (confLo >= 0.0) {
-            elems.push_back(string("conf_lo \"") + boost::lexical_cast<string>(confLo) + "\"");
+        const CufflinksAttribs& c = *cufflinks;
+        
+        if (c.has(ATTR_EXON_NUMBER)) {
+            out.put(";exon_number \"", 14);
+            out.putInt(c.exonNumber);
+            out.put('"');
         }
         
-        if (confHigh >= 0.0) {
-            elems.push_back(string("conf_hi \"") + boost::lexical_cast<string>(confHigh) + "\"");
+        writeAttrib(out, ";FPKM \"", c.fpkm, c.has(ATTR_FPKM));
+        writeAttrib(out, ";frac \"", c.frac, c.has(ATTR_FRAC));
+        writeAttrib(out, ";conf_lo \"", c.confLo, c.has(ATTR_CONF_LO));
+        writeAttrib(out, ";conf_hi \"", c.confHigh, c.has(ATTR_CONF_HI));
+        writeAttrib(out, ";cov \"", c.coverage, c.has(ATTR_COVERAGE));
+    }
+    
+private:
+    
+    static void writeAttrib(TextWriter& out, const char* prefix, const string& value) {
+        
+        if (!value.empty()) {
+            out.put(prefix);
+            out.put(value);
         }
+    }
+    
+    static void writeAttrib(TextWriter& out, const char* prefix, double value, bool present) {
         
-        if (coverage >= 0.0) {
-            elems.push_back(string("cov \"") + boost::lexical_cast<string>(coverage) + "\"");
+        if (present) {
+            out.put(prefix);
+            out.putDouble(value);
+            out.put('"');
         }
-
-        out << boost::algorithm::join(elems, ";");
     }
+    
+public:
 
     // Sort by: seqid / start / end / type
     struct GFFOrdering {
         inline bool operator ()(const GFFPtr& a, const GFFPtr& b) {
 
-            int seqId = a->GetSeqId().compare(b->GetSeqId());
-            if (seqId != 0) {
-                return seqId < 0;
+            // Equal handles mean equal strings, otherwise fall back to comparing
+            // the pooled strings themselves so we keep lexicographic order
+            if (a->seqId != b->seqId) {
+                return a->GetSeqId().compare(b->GetSeqId()) < 0;
             }
             else {
                 int32_t sDiff = a->GetStart() - b->GetStart();
@@ -752,416 +1847,1984 @@ public:
         }
     };
     
-    void write(ostream& out) {
-        write(out, false);
-    }
-    
-    void write(ostream& out, bool writeChildren) {
-        write(out, this->source, writeChildren);
-    }
-
-    void write(ostream& out, string newSource, bool writeChildren) {
-        
-        out << seqId << "\t" 
-            << newSource << "\t"
-            << gffTypeToString(type) << "\t"
-            << start << "\t"
-            << end << "\t"
-            << (score == -1.0 ? "." : lexical_cast<string>(score)) << "\t"
-            << strand << "\t"
-            << (phase == -1 ? "." : lexical_cast<string>(phase)) << "\t";
-            
-        if (fileFormat == GFF3) {
-            writeGFF3Attribs(out);
-        }
-        else if (fileFormat == GTF) {
-            writeGTFAttribs(out);
+    /**
+     * Sorts gffs into GFFOrdering order.  Each record's place is worked out
+     * once up front, as a pair of integers, so the sort itself doesn't
+     * compare strings or follow pointers.
+     */
+    static void sortList(GFFList& gffs) {
+        
+        if (gffs.size() < 2) {
+            return;
         }
         
-        out << endl;
-            
-        if (writeChildren) {
-
-            std::sort(this->childList->begin(), this->childList->end(), GFF::GFFOrdering());
-
-            BOOST_FOREACH(GFFPtr child, *(this->childList)) {
-                child->write(out, newSource, true);
+        // Rank the sequence ids by name.  A child list nearly always has
+        // just the one.
+        vector<uint32_t> seqIds;
+        BOOST_FOREACH(GFFPtr gff, gffs) {
+            if (seqIds.empty() || gff->seqId != seqIds.back()) {
+                seqIds.push_back(gff->seqId);
             }
         }
-    }
-    
-    
-    static GFFPtr parse(FileFormat fileFormat, const string& line) {
-        vector<string> parts;
-        boost::split( parts, line, boost::is_any_of("\t"), boost::token_compress_on );
-
-        if (parts.size() != 9) {
-            BOOST_THROW_EXCEPTION(GFFException() << GFFErrorInfo(string(
-                "Could not parse GFF line due to incorrect number of columns. Expected 9 columns: ") + line));
-        }
         
-        GFFPtr gff = make_shared<GFF>(fileFormat);
+        std::sort(seqIds.begin(), seqIds.end());
+        seqIds.erase(std::unique(seqIds.begin(), seqIds.end()), seqIds.end());
         
-        gff->SetSeqId(parts[0]);
-        gff->SetSource(parts[1]);
-        gff->SetType(gffTypeFromString(parts[2]));
-        gff->SetStart(lexical_cast<int32_t>(parts[3]));
-        gff->SetEnd(lexical_cast<int32_t>(parts[4]));
-        gff->SetScore(parts[5][0] == '.' ? -1.0 : lexical_cast<double>(parts[5]));
-        gff->SetStrand(parts[6][0]);
-        gff->SetPhase(parts[7][0] == '.' ? -1 : lexical_cast<int8_t>(parts[7]));
+        vector<uint32_t> ranks(seqIds.size(), 0);
+        
+        if (seqIds.size() > 1) {
+            
+            vector<uint32_t> byName(seqIds);
+            std::sort(byName.begin(), byName.end(), SeqIdOrdering());
+            
+            for(uint32_t i = 0; i < byName.size(); i++) {
+                ranks[std::lower_bound(seqIds.begin(), seqIds.end(), byName[i]) - seqIds.begin()] = i;
+            }
+        }
         
-        vector<string> attrParts;
-        boost::split( attrParts, parts[8], boost::is_any_of(";"), boost::token_compress_on );
+        vector<SortKey> keys(gffs.size());
+        uint32_t lastSeqId = StringPool::NONE;
+        uint64_t rank = 0;
         
-        BOOST_FOREACH(string attr, attrParts) {
+        for(size_t i = 0; i < gffs.size(); i++) {
             
-            boost::trim(attr);
+            const GFFPtr gff = gffs[i];
             
-            if (!attr.empty()) {
-                vector<string> attrElements;
-                
-                if (fileFormat == GFF3) {
-                    boost::split( attrElements, attr, boost::is_any_of("="), boost::token_compress_on );
-
-                    string key = attrElements[0];
-                    string val = attrElements[1];
-                    if (boost::iequals(key, "ID")) {
-                        gff->SetId(val);
-                    }
-                    else if (boost::iequals(key, "Name")) {
-                        gff->SetName(val);
-                    }
-                    else if (boost::iequals(key, "Parent")) {
-                        gff->SetParentId(val);
-                    }
-                    else if (boost::iequals(key, "Alias")) {
-                        gff->SetAlias(val);
-                    }
-                    else if (boost::iequals(key, "Note")) {
-                        gff->SetNote(val);
-                    }
-                    else if (boost::iequals(key, "Target")) {
-                        gff->SetTarget(val);
-                    }
-                    else if (boost::iequals(key, "Gap")) {
-                        gff->SetGap(val);
-                    }
-                    else if (boost::iequals(key, "Derives_from")) {
-                        gff->SetDerivesFrom(val);
-                    }
-                    else if (boost::iequals(key, "Index")) {
-                        gff->SetIndex(val);
-                    }
-                }
-                else if(fileFormat == GTF || fileFormat == GFF2) {
-                    boost::split( attrElements, attr, boost::is_any_of(" "), boost::token_compress_on );
-
-                    string key = attrElements[0];
-                    string val = attrElements[1].substr(1, attrElements[1].size()-2);
-                    
-                    if (boost::iequals(key, "gene_id")) {
-                        gff->SetGeneId(val);
-                    }
-                    else if (boost::iequals(key, "transcript_id")) {
-                        gff->SetTranscriptId(val);
-                    }
-                    else if (boost::iequals(key, "exon_number")) {
-                        gff->SetExonNumber(lexical_cast<uint16_t>(val));
-                    }
-                    else if (boost::iequals(key, "FPKM")) {
-                        gff->SetFpkm(lexical_cast<double>(val));
-                    }
-                    else if (boost::iequals(key, "frac")) {
-                        gff->SetFrac(lexical_cast<double>(val));
-                    }
-                    else if (boost::iequals(key, "conf_lo")) {
-                        gff->SetConfLo(lexical_cast<double>(val));
-                    }
-                    else if (boost::iequals(key, "conf_hi")) {
-                        gff->SetConfHigh(lexical_cast<double>(val));
-                    }
-                    else if (boost::iequals(key, "coverage")) {
-                        gff->SetCoverage(lexical_cast<double>(val));
-                    }                 
-                }
-                else {
-                    BOOST_THROW_EXCEPTION(GFFException() << GFFErrorInfo(string(
-                        "Could not recognise GFF style file format.")));
-                }        
-            }            
+            if (gff->seqId != lastSeqId) {
+                lastSeqId = gff->seqId;
+                rank = ranks[std::lower_bound(seqIds.begin(), seqIds.end(), lastSeqId) - seqIds.begin()];
+            }
+            
+            // Flipping the sign bit orders signed coordinates as unsigned,
+            // and inverting end puts the longest record first
+            const uint32_t start = static_cast<uint32_t>(gff->start) ^ 0x80000000u;
+            const uint32_t end = ~(static_cast<uint32_t>(gff->end) ^ 0x80000000u);
+            
+            keys[i].hi = (rank << 32) | start;
+            keys[i].lo = (static_cast<uint64_t>(end) << 32) | static_cast<uint32_t>(gff->type);
+            keys[i].gff = gff;
         }
         
-        return gff;
+        std::sort(keys.begin(), keys.end());
+        
+        for(size_t i = 0; i < gffs.size(); i++) {
+            gffs[i] = keys[i].gff;
+        }
     }
     
-    
-    static void load(FileFormat fileFormat, const string& path, GFFList& gffs) {
-    
-        load(fileFormat, path, gffs, ANY);
+    /**
+     * Sorts the children of this record, and theirs in turn
+     */
+    void sortDescendants() {
+        
+        if (childList) {
+            
+            sortList(*childList);
+            
+            BOOST_FOREACH(GFFPtr child, *childList) {
+                child->sortDescendants();
+            }
+        }
     }
     
-    static void load(FileFormat fileFormat, const string& path, GFFList& gffs, GffType filter) {
+private:
     
-        auto_cpu_timer timer(1, " = Wall time taken: %ws\n");
-        cout << " - Loading GFF: " << path << endl;
+    struct SortKey {
+        uint64_t hi;
+        uint64_t lo;
+        GFFPtr gff;
         
-        if (filter != ANY) {
-            cout << " - Keeping only : " << gffTypeToString(filter) << endl;
+        bool operator<(const SortKey& other) const {
+            return hi != other.hi ? hi < other.hi : lo < other.lo;
         }
-        
-        
-        uint32_t totalCount = 0;
-        ifstream file(path.c_str());
-        string line; 
-        while (std::getline(file, line)) {            
-            boost::trim(line);
-            if (!line.empty()) {
-                
-                GFFPtr gff = parse(fileFormat, line);
-                totalCount++;
-                
-                if (filter == ANY || gff->GetType() == filter) {
-                    gffs.push_back(gff);
-                }
-            }
+    };
+    
+    struct SeqIdOrdering {
+        bool operator()(uint32_t a, uint32_t b) const {
+            return StringPool::global().resolve(a) < StringPool::global().resolve(b);
         }
-        file.close();
+    };
+    
+public:
+    
+    void write(ostream& out) {
+        write(out, false);
+    }
+    
+    void write(ostream& out, bool writeChildren) {
+        write(out, this->GetSource(), writeChildren);
+    }
+
+    void write(ostream& out, const string& newSource, bool writeChildren) {
         
-        cout << " - Loaded " << gffs.size() << " out of " << totalCount << " GFF records." << endl;
+        TextWriter writer(out, writeChildren ? TextWriter::DEFAULT_CAPACITY : 4096);
+        write(writer, newSource, writeChildren);
     }
     
-    static void save(const string& path, GFFList& gffs) {
-        save(path, gffs, string(""));
+    void write(TextWriter& out) {
+        write(out, this->GetSource(), false);
+    }
+
+    /**
+     * Writes this record, and optionally all its descendants.  A shared
+     * feature is written once, under the first of its parents we come to,
+     * with its Parent attribute listing all of them as in the input.
+     * Records that haven't been modified since they were read are written
+     * exactly as they were read, bar the source.
+     */
+    void write(TextWriter& out, const string& newSource, bool writeChildren) {
+        write(out, newSource, writeChildren, true);
     }
     
-    static void save(const string& path, GFFList& gffs, string source) {
+    /**
+     * As above, leaving the children in the order they're in when
+     * sortChildren is false, i.e. once sortDescendants has been called
+     */
+    void write(TextWriter& out, const string& newSource, bool writeChildren, bool sortChildren) {
         
-        auto_cpu_timer timer(1, " = Wall time taken: %ws\n\n");
-        cout << " - Saving to: " << path << endl;
-        
-        ofstream file(path.c_str());
-        BOOST_FOREACH(GFFPtr gff, gffs) {
-            
-            if (source.empty()) {
-                gff->write(file);
-            }
+        SharedSet written;
+        write(out, newSource, writeChildren, sortChildren, written);
+    }
+    
+    /**
+     * As above, skipping shared features already in written and adding those
+     * written here, so that a feature shared between records written one
+     * after the other is only written once
+     */
+    void write(TextWriter& out, const string& newSource, bool writeChildren, bool sortChildren, SharedSet& written) {
+
+        if (line) {
+            writeLine(out, newSource);
+        }
+        else {
+            writeFields(out, newSource);
+        }
+
+        if (writeChildren) {
+
+            if (this->childList) {
+
+                if (sortChildren) {
+                    std::sort(this->childList->begin(), this->childList->end(), GFF::GFFOrdering());
+                }
+
+                BOOST_FOREACH(GFFPtr child, *(this->childList)) {
+
+                    if (child->shared && !written.insert(child).second) {
+                        continue;
+                    }
+
+                    child->write(out, newSource, true, sortChildren, written);
+                }
+            }
+        }
+    }
+
+private:
+    
+    /**
+     * Copies the line this record was read from, with only the source
+     * swapped for newSource, so attributes we don't model are kept and
+     * nothing needs formatting
+     */
+    void writeLine(TextWriter& out, const string& newSource) const {
+
+        // The line parsed, so has all 9 columns
+        const char* lineEnd = line + lineSize;
+        const char* sourceBegin = static_cast<const char*>(memchr(line, '\t', lineSize)) + 1;
+        const char* sourceEnd = static_cast<const char*>(memchr(sourceBegin, '\t', lineEnd - sourceBegin));
+
+        if (newSource.size() == static_cast<size_t>(sourceEnd - sourceBegin) &&
+                memcmp(newSource.data(), sourceBegin, newSource.size()) == 0) {
+            out.put(line, lineSize);
+        }
+        else {
+            out.put(line, sourceBegin - line);
+            out.put(newSource);
+            out.put(sourceEnd, lineEnd - sourceEnd);
+        }
+
+        out.put('\n');
+    }
+
+    void writeFields(TextWriter& out, const string& newSource) {
+
+        out.put(GetSeqId());
+        out.put('\t');
+        out.put(newSource);
+        out.put('\t');
+        out.put(gffTypeToString(type));
+        out.put('\t');
+        out.putInt(start);
+        out.put('\t');
+        out.putInt(end);
+        out.put('\t');
+        
+        if (score == -1.0) {
+            out.put('.');
+        }
+        else {
+            out.putDouble(score);
+        }
+        
+        out.put('\t');
+        out.put(strand);
+        out.put('\t');
+        
+        // Phase holds the character as read, not the number
+        out.put(phase == -1 ? '.' : static_cast<char>(phase));
+        out.put('\t');
+            
+        if (fileFormat == GFF3) {
+            writeGFF3Attribs(out);
+        }
+        else if (fileFormat == GTF) {
+            writeGTFAttribs(out);
+        }
+        
+        out.put('\n');
+    }
+    
+public:
+    
+    
+    static GFFPtr parse(FileFormat fileFormat, const string& line, GFFArena& arena) {
+        return parse(fileFormat, line.data(), line.data() + line.size(), arena, NULL);
+    }
+    
+    static GFFPtr parse(FileFormat fileFormat, const char* begin, const char* end, GFFArena& arena) {
+        return parse(fileFormat, begin, end, arena, NULL);
+    }
+    
+    /**
+     * Parses a single GFF line held in [begin, end) into a new record owned by
+     * arena.  The line is tokenized in place, so only the fields that the GFF
+     * record keeps are ever copied.  Malformed lines throw a GFFException,
+     * unless a log is given, in which case they are counted there and NULL is
+     * returned.
+     */
+    static GFFPtr parse(FileFormat fileFormat, const char* begin, const char* end, GFFArena& arena, ParseLog* log) {
+        
+        static const DelimSet TAB("\t");
+        
+        StrRef parts[9];
+        const size_t nbParts = gts::io::split(StrRef(begin, end), TAB, parts, 9, true);
+
+        if (nbParts != 9) {
+            return reject(log, "Incorrect number of columns. Expected 9 columns", begin, end);
+        }
+        
+        // Check everything that can fail before anything is allocated, so a
+        // rejected line leaves nothing behind in the arena
+        int32_t start, stop;
+        if (!gts::io::tryToInt(parts[3], start) || !gts::io::tryToInt(parts[4], stop)) {
+            return reject(log, "Invalid start or end coordinate", begin, end);
+        }
+        
+        // Score, strand and phase are only ever looked at by their first
+        // character, so an empty column has to be caught before that happens
+        double score = -1.0;
+        if (parts[5].empty() || (parts[5][0] != '.' && !gts::io::tryToDouble(parts[5], score))) {
+            return reject(log, "Invalid score", begin, end);
+        }
+        
+        if (parts[6].empty()) {
+            return reject(log, "Invalid strand", begin, end);
+        }
+        
+        // Phase has always been read as a character, so only a single
+        // character is accepted
+        if (parts[7].empty() || (parts[7][0] != '.' && parts[7].size() != 1)) {
+            return reject(log, "Invalid phase", begin, end);
+        }
+        
+        // Attributes are decoded later, when nothing can be rejected, so the
+        // numeric ones are checked now
+        if (fileFormat != GFF3 && !validNumericAttribs(parts[8])) {
+            return reject(log, "Invalid numeric attribute", begin, end);
+        }
+        
+        GFFPtr gff = arena.create(fileFormat);
+        
+        gff->seqId = StringPool::global().intern(parts[0].b, parts[0].e);
+        gff->source = StringPool::global().intern(parts[1].b, parts[1].e);
+        gff->SetType(gffTypeFromString(parts[2]));
+        gff->SetStart(start);
+        gff->SetEnd(stop);
+        gff->SetScore(score);
+        gff->SetStrand(parts[6][0]);
+        gff->SetPhase(parts[7][0] == '.' ? -1 : parts[7][0]);
+        
+        // Attributes are only decoded when they're asked for
+        const StrRef& attrs = parts[8];
+        attrs.assignTo(gff->attribs);
+        
+        return gff;
+    }
+    
+    static void load(FileFormat fileFormat, const string& path, GFFList& gffs, GFFArena& arena) {
+    
+        load(fileFormat, path, gffs, arena, ANY);
+    }
+    
+    static void load(FileFormat fileFormat, const string& path, GFFList& gffs, GFFArena& arena, const GFFFilter& filter) {
+    
+        load(fileFormat, path, gffs, arena, filter, 1);
+    }
+    
+    static void load(FileFormat fileFormat, const string& path, GFFList& gffs, GFFArena& arena, const GFFFilter& filter, uint16_t threads) {
+    
+        load(fileFormat, path, gffs, arena, filter, threads, NULL);
+    }
+    
+    /**
+     * Loads all GFF records from the file at path into arena.  When more than
+     * one thread is requested the file is cut into byte ranges which are
+     * snapped to line boundaries and parsed concurrently, each into its own
+     * arena.  The per range results are then concatenated so that gffs is
+     * always in file order.  Lines rejected by filter are skipped before
+     * they're parsed.  If a log is given malformed lines are counted there and
+     * skipped, otherwise the first one aborts the load.
+     */
+    static void load(FileFormat fileFormat, const string& path, GFFList& gffs, GFFArena& arena, const GFFFilter& filter, uint16_t threads, 
+            ParseLog* log) {
+    
+        auto_cpu_timer timer(1, " = Wall time taken: %ws\n");
+        cout << " - Loading GFF: " << path << endl;
+        
+        if (!filter.keepsEverything()) {
+            cout << " - Keeping only : " << filter.toString() << endl;
+        }
+        
+        // Records point at their lines in the buffer, so it lives as long as
+        // they do
+        FileBufferPtr file = boost::make_shared<FileBuffer>(path, threads);
+        arena.keep(file);
+        
+        vector<const char*> bounds;
+        splitIntoLineRanges(file->begin(), file->end(), threads, bounds);
+        
+        const size_t nbChunks = bounds.size() - 1;
+        
+        uint32_t totalCount = 0;
+        
+        if (nbChunks == 1) {
+            totalCount = loadRange(fileFormat, bounds[0], bounds[1], filter, gffs, arena, log);
+        }
+        else {
+            
+            cout << " - Parsing " << nbChunks << " chunks using " << nbChunks << " threads" << endl;
+            
+            vector<GFFList> chunks(nbChunks);
+            vector<GFFArenaPtr> arenas(nbChunks);
+            vector<uint32_t> counts(nbChunks, 0);
+            vector<boost::exception_ptr> errors(nbChunks);
+            vector<ParseLog> logs(nbChunks, ParseLog(log ? log->getMaxExamples() : 0));
+            
+            boost::thread_group workers;
+            for(size_t i = 0; i < nbChunks; i++) {
+                arenas[i] = make_shared<GFFArena>();
+                workers.create_thread(boost::bind(&GFF::loadRangeWorker, 
+                        fileFormat, StrRef(bounds[i], bounds[i+1]), boost::cref(filter), 
+                        boost::ref(chunks[i]), boost::ref(*arenas[i]), 
+                        log ? &logs[i] : NULL,
+                        boost::ref(counts[i]), boost::ref(errors[i])));
+            }
+            workers.join_all();
+            
+            if (log) {
+                for(size_t i = 0; i < nbChunks; i++) {
+                    log->merge(logs[i]);
+                }
+            }
+            
+            for(size_t i = 0; i < nbChunks; i++) {
+                arena.adopt(*arenas[i]);
+            }
+            
+            for(size_t i = 0; i < nbChunks; i++) {
+                if (errors[i]) {
+                    boost::rethrow_exception(errors[i]);
+                }
+            }
+            
+            size_t total = gffs.size();
+            for(size_t i = 0; i < nbChunks; i++) {
+                total += chunks[i].size();
+                totalCount += counts[i];
+            }
+            
+            gffs.reserve(total);
+            for(size_t i = 0; i < nbChunks; i++) {
+                gffs.insert(gffs.end(), chunks[i].begin(), chunks[i].end());
+                GFFList().swap(chunks[i]);
+            }
+        }
+        
+        cout << " - Loaded " << gffs.size() << " out of " << totalCount << " GFF records." << endl;
+    }
+    
+    /**
+     * Cuts [begin, end) into at most nbRanges ranges of roughly equal size, each
+     * of which starts at the beginning of a line.  bounds receives the range
+     * boundaries, so range i is [bounds[i], bounds[i+1]).
+     */
+    static void splitIntoLineRanges(const char* begin, const char* end, uint16_t nbRanges, vector<const char*>& bounds) {
+        
+        const size_t size = end - begin;
+        
+        bounds.clear();
+        bounds.push_back(begin);
+        
+        for(uint16_t i = 1; i < nbRanges; i++) {
+            
+            const char* pos = begin + (size / nbRanges) * i;
+            
+            if (pos <= bounds.back()) {
+                continue;
+            }
+            
+            // Move forward to the start of the next line
+            const char* lineStart = gts::io::findLineEnd(pos - 1, end);
+            lineStart = lineStart == end ? end : lineStart + 1;
+            
+            if (lineStart > bounds.back() && lineStart < end) {
+                bounds.push_back(lineStart);
+            }
+        }
+        
+        bounds.push_back(end);
+    }
+    
+    /**
+     * Parses every line in [begin, end), which must start at the beginning of
+     * a line.  Returns the number of records found, including those rejected
+     * by the filter and, when there's a log, those that were malformed.
+     */
+    static uint32_t loadRange(FileFormat fileFormat, const char* begin, const char* end, const GFFFilter& filter, 
+            GFFList& gffs, GFFArena& arena, ParseLog* log) {
+        
+        uint32_t count = 0;
+        const char* p = begin;
+        
+        while (p < end) {
+            
+            const char* lineEnd = gts::io::findLineEnd(p, end);
+            StrRef line = gts::io::trim(StrRef(p, lineEnd));
+            
+            if (!line.empty()) {
+                
+                count++;
+                
+                if (filter.matches(line)) {
+                    
+                    GFFPtr gff = parse(fileFormat, line.b, line.e, arena, log);
+                    
+                    if (gff != NULL) {
+                        gff->SetLine(line.b, line.e);
+                        gffs.push_back(gff);
+                    }
+                }
+            }
+            
+            p = lineEnd + 1;
+        }
+        
+        return count;
+    }
+    
+    static void loadRangeWorker(FileFormat fileFormat, const StrRef& range, const GFFFilter& filter, 
+            GFFList& gffs, GFFArena& arena, ParseLog* log, uint32_t& count, boost::exception_ptr& error) {
+        
+        try {
+            count = loadRange(fileFormat, range.b, range.e, filter, gffs, arena, log);
+        }
+        catch(...) {
+            error = boost::current_exception();
+        }
+    }
+    
+    /**
+     * Serialises this record, and all its descendants, for the binary cache.
+     * Parent links aren't stored, they are rebuilt by readBinary.  A shared
+     * feature is stored in full the first time it's met, and as a reference
+     * to that every time after.
+     */
+    void writeBinary(BinaryWriter& out) const {
+        
+        SharedIndex written;
+        writeBinary(out, written, NULL);
+    }
+    
+    /**
+     * As above, with written holding the position of each shared feature
+     * stored so far, so that features shared between records written one
+     * after the other are also only stored once.  IDs and parent IDs are
+     * stored as their index in ids, or in full if it's NULL.
+     */
+    void writeBinary(BinaryWriter& out, SharedIndex& written, const FrontCodedDictionary* ids) const {
+        
+        decodeAll();
+        
+        out.put<uint8_t>(fileFormat);
+        out.putString(GetSeqId());
+        out.putString(GetSource());
+        out.put<uint8_t>(type);
+        out.put<int32_t>(start);
+        out.put<int32_t>(end);
+        out.put<double>(score);
+        out.put<char>(strand);
+        out.put<int8_t>(phase);
+        
+        if (ids) {
+            out.putVarint(ids->find(GetId()));
+            out.putVarint(ids->find(GetParentId()));
+        }
+        else {
+            out.putString(GetId());
+            out.putString(GetParentId());
+        }
+        
+        // Flag which of the optional attribute groups follow
+        out.put<uint8_t>((gff3 ? 1 : 0) | (gtf ? 2 : 0) | (cufflinks ? 4 : 0) | (shared ? 8 : 0));
+        
+        if (gff3) {
+            out.putString(gff3->name);
+            out.putString(gff3->alias);
+            out.putString(gff3->note);
+            out.putString(gff3->target);
+            out.putString(gff3->gap);
+            out.put<uint8_t>(gff3->circular);
+            out.putString(gff3->derivesFrom);
+            out.putString(gff3->index);
+        }
+        
+        if (gtf) {
+            out.putString(gtf->geneId);
+            out.putString(gtf->transcriptId);
+        }
+        
+        if (cufflinks) {
+            out.put<uint8_t>(cufflinks->present);
+            out.put<uint16_t>(cufflinks->exonNumber);
+            out.put<double>(cufflinks->fpkm);
+            out.put<double>(cufflinks->frac);
+            out.put<double>(cufflinks->confLo);
+            out.put<double>(cufflinks->confHigh);
+            out.put<double>(cufflinks->coverage);
+        }
+        
+        // Empty for modified records
+        out.putVarint(line ? lineSize : 0);
+        out.putBytes(line, line ? lineSize : 0);
+        
+        out.putVarint(childList ? childList->size() : 0);
+        
+        if (childList) {
+            BOOST_FOREACH(GFFPtr child, *childList) {
+                
+                if (child->shared) {
+                    
+                    SharedIndex::const_iterator seen = written.find(child);
+                    
+                    if (seen != written.end()) {
+                        out.put<uint8_t>(SHARED_REF);
+                        out.putVarint(seen->second);
+                        continue;
+                    }
+                    
+                    const size_t index = written.size();
+                    written[child] = index;
+                }
+                
+                child->writeBinary(out, written, ids);
+            }
+        }
+    }
+    
+    /**
+     * Adds the ID and parent ID of this record, and all its descendants, to
+     * ids
+     */
+    void collectIds(vector<string>& ids) const {
+        
+        ids.push_back(GetId());
+        ids.push_back(GetParentId());
+        
+        if (childList) {
+            BOOST_FOREACH(GFFPtr child, *childList) {
+                child->collectIds(ids);
+            }
+        }
+    }
+    
+    /**
+     * Reads back a record written by writeBinary, relinking its descendants.
+     * Children at depth one (transcripts when reading a gene) are added to the
+     * child map, deeper ones are not, which mirrors GFFModel::linkRecord.
+     * Records point at their lines in the data read, which the arena must
+     * therefore keep.
+     */
+    static GFFPtr readBinary(BinaryReader& in, GFFArena& arena) {
+        
+        GFFList read;
+        return readBinary(in, arena, 0, read, NULL);
+    }
+    
+    /**
+     * As above, with read holding the shared features read so far, in the
+     * order they were stored, and ids the dictionary they were written with
+     */
+    static GFFPtr readBinary(BinaryReader& in, GFFArena& arena, uint16_t depth, GFFList& read, const FrontCodedDictionary* ids) {
+        
+        const uint8_t format = in.get<uint8_t>();
+        
+        if (format == SHARED_REF) {
+            
+            const size_t index = in.getVarint();
+            
+            if (index >= read.size()) {
+                BOOST_THROW_EXCEPTION(GFFException() << GFFErrorInfo(string(
+                    "Invalid binary GFF: Reference to unknown shared feature")));
+            }
+            return read[index];
+        }
+        
+        if (format > GTF) {
+            BOOST_THROW_EXCEPTION(GFFException() << GFFErrorInfo(string(
+                "Invalid binary GFF: Unknown file format")));
+        }
+        
+        GFFPtr gff = arena.create(static_cast<FileFormat>(format));
+        
+        const char* b;
+        const char* e;
+        in.getRange(b, e);
+        gff->seqId = StringPool::global().intern(b, e);
+        in.getRange(b, e);
+        gff->source = StringPool::global().intern(b, e);
+        const uint8_t type = in.get<uint8_t>();
+        
+        if (type > ANY) {
+            BOOST_THROW_EXCEPTION(GFFException() << GFFErrorInfo(string(
+                "Invalid binary GFF: Unknown record type")));
+        }
+        
+        gff->type = static_cast<GffType>(type);
+        gff->start = in.get<int32_t>();
+        gff->end = in.get<int32_t>();
+        gff->score = in.get<double>();
+        gff->strand = in.get<char>();
+        gff->phase = in.get<int8_t>();
+        
+        if (ids) {
+            readId(in, *ids, gff->id);
+            readId(in, *ids, gff->parentId);
+        }
+        else {
+            in.getString(gff->id);
+            in.getString(gff->parentId);
+        }
+        
+        const uint8_t groups = in.get<uint8_t>();
+        
+        if (groups & 1) {
+            GFF3Attribs& a = gff->gff3Attribs();
+            in.getString(a.name);
+            in.getString(a.alias);
+            in.getString(a.note);
+            in.getString(a.target);
+            in.getString(a.gap);
+            a.circular = in.get<uint8_t>() != 0;
+            in.getString(a.derivesFrom);
+            in.getString(a.index);
+        }
+        
+        if (groups & 2) {
+            GTFAttribs& a = gff->gtfAttribs();
+            in.getString(a.geneId);
+            in.getString(a.transcriptId);
+        }
+        
+        if (groups & 8) {
+            gff->shared = true;
+            
+            if (depth > 0) {
+                read.push_back(gff);
+            }
+        }
+        
+        if (groups & 4) {
+            CufflinksAttribs& a = gff->cufflinksAttribs();
+            a.present = in.get<uint8_t>();
+            a.exonNumber = in.get<uint16_t>();
+            a.fpkm = in.get<double>();
+            a.frac = in.get<double>();
+            a.confLo = in.get<double>();
+            a.confHigh = in.get<double>();
+            a.coverage = in.get<double>();
+        }
+        
+        in.getRange(b, e);
+        
+        if (b != e) {
+            gff->SetLine(b, e);
+        }
+        
+        const size_t nbChildren = in.getVarint();
+        
+        for(size_t i = 0; i < nbChildren; i++) {
+            gff->addChild(readBinary(in, arena, depth + 1, read, ids), depth > 0);
+        }
+        
+        return gff;
+    }
+    
+private:
+    
+    static void readId(BinaryReader& in, const FrontCodedDictionary& ids, string& id) {
+        
+        const uint64_t index = in.getVarint();
+        
+        if (index >= ids.GetSize()) {
+            BOOST_THROW_EXCEPTION(GFFException() << GFFErrorInfo(string(
+                "Invalid binary GFF: Reference to unknown ID")));
+        }
+        
+        ids.decode(index, id);
+    }
+    
+public:
+    
+    static void save(const string& path, GFFList& gffs) {
+        save(path, gffs, string(""));
+    }
+    
+    static void save(const string& path, GFFList& gffs, string source) {
+        
+        auto_cpu_timer timer(1, " = Wall time taken: %ws\n\n");
+        cout << " - Saving to: " << path << endl;
+        
+        ofstream file(path.c_str());
+        TextWriter writer(file);
+        
+        BOOST_FOREACH(GFFPtr gff, gffs) {
+            
+            if (source.empty()) {
+                gff->write(writer);
+            }
             else {
-                gff->write(file, source, false);
+                gff->write(writer, source, false);
+            }
+        }
+        
+        writer.flush();
+        file.close();
+    }    
+    
+};
+
+
+inline void* GFFArena::allocate() {
+    
+    if (blocks.empty() || blocks.back().used == BLOCK_SIZE) {
+        Block block;
+        block.records = static_cast<GFF*>(::operator new(BLOCK_SIZE * sizeof(GFF)));
+        block.used = 0;
+        blocks.push_back(block);
+    }
+    
+    Block& block = blocks.back();
+    return block.records + block.used;
+}
+
+inline GFF* GFFArena::create(FileFormat fileFormat) {
+    
+    GFF* gff = new (allocate()) GFF(fileFormat);
+    blocks.back().used++;
+    size++;
+    return gff;
+}
+
+inline GFF* GFFArena::copy(const GFF& other) {
+    
+    GFF* gff = new (allocate()) GFF(other);
+    blocks.back().used++;
+    size++;
+    
+    const StrRef line = other.GetLine();
+    if (!line.empty() && holds(line.b)) {
+        gff->SetLine(line.b, line.e);
+    }
+    
+    return gff;
+}
+
+inline void GFFArena::discardLast() {
+    
+    Block& block = blocks.back();
+    block.used--;
+    block.records[block.used].~GFF();
+    size--;
+}
+
+inline void GFFArena::clear() {
+    
+    BOOST_FOREACH(Block& block, blocks) {
+        for(size_t i = 0; i < block.used; i++) {
+            block.records[i].~GFF();
+        }
+        ::operator delete(block.records);
+    }
+    
+    blocks.clear();
+    buffers.clear();
+    size = 0;
+    
+    if (keys) {
+        keys->clear();
+    }
+}
+
+inline uint32_t GFFArena::keyOf(GFFPtr gff) {
+    
+    if (gff->GetKey() == StringPool::NONE) {
+        prepareKeys();
+        gff->SetKey(keys->intern(gff->GetId()));
+    }
+    
+    return gff->GetKey();
+}
+
+
+
+class GFFModel {
+
+public:
+    
+    // Default limit on the number of records held back waiting for a parent
+    static const size_t DEFAULT_MAX_ORPHANS = 1 << 24;
+    
+private:
+    
+    // A record that arrived before its parent, tagged with the order it was
+    // linked in, so that any left over can be reported in file order
+    typedef std::pair<uint32_t, GFFPtr> Orphan;
+    typedef boost::unordered_map<string, vector<Orphan> > OrphanMap;
+    
+    GFFArenaPtr arena;
+    GFFListPtr geneList;
+    
+    // Set once genes, and everything below them, are in GFFOrdering order,
+    // so saves needn't sort again.  Cleared whenever anything's linked or
+    // added.
+    bool sorted;
+    
+    // Genes and transcripts indexed by the key GFFArena::keyOf gave their
+    // id, NULL where there's no such gene or transcript in this model
+    GFFList genesByKey;
+    GFFList transcriptsByKey;
+    size_t nbTranscripts;
+    
+    // Transcripts waiting for their gene and features waiting for their
+    // transcript, by the id of the missing parent
+    OrphanMap orphanTranscripts;
+    OrphanMap orphanFeatures;
+    
+    // Shared features held back under more than one missing parent, with how
+    // many.  Each only counts once in nbOrphans.
+    boost::unordered_map<GFFPtr, uint32_t> sharedOrphans;
+    
+    uint32_t nbLinked;
+    size_t nbOrphans;
+    size_t peakOrphans;
+    size_t maxOrphans;
+
+public:
+
+    /**
+     * Creates an empty model which owns a new arena
+     */
+    GFFModel() : sorted(false), nbTranscripts(0), nbLinked(0), nbOrphans(0), peakOrphans(0), maxOrphans(DEFAULT_MAX_ORPHANS) {
+        arena = make_shared<GFFArena>();
+        geneList = make_shared<GFFList>();
+    }
+    
+    /**
+     * Creates an empty model sharing arena with another model.  Useful when
+     * this model will contain records copied from, or shared with, the other.
+     */
+    GFFModel(GFFArenaPtr arena) : arena(arena), sorted(false), nbTranscripts(0), nbLinked(0), nbOrphans(0), peakOrphans(0), maxOrphans(DEFAULT_MAX_ORPHANS) {
+        geneList = make_shared<GFFList>();
+    }
+    
+    virtual ~GFFModel() {}
+    
+    /**
+     * The arena that owns this model's records
+     */
+    GFFArenaPtr getArena() {
+        return arena;
+    }
+    
+    GFFPtr getGeneByIndex(uint32_t index) {
+        return (*geneList)[index];
+    }
+    
+    bool containsGene(string id) {
+        return getGeneById(id) != NULL;
+    }
+    
+    /**
+     * Whether this model has a gene with the same id as gene.  Cheaper than
+     * looking it up by id when gene belongs to a model over the same arena.
+     */
+    bool containsGene(GFFPtr gene) {
+        return lookup(genesByKey, arena->keyOf(gene)) != NULL;
+    }
+
+    GFFPtr getGeneById(string& id) {
+        return lookup(genesByKey, arena->findKey(id));
+    }
+    
+    bool containsTranscript(string id) {
+        return getTranscriptById(id) != NULL;
+    }
+    
+    /**
+     * Whether this model has a transcript with the same id as transcript,
+     * see containsGene
+     */
+    bool containsTranscript(GFFPtr transcript) {
+        return lookup(transcriptsByKey, arena->keyOf(transcript)) != NULL;
+    }
+    
+    GFFPtr getTranscriptById(string id) {
+        return lookup(transcriptsByKey, arena->findKey(id));
+    }
+    
+    size_t getTotalNbTranscripts() {
+        return nbTranscripts;
+    }
+    
+    size_t getNbTranscripts(string& id) {
+        return getGeneById(id)->GetNbChildren();
+    }
+    
+    size_t getNbGenes() {
+        return geneList->size();
+    }
+    
+    GFFListPtr getGeneList() {
+        return geneList;
+    }
+    
+    GFFListPtr getFullList() {
+        
+        GFFListPtr gffs = make_shared<GFFList>();
+        
+        BOOST_FOREACH(GFFPtr gene, *(this->geneList)) {
+            
+            gffs->push_back(gene);            
+            gene->GetAllChildren(*gffs);            
+        }
+        
+        return gffs;        
+    }
+    
+    GFFListPtr getAllOfType(GffType type) {
+        
+        GFFListPtr gffs = make_shared<GFFList>();
+        
+        GFFListPtr genes = this->geneList;
+        
+        if (genes) {
+            BOOST_FOREACH(GFFPtr gene, *genes) {
+                gffs->push_back(gene);            
+                gene->GetAllOfType(type, *gffs);            
             }
         }
-        file.close();
-    }    
+        
+        return gffs;        
+    }
+        
+    void addGene(GFFPtr gff) {
+        
+        if (gff->GetType() != GENE) {
+            BOOST_THROW_EXCEPTION(GFFException() << GFFErrorInfo(string(
+                "The GFF provided does not represent a gene: ") + gff->GetId()));
+        }
+        
+        const uint32_t key = arena->keyOf(gff);
+        
+        if (lookup(genesByKey, key)) {
+            BOOST_THROW_EXCEPTION(GFFException() << GFFErrorInfo(string(
+                "Invalid GFF: Already loaded gene with this Id: ") + gff->GetId()));
+        }
+        else {
+            store(genesByKey, key, gff);
+            this->geneList->push_back(gff);
+            sorted = false;
+            
+            BOOST_FOREACH(GFFPtr transcript, gff->GetChildList()) {
+                storeTranscript(transcript);
+            }
+        }
+    }
     
-};
+    void rebuildGeneMap() {
+       
+        this->genesByKey.clear();
+        
+        BOOST_FOREACH(GFFPtr gene, *(this->geneList)) {
+            store(genesByKey, arena->keyOf(gene), gene);
+        }
+    }
+    
+    /**
+     * The number of records currently held back waiting for their parent
+     */
+    size_t getNbOrphans() const {
+        return nbOrphans;
+    }
+    
+    /**
+     * The most records that were ever held back at once
+     */
+    size_t getPeakOrphans() const {
+        return peakOrphans;
+    }
+    
+    size_t getMaxOrphans() const {
+        return maxOrphans;
+    }
+    
+    /**
+     * Limits how many records may be held back waiting for their parent.
+     * Going over the limit throws, as the input is then too far from sorted
+     * to be linked in bounded memory.
+     */
+    void setMaxOrphans(size_t maxOrphans) {
+        this->maxOrphans = maxOrphans;
+    }
+    
+    /**
+     * Links a single record into this model.  Genes are added directly,
+     * transcripts are attached to their parent gene and everything else to its
+     * parent transcript.  Records may arrive in any order: a record whose
+     * parent hasn't been seen yet is held back, and attached as soon as the
+     * parent turns up.  Call finishLinking once every record has been linked.
+     * 
+     * A feature with more than one parent transcript is held once and
+     * attached to each of them.  Proteins aren't supported, so are counted in
+     * log and left out.  When lenient, duplicate genes are also
+     * counted in log and left out, rather than throwing a GFFException.
+     */
+    void linkRecord(GFFPtr gff, ParseLog& log, bool lenient) {
+        
+        const uint32_t seq = nbLinked++;
+        sorted = false;
+        
+        string parentId;
+        const char* ignoredAs = NULL;
+        
+        switch(classify(gff, parentId, ignoredAs)) {
+            
+            case LINK_GENE: {
+            
+                const string id = gff->GetId();
 
+                if (lenient && lookup(genesByKey, arena->keyOf(gff))) {
+                    log.add("Duplicate gene ID", id);
+                }
+                else {
+                    this->addGene(gff);
+
+                    // Transcripts which arrived before their gene
+                    vector<Orphan> transcripts;
+                    if (adoptOrphans(orphanTranscripts, id, transcripts)) {
+                        BOOST_FOREACH(const Orphan& t, transcripts) {
+                            attachTranscript(gff, t.second);
+                        }
+                    }
+                }
+                break;
+            }
+            case LINK_TRANSCRIPT: {
+                
+                GFFPtr gene = getGeneById(parentId);
 
+                if (gene) {
+                    attachTranscript(gene, gff);
+                }
+                else {
+                    holdOrphan(orphanTranscripts, parentId, seq, gff);
+                }
+                break;
+            }
+            case LINK_FEATURE: {
+                
+                GFFPtr transcript = getTranscriptById(parentId);
+                
+                if (transcript) {
+                    transcript->addChild(gff, true);                        
+                }
+                else {
+                    holdOrphan(orphanFeatures, parentId, seq, gff);
+                }
+                break;
+            }
+            case LINK_SHARED: {
+                
+                gff->SetShared(true);
+                
+                vector<string> parents;
+                boost::split(parents, parentId, boost::is_any_of(","), boost::token_compress_off);
+                
+                BOOST_FOREACH(const string& p, parents) {
+                    
+                    GFFPtr transcript = getTranscriptById(p);
 
+                    if (transcript) {
+                        transcript->addChild(gff, true);
+                    }
+                    else {
+                        holdOrphan(orphanFeatures, p, seq, gff);
+                    }
+                }
+                break;
+            }
+            case LINK_IGNORED:
+                log.add(ignoredAs, gff->GetId());
+                break;
+        }
+    }
+    
+    /**
+     * Links every record in gffs, in order, then calls finishLinking.  With
+     * more than one thread an empty model is linked in parallel phases, which
+     * builds exactly the model, and log, that linking serially would.
+     */
+    void linkAll(const GFFList& gffs, ParseLog& log, bool lenient, uint16_t threads) {
+        
+        sorted = false;
+        
+        if (threads <= 1 || !geneList->empty() || nbOrphans > 0 || !linkParallel(gffs, log, threads)) {
+            
+            BOOST_FOREACH(GFFPtr gff, gffs) {
+                linkRecord(gff, log, lenient);
+            }
+        }
+        
+        finishLinking(log, lenient);
+    }
+    
+    /**
+     * Deals with any records still waiting for a parent once the input is
+     * exhausted.  Throws a GFFException for the first of them, in file order,
+     * unless lenient, in which case they're all counted in log and left out.
+     */
+    void finishLinking(ParseLog& log, bool lenient) {
+        
+        if (nbOrphans == 0) {
+            return;
+        }
+        
+        // Tag each with what it was missing, then put them back in file order
+        vector<std::pair<Orphan, bool> > leftOver;
+        leftOver.reserve(nbOrphans);
+        
+        BOOST_FOREACH(const OrphanMap::value_type& e, orphanTranscripts) {
+            BOOST_FOREACH(const Orphan& o, e.second) {
+                leftOver.push_back(std::make_pair(o, true));
+            }
+        }
+        
+        BOOST_FOREACH(const OrphanMap::value_type& e, orphanFeatures) {
+            BOOST_FOREACH(const Orphan& o, e.second) {
+                leftOver.push_back(std::make_pair(o, false));
+            }
+        }
+        
+        // A shared feature is held under each parent it's missing, but is
+        // only reported once
+        std::sort(leftOver.begin(), leftOver.end());
+        leftOver.erase(std::unique(leftOver.begin(), leftOver.end()), leftOver.end());
+        
+        clearOrphans();
+        
+        for(size_t i = 0; i < leftOver.size(); i++) {
+            
+            const bool isTranscript = leftOver[i].second;
+            const string id = leftOver[i].first.second->GetId();
+            
+            if (!lenient) {
+                BOOST_THROW_EXCEPTION(GFFException() << GFFErrorInfo(isTranscript ?
+                    string("Invalid GFF: Could not find parent gene for mRNA: ") + id : 
+                    string("Invalid GFF: Could not find parent transcript for GFF entry: ") + id));
+            }
+            
+            log.add(isTranscript ? "Transcript without a parent gene" : "Feature without a parent transcript", id);
+        }
+    }
+    
+    /**
+     * Compacts every feature below a transcript, see GFF::compact, then
+     * moves what's left of their ids into the IdStore, see GFF::storeIds.
+     * Worth doing on exon dense annotations that are kept around for a while,
+     * e.g. gts --compact.  The IdStore is never freed, so only compact a
+     * model once its ids are final, and not models that are soon dropped.
+     * Compacting the same model again only stores ids added since.
+     */
+    void compact() {
+        
+        GFFList features;
+        
+        BOOST_FOREACH(GFFPtr gene, *geneList) {
+            BOOST_FOREACH(GFFPtr transcript, gene->GetChildList()) {
+                BOOST_FOREACH(GFFPtr feature, transcript->GetChildList()) {
+                    feature->compact();
+                    features.push_back(feature);
+                }
+            }
+        }
+        
+        GFF::storeIds(features);
+    }
+    
+    /**
+     * Forgets all genes held by this model.  The records themselves live on
+     * until the arena is cleared, as other models may share it.
+     */
+    void clear() {
+        
+        geneList->clear();
+        genesByKey.clear();
+        transcriptsByKey.clear();
+        nbTranscripts = 0;
+        clearOrphans();
+    }
+    
+private:
+    
+    enum LinkKind {
+        LINK_GENE,
+        LINK_TRANSCRIPT,
+        LINK_FEATURE,
+        LINK_SHARED,
+        LINK_IGNORED
+    };
+    
+    /**
+     * Works out where gff belongs in the model.  Transcripts and features get
+     * the id of the parent they should be attached to in parentId, shared
+     * features the ids of all their parents, comma separated.  Ignored records
+     * get the reason they're ignored in ignoredAs.
+     */
+    static LinkKind classify(GFFPtr gff, string& parentId, const char*& ignoredAs) {
+        
+        const GffType type = gff->GetType();
+        
+        if (type == GENE) {
+            return LINK_GENE;
+        }
+        else if (type == MRNA || type == MIRNA) {
+            parentId = gff->GetParentId();
+            return LINK_TRANSCRIPT;
+        }
+        else if (type == PROTEIN) {
+            
+            /*string derivesFrom = gff->GetDerivesFrom();
+            
+            // We assume the gene is already present... should be in most GFFs
+            if (this->transcriptMap.count(derivesFrom) > 0) {                    
+                this->transcriptMap[derivesFrom]->addChild(gff, true);
+            }
+            else {
+                BOOST_THROW_EXCEPTION(GFFException() << GFFErrorInfo(string(
+                    "Invalid GFF: Could not find parent gene for mRNA: ") + id));
+            }*/
+            
+            ignoredAs = "Ignored protein";
+            return LINK_IGNORED;
+        }
+        
+        string parent = gff->GetParentId();
 
+        vector<string> parents;
+        boost::split( parents, parent, boost::is_any_of(","), boost::token_compress_off );
 
-class GFFModel {
+        vector<string> filteredParents;
 
-private:
-    GFFListPtr geneList;
-    GFFIdMap geneMap;
-    GFFIdMap transcriptMap;
+        BOOST_FOREACH(string p, parents) {
 
-public:
+            if (p.find("-Protein") == std::string::npos && 
+                    std::find(filteredParents.begin(), filteredParents.end(), p) == filteredParents.end()) {
+                filteredParents.push_back(p);
+            }
+        }
 
-    GFFModel() {
-        geneList = make_shared<GFFList>();
+        if (filteredParents.size() > 1) {
+            parentId = boost::join(filteredParents, ",");
+            return LINK_SHARED;
+        }
+        else if (filteredParents.empty()) {
+            ignoredAs = "Ignored feature of a protein";
+            return LINK_IGNORED;
+        }
+        
+        parentId.swap(filteredParents[0]);
+        return LINK_FEATURE;
+    }
+    
+    /**
+     * Adds transcript to gene, along with any of its features that arrived
+     * before it
+     */
+    void attachTranscript(GFFPtr gene, GFFPtr transcript) {
+        
+        const string id = transcript->GetId();
+        
+        gene->addChild(transcript);
+        storeTranscript(transcript);
+        
+        vector<Orphan> features;
+        if (adoptOrphans(orphanFeatures, id, features)) {
+            BOOST_FOREACH(const Orphan& f, features) {
+                transcript->addChild(f.second, true);
+            }
+        }
+    }
+    
+    // What linkParallel works out about each record before anything is linked
+    struct LinkPlan {
+        
+        enum { NONE = 0xFFFFFFFF };
+        
+        vector<uint8_t> kinds;
+        vector<string> ids;
+        vector<string> parentIds;
+        vector<const char*> ignoredAs;
+        
+        // Index of each record's parent, if it's been found
+        vector<uint32_t> parents;
+        
+        // Index of the record after which serial linking would have attached
+        // each record to its parent, or NONE if it never would
+        vector<uint32_t> attachAt;
+        
+        LinkPlan(size_t n) : kinds(n), ids(n), parentIds(n), ignoredAs(n, (const char*)NULL), 
+                parents(n, NONE), attachAt(n, NONE) {}
+    };
+    
+    typedef boost::unordered_map<string, uint32_t> IdIndex;
+    typedef boost::function<void()> LinkTask;
+    
+    /**
+     * Links gffs into this model, which must be empty, in four phases:
+     * 
+     *  1. Records are classified, and their ids decoded, in parallel ranges
+     *  2. Genes and transcripts are indexed by id, each by its own thread
+     *  3. Parents are looked up in the indices, in parallel ranges
+     *  4. Children are attached to their parents, partitioned by parent
+     * 
+     * Between 3 and 4 a single quick pass replays the order in which serial
+     * linking would attach each record, so that held back records, errors
+     * and log entries all come out as they would have serially.  Children
+     * are attached in file order, as they would be serially.
+     * 
+     * Duplicate gene or transcript ids make the outcome depend on the order
+     * records are linked in, so in that case nothing is linked and false is
+     * returned for the caller to link serially instead.  The same goes for
+     * shared features, which the later phases assume don't exist.  Records
+     * whose parent is missing are left for finishLinking, so leniency only
+     * comes into it there, as it does after linking serially.
+     */
+    bool linkParallel(const GFFList& gffs, ParseLog& log, uint16_t threads) {
+        
+        const size_t n = gffs.size();
+        const uint32_t NONE = LinkPlan::NONE;
+        
+        if (n >= NONE) {
+            return false;
+        }
+        
+        LinkPlan plan(n);
+        
+        vector<LinkTask> tasks;
+        for(uint16_t t = 0; t < threads; t++) {
+            tasks.push_back(boost::bind(&GFFModel::classifyRange, boost::cref(gffs), boost::ref(plan), 
+                    n * t / threads, n * (t + 1) / threads));
+        }
+        runTasks(tasks);
+        
+        if (std::find(plan.kinds.begin(), plan.kinds.end(), (uint8_t)LINK_SHARED) != plan.kinds.end()) {
+            return false;
+        }
+        
+        IdIndex geneIndex, transcriptIndex;
+        bool duplicateGenes = false, duplicateTranscripts = false;
+        
+        tasks.clear();
+        tasks.push_back(boost::bind(&GFFModel::indexIds, boost::cref(plan), (uint8_t)LINK_GENE, 
+                boost::ref(geneIndex), boost::ref(duplicateGenes)));
+        tasks.push_back(boost::bind(&GFFModel::indexIds, boost::cref(plan), (uint8_t)LINK_TRANSCRIPT, 
+                boost::ref(transcriptIndex), boost::ref(duplicateTranscripts)));
+        runTasks(tasks);
+        
+        if (duplicateGenes || duplicateTranscripts) {
+            return false;
+        }
+        
+        tasks.clear();
+        for(uint16_t t = 0; t < threads; t++) {
+            tasks.push_back(boost::bind(&GFFModel::resolveRange, boost::ref(plan), 
+                    boost::cref(geneIndex), boost::cref(transcriptIndex), 
+                    n * t / threads, n * (t + 1) / threads));
+        }
+        runTasks(tasks);
+        
+        // A transcript is attached once both it and its gene have been seen,
+        // a feature once both it and its transcript have been attached
+        for(uint32_t i = 0; i < n; i++) {
+            if (plan.kinds[i] == LINK_TRANSCRIPT && plan.parents[i] != NONE) {
+                plan.attachAt[i] = std::max(i, plan.parents[i]);
+            }
+        }
+        
+        for(uint32_t i = 0; i < n; i++) {
+            if (plan.kinds[i] == LINK_FEATURE && plan.parents[i] != NONE && plan.attachAt[plan.parents[i]] != NONE) {
+                plan.attachAt[i] = std::max(i, plan.attachAt[plan.parents[i]]);
+            }
+        }
+        
+        // Replay the serial order: log ignored records, and count those held
+        // back, as they're found
+        vector<uint32_t> released(n, 0);
+        for(uint32_t i = 0; i < n; i++) {
+            if (plan.attachAt[i] != NONE && plan.attachAt[i] != i) {
+                released[plan.attachAt[i]]++;
+            }
+        }
+        
+        size_t held = 0;
+        
+        for(uint32_t i = 0; i < n; i++) {
+            
+            held -= released[i];
+            
+            if (plan.kinds[i] == LINK_IGNORED) {
+                log.add(plan.ignoredAs[i], gffs[i]->GetId());
+            }
+            else if (plan.kinds[i] != LINK_GENE && plan.attachAt[i] != i) {
+                
+                checkOrphanLimit(held, gffs[i]);
+                
+                held++;
+                peakOrphans = std::max(peakOrphans, held);
+            }
+        }
+        
+        // Whatever never gets attached is left for finishLinking, which
+        // reports it in file order
+        for(uint32_t i = 0; i < n; i++) {
+            if (plan.kinds[i] != LINK_GENE && plan.kinds[i] != LINK_IGNORED && plan.attachAt[i] == NONE) {
+                
+                OrphanMap& orphans = plan.kinds[i] == LINK_TRANSCRIPT ? orphanTranscripts : orphanFeatures;
+                orphans[plan.parentIds[i]].push_back(Orphan(nbLinked + i, gffs[i]));
+                nbOrphans++;
+            }
+        }
+        
+        nbLinked += n;
+        
+        tasks.clear();
+        for(uint16_t t = 0; t < threads; t++) {
+            tasks.push_back(boost::bind(&GFFModel::attachPartition, boost::cref(gffs), boost::cref(plan), t, threads));
+        }
+        arena->prepareKeys();
+        tasks.push_back(boost::bind(&GFFModel::indexGenes, this, boost::cref(gffs), boost::cref(plan)));
+        tasks.push_back(boost::bind(&GFFModel::indexTranscripts, this, boost::cref(gffs), boost::cref(plan)));
+        runTasks(tasks);
+        
+        return true;
+    }
+    
+    static void classifyRange(const GFFList& gffs, LinkPlan& plan, size_t begin, size_t end) {
+        
+        for(size_t i = begin; i < end; i++) {
+            
+            const LinkKind kind = classify(gffs[i], plan.parentIds[i], plan.ignoredAs[i]);
+            plan.kinds[i] = kind;
+            
+            if (kind == LINK_GENE || kind == LINK_TRANSCRIPT) {
+                plan.ids[i] = gffs[i]->GetId();
+            }
+        }
+    }
+    
+    static void indexIds(const LinkPlan& plan, uint8_t kind, IdIndex& index, bool& duplicate) {
+        
+        index.reserve(std::count(plan.kinds.begin(), plan.kinds.end(), kind));
+        
+        for(uint32_t i = 0; i < plan.kinds.size(); i++) {
+            if (plan.kinds[i] == kind && !index.insert(std::make_pair(plan.ids[i], i)).second) {
+                duplicate = true;
+            }
+        }
+    }
+    
+    static void resolveRange(LinkPlan& plan, const IdIndex& geneIndex, const IdIndex& transcriptIndex, size_t begin, size_t end) {
+        
+        for(size_t i = begin; i < end; i++) {
+            
+            const IdIndex* index = 
+                    plan.kinds[i] == LINK_TRANSCRIPT ? &geneIndex : 
+                    plan.kinds[i] == LINK_FEATURE ? &transcriptIndex : 
+                    NULL;
+            
+            if (index != NULL) {
+                IdIndex::const_iterator parent = index->find(plan.parentIds[i]);
+                if (parent != index->end()) {
+                    plan.parents[i] = parent->second;
+                }
+            }
+        }
+    }
+    
+    /**
+     * Attaches, in file order, every child whose parent falls in partition
+     * part.  Each record is only ever modified as a parent by one partition.
+     */
+    static void attachPartition(const GFFList& gffs, const LinkPlan& plan, uint16_t part, uint16_t nbParts) {
+        
+        for(uint32_t i = 0; i < gffs.size(); i++) {
+            
+            const uint32_t parent = plan.parents[i];
+            
+            if (plan.attachAt[i] != LinkPlan::NONE && parent % nbParts == part) {
+                gffs[parent]->addChild(gffs[i], plan.kinds[i] == LINK_FEATURE);
+            }
+        }
     }
     
-    virtual ~GFFModel() {
+    void indexGenes(const GFFList& gffs, const LinkPlan& plan) {
         
-        BOOST_FOREACH(GFFPtr gff, *geneList) {
-            if (gff) {
-                gff->removeLinks();
-                gff.reset();
+        for(uint32_t i = 0; i < gffs.size(); i++) {
+            if (plan.kinds[i] == LINK_GENE) {
+                geneList->push_back(gffs[i]);
+                store(genesByKey, arena->keyOf(gffs[i]), gffs[i]);
             }
         }
     }
     
-    GFFPtr getGeneByIndex(uint32_t index) {
-        return (*geneList)[index];
-    }
-    
-    bool containsGene(string id) {
-        return geneMap.count(id);
-    }
-
-    GFFPtr getGeneById(string& id) {
-        return geneMap[id];
+    void indexTranscripts(const GFFList& gffs, const LinkPlan& plan) {
+        
+        for(uint32_t i = 0; i < gffs.size(); i++) {
+            if (plan.kinds[i] == LINK_TRANSCRIPT && plan.attachAt[i] != LinkPlan::NONE) {
+                storeTranscript(gffs[i]);
+            }
+        }
     }
     
-    bool containsTranscript(string id) {
-        return transcriptMap.count(id);
+    static GFFPtr lookup(const GFFList& index, uint32_t key) {
+        return key < index.size() ? index[key] : NULL;
     }
     
-    GFFPtr getTranscriptById(string id) {
-        return transcriptMap[id];
+    static void store(GFFList& index, uint32_t key, GFFPtr gff) {
+        
+        if (key >= index.size()) {
+            index.resize(std::max<size_t>(key + 1, index.size() * 2), NULL);
+        }
+        
+        index[key] = gff;
     }
     
-    size_t getTotalNbTranscripts() {
-        return transcriptMap.size();
+    void storeTranscript(GFFPtr transcript) {
+        
+        const uint32_t key = arena->keyOf(transcript);
+        
+        if (!lookup(transcriptsByKey, key)) {
+            nbTranscripts++;
+        }
+        
+        store(transcriptsByKey, key, transcript);
     }
     
-    size_t getNbTranscripts(string& id) {
-        return geneMap[id]->GetNbChildren();
+    static void runTask(const LinkTask& task, boost::exception_ptr& error) {
+        
+        try {
+            task();
+        }
+        catch(...) {
+            error = boost::current_exception();
+        }
     }
     
-    size_t getNbGenes() {
-        return geneList->size();
+    /**
+     * Runs each task on its own thread, rethrowing the first error, if any,
+     * once they've all finished
+     */
+    static void runTasks(const vector<LinkTask>& tasks) {
+        
+        vector<boost::exception_ptr> errors(tasks.size());
+        
+        boost::thread_group workers;
+        for(size_t i = 0; i < tasks.size(); i++) {
+            workers.create_thread(boost::bind(&GFFModel::runTask, boost::cref(tasks[i]), boost::ref(errors[i])));
+        }
+        workers.join_all();
+        
+        for(size_t i = 0; i < tasks.size(); i++) {
+            if (errors[i]) {
+                boost::rethrow_exception(errors[i]);
+            }
+        }
     }
     
-    GFFListPtr getGeneList() {
-        return geneList;
+    void checkOrphanLimit(size_t held, GFFPtr gff) const {
+        
+        if (held >= maxOrphans) {
+            BOOST_THROW_EXCEPTION(GFFException() << GFFErrorInfo(string(
+                "Invalid GFF: More than ") + lexical_cast<string>(maxOrphans) + 
+                    " records are waiting for a parent that hasn't been seen yet, the latest being: " + gff->GetId() +
+                    ".  Sort the input so that parents come before their children."));
+        }
     }
     
-    GFFListPtr getFullList() {
-        
-        GFFListPtr gffs = make_shared<GFFList>();
+    void holdOrphan(OrphanMap& orphans, const string& parentId, uint32_t seq, GFFPtr gff) {
         
-        BOOST_FOREACH(GFFPtr gene, *(this->geneList)) {
+        if (gff->IsShared()) {
             
-            gffs->push_back(gene);            
-            gene->GetAllChildren(*gffs);            
+            uint32_t& held = sharedOrphans[gff];
+            
+            if (held++ > 0) {
+                orphans[parentId].push_back(Orphan(seq, gff));
+                return;
+            }
         }
         
-        return gffs;        
+        checkOrphanLimit(nbOrphans, gff);
+        
+        orphans[parentId].push_back(Orphan(seq, gff));
+        
+        nbOrphans++;
+        peakOrphans = std::max(peakOrphans, nbOrphans);
     }
     
-    GFFListPtr getAllOfType(GffType type) {
+    /**
+     * Moves the records waiting for parentId, in the order they arrived, into
+     * adopted.  Returns false if there weren't any.
+     */
+    bool adoptOrphans(OrphanMap& orphans, const string& parentId, vector<Orphan>& adopted) {
+        
+        if (nbOrphans == 0) {
+            return false;
+        }
         
-        GFFListPtr gffs = make_shared<GFFList>();
+        OrphanMap::iterator it = orphans.find(parentId);
         
-        GFFListPtr genes = this->geneList;
+        if (it == orphans.end()) {
+            return false;
+        }
         
-        if (genes) {
-            BOOST_FOREACH(GFFPtr gene, *genes) {
-                gffs->push_back(gene);            
-                gene->GetAllOfType(type, *gffs);            
+        adopted.swap(it->second);
+        orphans.erase(it);
+        
+        BOOST_FOREACH(const Orphan& o, adopted) {
+            
+            // Shared features stop counting once they're found by every
+            // parent they were held under
+            if (o.second->IsShared()) {
+                
+                boost::unordered_map<GFFPtr, uint32_t>::iterator shared = sharedOrphans.find(o.second);
+                
+                if (--shared->second > 0) {
+                    continue;
+                }
+                
+                sharedOrphans.erase(shared);
             }
+            
+            nbOrphans--;
         }
         
-        return gffs;        
+        return true;
     }
+    
+    void clearOrphans() {
         
-    void addGene(GFFPtr gff) {
+        orphanTranscripts.clear();
+        orphanFeatures.clear();
+        sharedOrphans.clear();
+        nbOrphans = 0;
+    }
+    
+    /**
+     * Hands any genes held by this model to handler and then frees them, so
+     * must only be used on a model that doesn't share its arena.  Records
+     * still waiting for a parent are dealt with by finishLinking first.
+     * Returns the number of genes flushed.
+     */
+    uint32_t flush(GeneHandler& handler, ParseLog& log, bool lenient) {
         
-        string id = gff->GetId();
+        finishLinking(log, lenient);
         
-        if (gff->GetType() != GENE) {
-            BOOST_THROW_EXCEPTION(GFFException() << GFFErrorInfo(string(
-                "The GFF provided does not represent a gene: ") + id));
-        }
+        const uint32_t nbGenes = geneList->size();
         
-        if (this->geneMap.count(id)) {
-            BOOST_THROW_EXCEPTION(GFFException() << GFFErrorInfo(string(
-                "Invalid GFF: Already loaded gene with this Id: ") + id));
-        }
-        else {
-            this->geneMap[id] = gff;
-            this->geneList->push_back(gff);
-            
-            BOOST_FOREACH(GFFPtr transcript, *(gff->GetChildList())) {
-                this->transcriptMap[transcript->GetId()] = transcript;
-            }
+        BOOST_FOREACH(GFFPtr gene, *geneList) {
+            handler(gene);
         }
+        
+        clear();
+        arena->clear();
+        
+        return nbGenes;
     }
     
-    void rebuildGeneMap() {
-       
-        this->geneMap.clear();
+    /**
+     * Returns the type of a trimmed GFF line without parsing the rest of it.
+     * Like GFF::parse, runs of tabs count as a single separator.
+     */
+    static GffType peekType(const StrRef& line) {
         
-        BOOST_FOREACH(GFFPtr gene, *(this->geneList)) {
-            this->geneMap[gene->GetId()] = gene;
+        const char* p = line.b;
+        
+        for(int i = 0; i < 2; i++) {
+            while (p != line.e && *p != '\t') p++;
+            while (p != line.e && *p == '\t') p++;
         }
+        
+        const char* typeEnd = p;
+        while (typeEnd != line.e && *typeEnd != '\t') typeEnd++;
+        
+        return gffTypeFromString(StrRef(p, typeEnd));
     }
     
+public:
+    
     static GFFModelPtr load(const string& path) {
+        return load(path, 1);
+    }
+    
+    static GFFModelPtr load(const string& path, uint16_t threads) {
+        
+        ParseLog ignored;
+        GFFModelPtr geneModel = load(path, threads, ignored, false);
+        ignored.report(cerr);
+        
+        return geneModel;
+    }
+    
+    static GFFModelPtr load(const string& path, uint16_t threads, ParseLog& log, bool lenient) {
+        return load(path, threads, log, lenient, DEFAULT_MAX_ORPHANS);
+    }
+    
+    /**
+     * Loads and links every record in the GFF3 file at path.  Records needn't
+     * be sorted, children found before their parent are held back until the
+     * parent is found, but no more than maxOrphans of them at once.
+     * Unsupported records are counted in log rather than reported one by one.
+     * When lenient, malformed records and records that can't be linked are
+     * also counted in log and left out, otherwise they throw.  Reporting log
+     * is left to the caller.
+     */
+    static GFFModelPtr load(const string& path, uint16_t threads, ParseLog& log, bool lenient, size_t maxOrphans) {
         
         GFFModelPtr geneModel = make_shared<GFFModel>();
+        geneModel->setMaxOrphans(maxOrphans);
         
         GFFList gffs;
-        GFF::load(GFF3, path, gffs);
+        GFF::load(GFF3, path, gffs, *geneModel->arena, ANY, threads, lenient ? &log : NULL);
         
         auto_cpu_timer timer(1, " = Wall time taken: %ws\n");
         cout << " - Linking GFF records to create gene model" << endl;
         
-        BOOST_FOREACH(GFFPtr gff, gffs) {
+        geneModel->linkAll(gffs, log, lenient, threads);
+        
+        if (geneModel->getPeakOrphans() > 0) {
+            cout << " - Held back up to " << geneModel->getPeakOrphans() << " records found before their parent" << endl;
+        }
+        
+        cout << " - Found " << geneModel->getNbGenes() << " genes and " << geneModel->getTotalNbTranscripts() << " transcripts" << endl;
+        
+        return geneModel;
+    }
+    
+    static uint32_t stream(const string& path, GeneHandler handler) {
+        return stream(path, handler, 1);
+    }
+    
+    /**
+     * Loads a GFF3 file one gene at a time, passing each complete gene, with
+     * all its transcripts and their features attached, to handler.  A gene is
+     * considered complete when a "###" directive or the next gene is found.
+     * Once handler returns the gene is freed, so peak memory is bounded by
+     * the largest gene rather than the whole file.  Handlers must therefore
+     * copy anything they want to keep into an arena of their own.  That
+     * arena doesn't keep the input, so copies don't point at their lines in
+     * it and are written from their fields, see GFFArena::copy.
+     * 
+     * The input must be grouped by gene, i.e. every record must follow its
+     * gene and precede the next gene, though within a gene features may come
+     * before their transcript.  Returns the number of genes streamed.
+     */
+    static uint32_t stream(const string& path, GeneHandler handler, uint16_t threads) {
+        
+        ParseLog ignored;
+        const uint32_t nbGenes = stream(path, handler, threads, ignored, false);
+        ignored.report(cerr);
+        
+        return nbGenes;
+    }
+    
+    /**
+     * As stream above, but unsupported records, and when lenient malformed or
+     * unlinkable ones, are counted in log as they would be by load
+     */
+    static uint32_t stream(const string& path, GeneHandler handler, uint16_t threads, ParseLog& log, bool lenient) {
+        
+        auto_cpu_timer timer(1, " = Wall time taken: %ws\n");
+        cout << " - Streaming genes from GFF: " << path << endl;
+        
+        FileBuffer file(path, threads);
+        
+        GFFModel current;
+        uint32_t nbGenes = 0;
+        uint32_t nbRecords = 0;
+        
+        const char* p = file.begin();
+        const char* end = file.end();
+        
+        while (p < end) {
             
-            string id = gff->GetId();
+            const char* lineEnd = gts::io::findLineEnd(p, end);
+            StrRef line = gts::io::trim(StrRef(p, lineEnd));
+            p = lineEnd + 1;
             
-            if (gff->GetType() == GENE) {
-                geneModel->addGene(gff);
+            if (line.empty()) {
+                continue;
             }
-            else if (gff->GetType() == MRNA || gff->GetType() == MIRNA) {
-                
-                string parent = gff->GetParentId();
             
-                // We assume the gene is already present... should be in most GFFs
-                if (geneModel->geneMap.count(parent) > 0) {                    
-                    geneModel->geneMap[parent]->addChild(gff);
-                    geneModel->transcriptMap[id] = gff;
+            if (line[0] == '#') {
+                
+                if (line.equals("###")) {
+                    nbGenes += current.flush(handler, log, lenient);
                 }
-                else {
-                    BOOST_THROW_EXCEPTION(GFFException() << GFFErrorInfo(string(
-                        "Invalid GFF: Could not find parent gene for mRNA: ") + id));
+                else if (line.equals("##FASTA")) {
+                    // Nothing but sequence data from here on
+                    break;
                 }
-            }
-            else if (gff->GetType() == PROTEIN) {
-                
-                cerr << "Ignoring protein: " << id << endl;
                 
-                /*string derivesFrom = gff->GetDerivesFrom();
-                
-                // We assume the gene is already present... should be in most GFFs
-                if (geneModel->transcriptMap.count(derivesFrom) > 0) {                    
-                    geneModel->transcriptMap[derivesFrom]->addChild(gff, true);
-                }
-                else {
-                    BOOST_THROW_EXCEPTION(GFFException() << GFFErrorInfo(string(
-                        "Invalid GFF: Could not find parent gene for mRNA: ") + id));
-                }*/
+                continue;
             }
-            else {
             
-                string parent = gff->GetParentId();
+            // Flushing frees the model's arena, so the previous gene has to go
+            // before the next one is parsed into it
+            if (peekType(line) == GENE) {
+                nbGenes += current.flush(handler, log, lenient);
+            }
             
-                vector<string> parents;
-                boost::split( parents, parent, boost::is_any_of(","), boost::token_compress_off );
-                
-                vector<string> filteredParents;
-                
-                BOOST_FOREACH(string p, parents) {
-                    
-                    if (p.find("-Protein") == std::string::npos) {
-                        filteredParents.push_back(p);
-                    }
-                }
-                
-                if (filteredParents.size() > 1) {
-                    cerr << "Ignoring GFF entry: id-" << id << "; type-" << gff->GetType() << endl;
-                }
-                else {                
-                
-                    if (geneModel->transcriptMap.count(filteredParents[0]) > 0) {
-                        geneModel->transcriptMap[filteredParents[0]]->addChild(gff, true);                        
-                    }
-                    else {
-                        BOOST_THROW_EXCEPTION(GFFException() << GFFErrorInfo(string(
-                            "Invalid GFF: Could not find parent transcript for GFF entry: ") + id));                    
-                    }
-                }
+            GFFPtr gff = GFF::parse(GFF3, line.b, line.e, *current.arena, lenient ? &log : NULL);
+            nbRecords++;
+            
+            if (gff != NULL) {
+                gff->SetLine(line.b, line.e);
+                current.linkRecord(gff, log, lenient);
             }
         }
         
-        cout << " - Found " << geneModel->getNbGenes() << " genes and " << geneModel->getTotalNbTranscripts() << " transcripts" << endl;
+        nbGenes += current.flush(handler, log, lenient);
+        
+        cout << " - Streamed " << nbGenes << " genes from " << nbRecords << " GFF records" << endl;
+        
+        return nbGenes;
+    }
+    
+    /**
+     * Serialises the model for the binary cache.  All IDs and parent IDs go
+     * into a front-coded dictionary written up front, records then refer to
+     * them by index.
+     */
+    void writeBinary(BinaryWriter& out) const {
+        
+        vector<string> idList;
+        
+        BOOST_FOREACH(GFFPtr gene, *geneList) {
+            gene->collectIds(idList);
+        }
+        
+        const FrontCodedDictionary ids(idList);
+        vector<string>().swap(idList);
+        
+        ids.writeBinary(out);
+        
+        out.putVarint(geneList->size());
+        
+        // Features can be shared by transcripts of different genes
+        SharedIndex written;
+        
+        BOOST_FOREACH(GFFPtr gene, *geneList) {
+            gene->writeBinary(out, written, &ids);
+        }
+    }
+    
+    /**
+     * Reads back a model written by writeBinary from in, which reads from
+     * data.  The model's arena keeps data, as records point at their lines
+     * in it.
+     */
+    static GFFModelPtr readBinary(BinaryReader& in, const MappedFilePtr& data) {
+        
+        GFFModelPtr geneModel = make_shared<GFFModel>();
+        geneModel->arena->keep(data);
+        
+        FrontCodedDictionary ids;
+        ids.readBinary(in);
+        
+        const size_t nbGenes = in.getVarint();
+        geneModel->geneList->reserve(nbGenes);
+        
+        GFFList read;
+        
+        for(size_t i = 0; i < nbGenes; i++) {
+            geneModel->addGene(GFF::readBinary(in, *geneModel->arena, 0, read, &ids));
+        }
         
         return geneModel;
     }
     
+    /**
+     * Puts the genes, and every record below them, in GFFOrdering order,
+     * unless they already are.  Later saves then write them out as they are.
+     */
+    void sort() {
+        
+        if (sorted) {
+            return;
+        }
+        
+        GFF::sortList(*geneList);
+        
+        BOOST_FOREACH(GFFPtr gene, *geneList) {
+            gene->sortDescendants();
+        }
+        
+        sorted = true;
+    }
+    
+    bool isSorted() const {
+        return sorted;
+    }
+    
+    /**
+     * Marks this model as sorted without sorting it, for a model that's been
+     * built from a sorted one without reordering anything
+     */
+    void setSorted(bool sorted) {
+        this->sorted = sorted;
+    }
+    
     void save(const string path) {
         save(path, false, string(""));
     }
@@ -1171,6 +3834,10 @@ public:
     }
     
     void save(const string path, const bool sort, const string source) {
+        save(path, sort, source, 1);
+    }
+    
+    void save(const string path, const bool sort, const string source, uint16_t threads) {
         
         auto_cpu_timer timer(1, " = Wall time taken: %ws\n\n");
         cout << " - Saving to: " << path << endl;
@@ -1183,26 +3850,215 @@ public:
             
                 const string s = source.empty() ? this->geneList->at(0)->GetSource() : source;
 
-                if (sort) {
+                if (sort && !sorted) {
                     cout << " - Sorting GFF records" << endl;
-                    std::sort(this->geneList->begin(), this->geneList->end(), GFF::GFFOrdering());
+                    this->sort();
                 }
 
                 ofstream file(path.c_str());
+                TextWriter writer(file);
 
-                BOOST_FOREACH(GFFPtr gene, *(this->geneList)) {
-
-                    gene->write(file, s, true);
-
-                    // Separate genes with an extra line
-                    file << endl;
-
-                }
+                write(writer, s, threads);
+                
+                writer.flush();
                 file.close();                            
             }
         }
     }
     
+    /**
+     * Writes every gene, and everything below it, separating genes with an
+     * extra line.  With more than one thread, worker threads format batches
+     * of genes into their own buffers while this one writes the buffers out
+     * in gene order, so the output is the same however many threads are used.
+     * A feature shared between genes is written under the first of them.
+     */
+    void write(TextWriter& out, const string& source, uint16_t threads) const {
+        
+        if (threads <= 1 || geneList->size() <= SAVE_BATCH_GENES) {
+            
+            SharedSet written;
+            
+            BOOST_FOREACH(GFFPtr gene, *geneList) {
+                
+                gene->write(out, source, true, !sorted, written);
+                
+                // Separate genes with an extra line
+                out.put('\n');
+            }
+            
+            return;
+        }
+        
+        SaveQueue queue(*geneList, source, !sorted, threads * 4);
+        
+        // Shared features are decoded here as two threads could otherwise
+        // decode them at once, and each is handed to the first gene it's in
+        SharedOwners owners;
+        for(size_t i = 0; i < geneList->size(); i++) {
+            claimShared((*geneList)[i], i, owners, queue.skipped);
+        }
+        vector<boost::exception_ptr> errors(threads);
+        
+        boost::thread_group workers;
+        for(uint16_t i = 0; i < threads; i++) {
+            workers.create_thread(boost::bind(&GFFModel::formatBatches, boost::ref(queue), boost::ref(errors[i])));
+        }
+        
+        for(size_t i = 0; i < queue.nbBatches; i++) {
+            
+            TextWriter& batch = *queue.slots[i % queue.window];
+            
+            {
+                boost::mutex::scoped_lock lock(queue.mutex);
+                
+                while (!queue.ready[i % queue.window] && !queue.failed) {
+                    queue.changed.wait(lock);
+                }
+                
+                if (queue.failed) {
+                    break;
+                }
+            }
+            
+            out.put(batch.GetData(), batch.GetSize());
+            batch.clear();
+            
+            {
+                boost::mutex::scoped_lock lock(queue.mutex);
+                queue.ready[i % queue.window] = false;
+                queue.written++;
+            }
+            queue.changed.notify_all();
+        }
+        
+        workers.join_all();
+        
+        for(uint16_t i = 0; i < threads; i++) {
+            if (errors[i]) {
+                boost::rethrow_exception(errors[i]);
+            }
+        }
+    }
+    
+private:
+    
+    enum { SAVE_BATCH_GENES = 256 };
+    
+    // Index of the gene that writes each shared feature
+    typedef boost::unordered_map<const GFF*, size_t> SharedOwners;
+    
+    // Shared features each gene leaves to an earlier gene, only for the genes
+    // that have any
+    typedef boost::unordered_map<size_t, SharedSet> SkippedShared;
+    
+    static void claimShared(GFFPtr gff, size_t gene, SharedOwners& owners, SkippedShared& skipped) {
+        
+        BOOST_FOREACH(GFFPtr child, gff->GetChildList()) {
+            
+            if (child->IsShared()) {
+                
+                child->decodeAttributes();
+                
+                if (owners.insert(std::make_pair(child, gene)).first->second != gene) {
+                    skipped[gene].insert(child);
+                    continue;
+                }
+            }
+            
+            claimShared(child, gene, owners, skipped);
+        }
+    }
+    
+    /**
+     * Batches of genes being formatted by the worker threads of a parallel
+     * write.  Batch i is formatted into slot i % window, and no batch is
+     * started until the one window places before it has been written out.
+     */
+    struct SaveQueue : boost::noncopyable {
+        
+        const GFFList& genes;
+        const string& source;
+        const bool sortChildren;
+        const size_t nbBatches;
+        const size_t window;
+        
+        SkippedShared skipped;
+        
+        vector<boost::shared_ptr<TextWriter> > slots;
+        vector<bool> ready;
+        size_t next;
+        size_t written;
+        bool failed;
+        
+        boost::mutex mutex;
+        boost::condition_variable changed;
+        
+        SaveQueue(const GFFList& genes, const string& source, bool sortChildren, size_t window) :
+            genes(genes), 
+            source(source),
+            sortChildren(sortChildren),
+            nbBatches((genes.size() + SAVE_BATCH_GENES - 1) / SAVE_BATCH_GENES),
+            window(window),
+            ready(window, false),
+            next(0), written(0), failed(false) {
+            
+            for(size_t i = 0; i < window; i++) {
+                slots.push_back(boost::make_shared<TextWriter>());
+            }
+        }
+    };
+    
+    static void formatBatches(SaveQueue& queue, boost::exception_ptr& error) {
+        
+        try {
+            while(true) {
+                
+                size_t batch;
+                
+                {
+                    boost::mutex::scoped_lock lock(queue.mutex);
+                    
+                    while (!queue.failed && queue.next < queue.nbBatches && queue.next >= queue.written + queue.window) {
+                        queue.changed.wait(lock);
+                    }
+                    
+                    if (queue.failed || queue.next >= queue.nbBatches) {
+                        return;
+                    }
+                    
+                    batch = queue.next++;
+                }
+                
+                TextWriter& out = *queue.slots[batch % queue.window];
+                const size_t end = std::min(queue.genes.size(), (batch + 1) * SAVE_BATCH_GENES);
+                
+                for(size_t i = batch * SAVE_BATCH_GENES; i < end; i++) {
+                    
+                    SkippedShared::const_iterator skip = queue.skipped.find(i);
+                    SharedSet written = skip != queue.skipped.end() ? skip->second : SharedSet();
+                    
+                    queue.genes[i]->write(out, queue.source, true, queue.sortChildren, written);
+                    out.put('\n');
+                }
+                
+                {
+                    boost::mutex::scoped_lock lock(queue.mutex);
+                    queue.ready[batch % queue.window] = true;
+                }
+                queue.changed.notify_all();
+            }
+        }
+        catch(...) {
+            error = boost::current_exception();
+            
+            {
+                boost::mutex::scoped_lock lock(queue.mutex);
+                queue.failed = true;
+            }
+            queue.changed.notify_all();
+        }
+    }
 };
 
 }
@@ -44,7 +44,9 @@ namespace po = boost::program_options;
 namespace bfs = boost::filesystem;
 
 #include "gff.hpp"
+#include "id_filter.hpp"
 using gts::gff::GFF;
+using gts::gff::GFFArena;
 using gts::gff::GFFPtr;
 using gts::gff::GFFListPtr;
 using gts::gff::GFF3;
@@ -54,8 +56,10 @@ using gts::gff::GFFException;
 using gts::gff::GffType;
 using gts::gff::GFFModel;
 using gts::gff::GFFModelPtr;
+using gts::StringPool;
+using gts::StreamingIdFilter;
 
-typedef std::vector<shared_ptr<GFF> > GFFList;
+typedef std::vector<GFFPtr> GFFList;
 
 string helpHeader() {
     return string("\nGFF Filter Help.\n\n") +
@@ -84,42 +88,6 @@ void loadEntries(string& path, unordered_set<string>& transcriptSet) {
     cout << " - Loaded " << transcriptSet.size() << " entries from file." << endl;
 }
 
-void filter(GFFModel& input, unordered_set<string>& transcriptSet, GFFModel& output) {
-    
-    auto_cpu_timer timer(1, " = Wall time taken: %ws\n\n");
-    
-    // Index genomic GFFs by Id
-    BOOST_FOREACH(GFFPtr gene, *input.getGeneList()) {
-
-        GFFList goodTranscripts;
-        
-        BOOST_FOREACH(GFFPtr transcript, *gene->GetChildList()) {
-            
-            if (transcriptSet.count(transcript->GetId()) > 0) {
-                // Do nothing
-            }
-            else {
-                goodTranscripts.push_back(transcript);
-            }
-        }
-        
-        // We only want genes with 1 or more good transcript
-        if (goodTranscripts.size() >= 1) {                
-
-            // Copy gene without child info
-            GFFPtr newGene = make_shared<GFF>(*gene);
-
-            BOOST_FOREACH(GFFPtr goodTranscript, goodTranscripts) {
-                newGene->addChild(goodTranscript);
-            }
-
-            output.addGene(newGene); 
-        }
-    }
-    cout << " - Keeping " << output.getNbGenes() << " out of " << input.getNbGenes() << " genes" << endl;
-    cout << " - Keeping " << output.getTotalNbTranscripts() << " out of " << input.getTotalNbTranscripts() << " transcripts" << endl;
-}
-
 void typeFilter(GFFList& input, string typeInc, string typeExc, GFFList& output) {
    
     bool doInc = !typeInc.empty();
@@ -166,6 +134,9 @@ int main(int argc, char *argv[]) {
         string typeInc;
         string typeExc;
         string outputFile;
+        uint16_t threads;
+        bool stream;
+        bool lenient;
         
         bool version;
         bool help;
@@ -183,6 +154,12 @@ int main(int argc, char *argv[]) {
                     "Output will exclude records with this type")
                 ("output,o", po::value<string>(&outputFile),
                     "The tab separated output file which will contain IDs")
+                ("threads", po::value<uint16_t>(&threads)->default_value(1),
+                    "The number of threads to use when parsing the input and writing the output")
+                ("stream", po::bool_switch(&stream)->default_value(false), 
+                    "Filter one gene at a time as it's read and write it straight out, rather than loading the whole gene model first.  The input must be grouped by gene.  Memory is only bounded for uncompressed input, gzip and BGZF input is still inflated into memory in full.")
+                ("lenient", po::bool_switch(&lenient)->default_value(false), 
+                    "Skip malformed records, and records that can't be linked to their parents, instead of stopping.  A summary of what was skipped is output at the end.")
                 ("version", po::bool_switch(&version)->default_value(false), "Print version string")
                 ("help", po::bool_switch(&help)->default_value(false), "Produce help message")
                 ;
@@ -222,40 +199,62 @@ int main(int argc, char *argv[]) {
                     "Could not find input file at: ") + inputFile));
         }
         
-        cout << "Loading gene model" << endl;
-        GFFModelPtr geneModel = GFFModel::load(inputFile);            
-
-        GFFModelPtr in1 = geneModel;
-        GFFModelPtr in2;
-        GFFModelPtr in3;
-        GFFModelPtr in4;
-            
+        unordered_set<string> transcriptsToExclude;
+        
         if (!listFile.empty()) {
-            
             cout << "Loading transcript IDs (mRNAs) to filter" << endl;
-            unordered_set<string> transcriptsToExclude;
             loadEntries(listFile, transcriptsToExclude);
+        }
+        
+        // Records we skip are summarised at the end rather than one at a time
+        ParseLog issues;
+        
+        if (!stream) {
+        
+            cout << "Loading gene model" << endl;
+            GFFModelPtr geneModel = GFFModel::load(inputFile, threads, issues, lenient);            
 
-            cout << "Filtering listed entries from GFF" << endl;
-            in2 = make_shared<GFFModel>();
-            GFFModelPtr gmOut = make_shared<GFFModel>();
-            filter(*in1, transcriptsToExclude, *in2);
+            GFFModelPtr in1 = geneModel;
+            GFFModelPtr in2;
+            GFFModelPtr in3;
+            GFFModelPtr in4;
+            
+            if (!listFile.empty()) {
+            
+                cout << "Filtering listed entries from GFF" << endl;
+                in2 = make_shared<GFFModel>(in1->getArena());
+                gts::filterIds(*in1, transcriptsToExclude, *in2);
+            }
+            else {
+                in2 = geneModel;
+            }
+        
+            /*if (!typeInc.empty() || !typeExc.empty()) {
+                cout << "Filtering by type" << endl;
+                in4 = make_shared<GFFList>();
+                typeFilter(*in3, typeInc, typeExc, *in4);            
+            }
+            else {
+                in4 = in3;
+            }*/
+        
+            cout << "Writing filtered GFF to disk" << endl;        
+            in2->save(outputFile, false, string(""), threads);
         }
         else {
-            in2 = geneModel;
+            
+            cout << "Filtering listed entries from GFF while streaming to disk" << endl;
+            StreamingIdFilter streamingFilter(transcriptsToExclude, outputFile);
+            GFFModel::stream(inputFile, boost::ref(streamingFilter), threads, issues, lenient);
+            
+            cout << " - Keeping " << streamingFilter.nbGenesOut << " out of " << streamingFilter.nbGenesIn << " genes" << endl;
+            cout << " - Keeping " << streamingFilter.nbTranscriptsOut << " out of " << streamingFilter.nbTranscriptsIn << " transcripts" << endl;
         }
         
-        /*if (!typeInc.empty() || !typeExc.empty()) {
-            cout << "Filtering by type" << endl;
-            in4 = make_shared<GFFList>();
-            typeFilter(*in3, typeInc, typeExc, *in4);            
+        if (!issues.empty()) {
+            cout << "Skipped " << issues.total() << " input records" << endl;
+            issues.report(cout);
         }
-        else {
-            in4 = in3;
-        }*/
-        
-        cout << "Writing filtered GFF to disk" << endl;        
-        in2->save(outputFile);
         
         cout << "Completed" << endl;
                 
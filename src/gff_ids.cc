@@ -42,11 +42,13 @@ namespace bfs = boost::filesystem;
 
 #include "gff.hpp"
 using gts::gff::GFF;
+using gts::gff::GFFArena;
+using gts::gff::GFFPtr;
 using gts::gff::GFF3;
 using gts::gff::GFFErrorInfo;
 using gts::gff::GFFException;
 
-typedef std::vector<shared_ptr<GFF> > GFFList;
+typedef std::vector<GFFPtr> GFFList;
 
 
 string helpHeader() {
@@ -64,7 +66,7 @@ void output(string& outputFile, GFFList& mRNAs) {
     
     std::ofstream file(outputFile.c_str());
         
-    BOOST_FOREACH(shared_ptr<GFF> gff, mRNAs) {
+    BOOST_FOREACH(GFFPtr gff, mRNAs) {
         bool done = false;
         
         string id = gff->GetId();
@@ -96,6 +98,7 @@ int main(int argc, char *argv[]) {
         // Portculis args
         string inputFile;
         string outputFile;
+        uint16_t threads;
         
         bool version;
         bool help;
@@ -107,6 +110,8 @@ int main(int argc, char *argv[]) {
                     "The input GFF file to extract IDs from")
                 ("output,o", po::value<string>(&outputFile),
                     "The tab separated output file which will contain IDs")
+                ("threads", po::value<uint16_t>(&threads)->default_value(1),
+                    "The number of threads to use when parsing the input")
                 ("version", po::bool_switch(&version)->default_value(false), "Print version string")
                 ("help", po::bool_switch(&help)->default_value(false), "Produce help message")
                 ;
@@ -144,8 +149,9 @@ int main(int argc, char *argv[]) {
         cout << endl << "Extracting mRNA IDs and associated parent gene IDs from GFF file" << endl << endl;
         
         cout << "Loading mRNA entries from GFF file" << endl;
-        vector<shared_ptr<GFF> > gffs;
-        GFF::load(GFF3, inputFile, gffs, gts::gff::MRNA);
+        GFFArena arena;
+        vector<GFFPtr> gffs;
+        GFF::load(GFF3, inputFile, gffs, arena, gts::gff::MRNA, threads);
         
         cout << "Writing IDs to output" << endl;        
         output(outputFile, gffs);        
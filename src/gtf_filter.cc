@@ -45,6 +45,7 @@ namespace bfs = boost::filesystem;
 
 #include "gff.hpp"
 using gts::gff::GFF;
+using gts::gff::GFFArena;
 using gts::gff::GFFPtr;
 using gts::gff::GFFListPtr;
 using gts::gff::GFF3;
@@ -55,7 +56,7 @@ using gts::gff::GffType;
 using gts::gff::GFFModel;
 using gts::gff::GFFModelPtr;
 
-typedef std::vector<shared_ptr<GFF> > GFFList;
+typedef std::vector<GFFPtr> GFFList;
 
 string helpHeader() {
     return string("\nGTF Filter Help.\n\n") +
@@ -162,6 +163,7 @@ int main(int argc, char *argv[]) {
         double fpkmMax;
         string outputFile;
         string outputTranscriptIds;
+        uint16_t threads;
         
         bool version;
         bool help;
@@ -183,6 +185,8 @@ int main(int argc, char *argv[]) {
                     "The tab separated output file which will contain IDs")
                 ("output_transcript_ids", po::value<string>(&outputTranscriptIds),
                     "The line separated list of transcript ids found in the filtered set")        
+                ("threads", po::value<uint16_t>(&threads)->default_value(1),
+                    "The number of threads to use when parsing the input")
                 ("version", po::bool_switch(&version)->default_value(false), "Print version string")
                 ("help", po::bool_switch(&help)->default_value(false), "Produce help message")
                 ;
@@ -223,8 +227,9 @@ int main(int argc, char *argv[]) {
         }
         
         cout << "Loading gene model" << endl;
+        GFFArena arena;
         GFFListPtr gtfs = make_shared<GFFList>();
-        GFF::load(GTF, inputFile, *gtfs);            
+        GFF::load(GTF, inputFile, *gtfs, arena, gts::gff::ANY, threads);            
 
         GFFListPtr in1 = gtfs;
         GFFListPtr in2;
@@ -47,6 +47,7 @@ namespace bfs = boost::filesystem;
 #include "gff.hpp"
 #include "genbank.hpp"
 #include "fln.hpp"
+#include "cache.hpp"
 #include "filters/transcript_filter.hpp"
 #include "filters/multiple_orf_filter.hpp"
 #include "filters/utr_filter.hpp"
@@ -56,8 +57,10 @@ namespace bfs = boost::filesystem;
 #include "filters/strand_filter.hpp"
 #include "filters/overlap_filter.hpp"
 using gts::gff::GFF;
+using gts::gff::GFFArena;
 using gts::gff::GFFModel;
 using gts::gff::GffType;
+using gts::gff::SharedSet;
 
 const double DEFAULT_CDS_LEN_RATIO = 0.4;
 const double DEFAULT_CDNA_LEN_RATIO = 0.5;
@@ -80,8 +83,16 @@ private:
     FLNDBAnnotList flnDbannots;
     FLNDBAnnotList flnNc;
     
+    // Owns the GTF transcripts indexed in maps
+    GFFArena gtfArena;
     Maps maps;
     
+    // The filter that dropped each transcript, numbered from 1, by the key
+    // the genomic model's arena gave its id, 0 for those that weren't
+    // dropped, and the names of the filters in the order they were run
+    vector<uint8_t> failedFilter;
+    vector<string> filterNames;
+    
     const string genomicGffFile;
     const string transcriptGffFile;
     const string flnDir;
@@ -92,6 +103,10 @@ private:
     bool include;
     uint32_t windowSize;
     bool outputAllStages;
+    uint16_t threads;
+    string cacheDir;
+    bool lenient;
+    bool compact;
     bool verbose;
     
 protected:
@@ -134,27 +149,60 @@ protected:
                     "Could not find full lengther new_coding.txt file at: ") + ncFile));
         }        
         
+        shared_ptr<InputCache> cache;
+        if (!cacheDir.empty()) {
+            cache = boost::make_shared<InputCache>(cacheDir);
+        }
+        
+        // Records we skip are summarised once everything is loaded, rather
+        // than reported one at a time
+        ParseLog issues;
+        ParseLog* log = lenient ? &issues : NULL;
+        
         cout << "Loading Genomic GFF file" << endl;
-        this->genomicGffModel = GFFModel::load(genomicGffFile);
+        this->genomicGffModel = cache ? 
+                cache->loadGFFModel(genomicGffFile, threads, issues, lenient) : 
+                GFFModel::load(genomicGffFile, threads, issues, lenient);
         
         cout << endl <<"Loading GTF file" << endl;
         GFFListPtr gtfs = make_shared<GFFList>();
-        GFF::load(GTF, gtfsFile, *gtfs);
+        if (cache) {
+            cache->loadGTFTranscripts(gtfsFile, *gtfs, gtfArena, threads, log);
+        }
+        else {
+            // Only transcripts are indexed, so don't parse the exon rows
+            GFF::load(GTF, gtfsFile, *gtfs, gtfArena, TRANSCRIPT, threads, log);
+        }
         uint32_t nbGtfTranscripts = 0;
         BOOST_FOREACH(GFFPtr gff, *gtfs) {        
             if (gff->GetType() == TRANSCRIPT) {
-                const string transcriptRootId = gff->GetRootTranscriptId();
-                maps.gtfMap[transcriptRootId] = gff;
+                maps.gtfMap[gff->GetRootTranscriptIdHandle(maps.ids)] = gff;
                 nbGtfTranscripts++;
             }
         }
         cout << " = Indexed " << maps.gtfMap.size() << " distinct GTF transcripts" << endl;
         
         cout << endl << "Loading Full Lengther DB Annot file" << endl;
-        DBAnnot::load(dbAnnotFile, flnDbannots);
+        if (cache) {
+            cache->loadDBAnnots(dbAnnotFile, flnDbannots, threads, log);
+        }
+        else {
+            DBAnnot::load(dbAnnotFile, flnDbannots, threads, log);
+        }
         
         cout << "Loading Full Lengther New Coding file" << endl;
-        DBAnnot::load(ncFile, flnNc);
+        if (cache) {
+            cache->loadDBAnnots(ncFile, flnNc, threads, log);
+        }
+        else {
+            DBAnnot::load(ncFile, flnNc, threads, log);
+        }
+        
+        if (!issues.empty()) {
+            cout << endl << "Skipped " << issues.total() << " input records" << endl;
+            issues.report(cout);
+            cout << endl;
+        }
 
     }
     
@@ -170,7 +218,7 @@ protected:
         BOOST_FOREACH(shared_ptr<DBAnnot> db, flnDbannots) {
             
             if (db->GetStatus() == COMPLETE || db->GetStatus() == PUTATIVE_COMPLETE) {
-                maps.uniqFlnCds[db->GetId()] = db;                
+                maps.uniqFlnCds[maps.ids.intern(db->GetId())] = db;                
             }
         }
         
@@ -180,7 +228,7 @@ protected:
         BOOST_FOREACH(shared_ptr<DBAnnot> nc, flnNc) {
             
             if (nc->GetStatus() == CODING || nc->GetStatus() == PUTATIVE_CODING) {
-                maps.uniqFlnNcCds[nc->GetId()] = nc;
+                maps.uniqFlnNcCds[maps.ids.intern(nc->GetId())] = nc;
             }            
         }
         
@@ -198,7 +246,7 @@ protected:
         const size_t nbGenes = genes.getNbGenes();
         const size_t nbTranscripts = genes.getTotalNbTranscripts();
         
-        GFFModelPtr newGeneModel = make_shared<GFFModel>();
+        GFFModelPtr newGeneModel = make_shared<GFFModel>(genes.getArena());
         
         if (nbGenes < nbTranscripts) {
             cout << " - Gene count and transcript count are already different.  Skipping step" << endl;
@@ -220,12 +268,13 @@ protected:
             // Change gene name to whatever was found in the GTF file
             BOOST_FOREACH(GFFPtr thisGene, *genes.getGeneList()) {
                 
-                GFFListPtr transcripts = thisGene->GetChildList();
+                const GFFList& transcripts = thisGene->GetChildList();
                  
-                const string rootId = thisGene->GetRootId();                
+                const uint32_t rootId = thisGene->GetRootIdHandle(maps.ids);
+                GFFPtr gtf = maps.gtfMap[rootId];
                 
-                string gtfGeneId = maps.gtfMap[rootId]->GetGeneId();
-                string gtfTranscriptId = maps.gtfMap[rootId]->GetTranscriptId();
+                string gtfGeneId = gtf->GetGeneId();
+                string gtfTranscriptId = gtf->GetTranscriptId();
                 
                 // Check to see if this gene cane be merged with the last one
                 if (newGeneMap.count(gtfGeneId)) {
@@ -241,7 +290,7 @@ protected:
                     }
                     
                     // Move transcripts across to last Gene
-                    BOOST_FOREACH(GFFPtr transcript, *transcripts) {
+                    BOOST_FOREACH(GFFPtr transcript, transcripts) {
 
                         // Update this transcript's parent gene id.
                         transcript->SetParentId(gtfGeneId);
@@ -268,7 +317,7 @@ protected:
                     
                     if (gtfGeneId.empty()) {
                         BOOST_THROW_EXCEPTION(GTSException() << GTSErrorInfo(string(
-                            "Could not find transcript assembly id in GTF file: ") + rootId));
+                            "Could not find transcript assembly id in GTF file: ") + maps.ids.resolve(rootId)));
                     }
                     
                     // Set the new gene id
@@ -277,7 +326,7 @@ protected:
                     newGeneMap[gtfGeneId] = thisGene;
                     
                     // Update the transcripts' parent gene id.
-                    BOOST_FOREACH(GFFPtr transcript, *transcripts) {
+                    BOOST_FOREACH(GFFPtr transcript, transcripts) {
                         transcript->SetParentId(gtfGeneId);
                         transcript->SetAlias(gtfTranscriptId);
                         fixCDSIds(transcript);
@@ -299,7 +348,7 @@ protected:
         BOOST_FOREACH(GFFPtr g, *(newGeneModel->getGeneList())) {
             g->SetName(g->GetId());
             
-            BOOST_FOREACH(GFFPtr t, *(g->GetChildList())) {
+            BOOST_FOREACH(GFFPtr t, g->GetChildList()) {
                 
                 t->SetName(t->GetId());
                 t->SetParentId(g->GetId());
@@ -344,6 +393,14 @@ protected:
         cout << " = Gene model contains " << this->genomicGffModelFixed->getNbGenes() 
                 << " genes and " << this->genomicGffModelFixed->getTotalNbTranscripts() 
                 << " transcripts" << endl << endl;
+        
+        // Only once ids are final, as compacted features follow their
+        // transcript's id
+        if (compact) {
+            cout << "Compacting genomic gene model" << endl;
+            this->genomicGffModelFixed->compact();
+            cout << " = Front-coded ids take " << IdStore::global().GetBytes() / 1024 << "KB" << endl << endl;
+        }
     }
     
     void filter(std::vector< shared_ptr<GFFModel> >& stages) {
@@ -367,7 +424,7 @@ protected:
         
         for(int i = 0; i < filters.size(); i++) {
             
-            stages.push_back(make_shared<GFFModel>());
+            stages.push_back(make_shared<GFFModel>(stages[i]->getArena()));
             shared_ptr<GFFModel> in = stages[i];
             shared_ptr<GFFModel> out = stages[i+1];
             
@@ -378,6 +435,8 @@ protected:
                     
             // Do the filtering for this stage
             filters[i]->filter(*in, maps, *out);            
+            markFailed(filters[i]->getExcluded(), i + 1);
+            filterNames.push_back(filters[i]->getName());
         
             // Record how many entries have been filtered
             size_t geneDiff = in->getNbGenes() - out->getNbGenes();
@@ -396,7 +455,7 @@ protected:
                 std::stringstream ss;
                 ss << outputPrefix << ".stage." << (i+1) << ".gff3";
                 const string stageOut = ss.str();
-                out->save(stageOut, true, string("gts"));
+                out->save(stageOut, true, string("gts"), threads);
             }
             
             cout << "--------------------------------------" << endl << endl;
@@ -404,7 +463,66 @@ protected:
     }
     
     
-    void output(GFFModel& goodGeneModel) {        
+    /**
+     * Records that filter number filter dropped each of transcripts, so only
+     * the transcripts dropped are visited rather than every one left
+     */
+    void markFailed(const GFFList& transcripts, uint8_t filter) {
+        
+        GFFArena& arena = *genomicGffModel->getArena();
+        
+        BOOST_FOREACH(GFFPtr transcript, transcripts) {
+            
+            const uint32_t key = arena.keyOf(transcript);
+            
+            if (key >= failedFilter.size()) {
+                failedFilter.resize(std::max<size_t>(key + 1, failedFilter.size() * 2), 0);
+            }
+            
+            failedFilter[key] = filter;
+        }
+    }
+    
+    /**
+     * How many filters transcript got through, all of them unless one
+     * dropped it
+     */
+    uint8_t getFiltersPassed(GFFPtr transcript) {
+        
+        const uint32_t key = genomicGffModel->getArena()->keyOf(transcript);
+        const uint8_t failed = key < failedFilter.size() ? failedFilter[key] : 0;
+        return failed ? failed - 1 : filterNames.size();
+    }
+    
+    /**
+     * Writes gene, followed by just the given transcripts of it
+     */
+    void writeGene(TextWriter& out, GFFPtr gene, const GFFList& transcripts, SharedSet& written) {
+        
+        gene->write(out, "gts", false);
+        
+        BOOST_FOREACH(GFFPtr transcript, transcripts) {
+            
+            if (transcript->IsShared() && !written.insert(transcript).second) {
+                continue;
+            }
+            
+            transcript->write(out, "gts", true, false, written);
+        }
+        
+        // Write a gap between the genes
+        out.put('\n');
+    }
+    
+    /**
+     * Splits the model given to the first filter into the pass and fail
+     * files in one sorted walk.  Filters only drop genes and transcripts,
+     * so every record either file needs is in this model, and filter()
+     * marked each transcript with how many filters it passed.  Each failed
+     * transcript gets a comment naming the filter that rejected it, written
+     * just before its gene.
+     */
+    void output(GFFModel& geneModel) {        
         
         auto_cpu_timer timer(1, "Total writing time: %ws\n\n");
         
@@ -412,12 +530,15 @@ protected:
         std::stringstream ssp;
         ssp << outputPrefix << ".pass.gff3";
         const string passOut = ssp.str(); 
+        std::ofstream pass(passOut.c_str());
+        TextWriter passWriter(pass);
         
-        // Save passed output
+        // Save failed output
         std::stringstream ssf;
         ssf << outputPrefix << ".fail.gff3";
         const string failOut = ssf.str();        
         std::ofstream fail(failOut.c_str());
+        TextWriter failWriter(fail);
         
         cout << "--------------------------------------" << endl << endl
              << "Saving final output" << endl
@@ -425,56 +546,65 @@ protected:
              << "Re-processing: " << genomicGffFile << endl
              << "Splitting file based on transcripts that passed all the filters" << endl << endl;
         
-        // Output passed results
-        goodGeneModel.save(passOut, true, "gts");
-                
+        geneModel.sort();
+        
+        uint32_t passGeneCount = 0;
+        uint32_t passTranscriptCount = 0;
         uint32_t failGeneCount = 0;
         uint32_t failTranscriptCount = 0;
         
-        // Output failed results
-        BOOST_FOREACH(shared_ptr<GFF> gene, *(genomicGffModel->getGeneList())) {
-            
-            string id = gene->GetId();
+        SharedSet passWritten;
+        SharedSet failWritten;
+        
+        GFFList passedTranscripts;
+        GFFList failedTranscripts;
+        
+        BOOST_FOREACH(GFFPtr gene, *(geneModel.getGeneList())) {
             
-            if (goodGeneModel.containsGene(id)) {
-               
-                GFFList failedTranscripts;
-                
-                BOOST_FOREACH(shared_ptr<GFF> transcript, *(gene->GetChildList())) {
+            passedTranscripts.clear();
+            failedTranscripts.clear();
+
+            BOOST_FOREACH(GFFPtr transcript, gene->GetChildList()) {
+
+                const uint8_t passed = getFiltersPassed(transcript);
+
+                if (passed < filterNames.size()) {
                     
-                    if (!goodGeneModel.containsTranscript(transcript->GetId())) {
-                        failedTranscripts.push_back(transcript);
-                    }
-                }
-                
-                if (!failedTranscripts.empty()) {
+                    failedTranscripts.push_back(transcript);
                     
-                    // Write out just the gene contents
-                    gene->write(fail, "gts", false);
-                    failGeneCount++;
-                
-                    // Now only write out the failed transcripts
-                    BOOST_FOREACH(shared_ptr<GFF> failedTranscript, failedTranscripts) {
-                        failedTranscript->write(fail, "gts", true);
-                        failTranscriptCount++;
-                    }
-                }                
+                    failWriter.put("# ");
+                    failWriter.put(transcript->GetId());
+                    failWriter.put(" failed filter ");
+                    failWriter.putInt(passed + 1);
+                    failWriter.put(": ");
+                    failWriter.put(filterNames[passed]);
+                    failWriter.put('\n');
+                }
+                else {
+                    passedTranscripts.push_back(transcript);
+                }
             }
-            else {
-                // The gene wasn't in the passed gene model, so just write out the complete gene and child entries
-                gene->write(fail, "gts", true);
-                failGeneCount++;
-                failTranscriptCount += gene->GetChildList()->size();
+            
+            if (!passedTranscripts.empty()) {
+                writeGene(passWriter, gene, passedTranscripts, passWritten);
+                passGeneCount++;
+                passTranscriptCount += passedTranscripts.size();
             }
             
-            // Write a gap between the genes
-            fail << endl;            
+            if (!failedTranscripts.empty()) {
+                writeGene(failWriter, gene, failedTranscripts, failWritten);
+                failGeneCount++;
+                failTranscriptCount += failedTranscripts.size();
+            }
         }
         
+        passWriter.flush();
+        pass.close();
+        failWriter.flush();
         fail.close();
         
-        cout << "Processed " << genomicGffModel->getNbGenes() << " genes and " << genomicGffModel->getTotalNbTranscripts() << " transcripts" << endl
-             << "Sent " << goodGeneModel.getNbGenes() << " genes and " << goodGeneModel.getTotalNbTranscripts() << " transcripts to " << passOut << endl
+        cout << "Processed " << geneModel.getNbGenes() << " genes and " << geneModel.getTotalNbTranscripts() << " transcripts" << endl
+             << "Sent " << passGeneCount << " genes and " << passTranscriptCount << " transcripts to " << passOut << endl
              << "Sent " << failGeneCount << " genes and " << failTranscriptCount << " transcripts to " << failOut << endl << endl
              << "NOTE: the sum of passed and failed gene counts may exceed the number of processed genes due to multi-transcript genes." << endl << endl;
     }
@@ -485,7 +615,7 @@ public :
         genomicGffFile(genomicGffFile), flnDir(flnDir),
                 outputPrefix("gts_out"), gtfsFile(""), 
                 cdsLenRatio(DEFAULT_CDS_LEN_RATIO),
-                include(false), windowSize(DEFAULT_WINDOW_SIZE), outputAllStages(false), verbose(false)
+                include(false), windowSize(DEFAULT_WINDOW_SIZE), outputAllStages(false), threads(1), lenient(false), compact(false), verbose(false)
     {
         genomicGffModel = make_shared<GFFModel>();
     }
@@ -552,6 +682,46 @@ public :
         this->outputAllStages = outputAllStages;
     }
 
+    uint16_t getThreads() const
+    {
+        return threads;
+    }
+
+    void setThreads(uint16_t threads)
+    {
+        this->threads = threads;
+    }
+
+    string getCacheDir() const
+    {
+        return cacheDir;
+    }
+
+    void setCacheDir(string cacheDir)
+    {
+        this->cacheDir = cacheDir;
+    }
+
+    bool isLenient() const
+    {
+        return lenient;
+    }
+
+    void setLenient(bool lenient)
+    {
+        this->lenient = lenient;
+    }
+
+    bool isCompact() const
+    {
+        return compact;
+    }
+
+    void setCompact(bool compact)
+    {
+        this->compact = compact;
+    }
+
     bool isVerbose() const
     {
         return verbose;
@@ -584,7 +754,7 @@ public :
         filter(stages);
         
         // Output consolidated GFFs
-        output(*(stages[stages.size() - 1]));
+        output(*(stages[0]));
         
         cout << "--------------------------------------" << endl << endl;  
     }
@@ -617,6 +787,10 @@ int main(int argc, char *argv[]) {
         uint32_t windowSize;
         double cdsLenRatio;
         bool outputAllStages;
+        uint16_t threads;
+        string cacheDir;
+        bool lenient;
+        bool compact;
                 
         string cufflinksGtfFile;
         
@@ -643,6 +817,14 @@ int main(int argc, char *argv[]) {
                     "Ratio of CDS length to cDNA length.  0.0 -> 1.0")
                 ("all,a", po::bool_switch(&outputAllStages)->default_value(false), 
                     "Whether or not to output GFF entries filtered at each stage.")
+                ("threads", po::value<uint16_t>(&threads)->default_value(1), 
+                    "The number of threads to use when parsing input files and writing output files.")
+                ("cache", po::value<string>(&cacheDir),
+                    "Directory in which to cache parsed input files.  Reruns on the same inputs load from the cache instead of reparsing.")
+                ("lenient", po::bool_switch(&lenient)->default_value(false),
+                    "Skip malformed input records, and records that can't be linked to their parents, instead of stopping.  A summary of what was skipped is output once loading completes.")
+                ("compact", po::bool_switch(&compact)->default_value(false),
+                    "Hold the genomic gene model's exon, CDS and UTR records in a compact form, with their IDs front-coded, to save memory on large annotations.  Output is unchanged.")
                 ("version", po::bool_switch(&version)->default_value(false), "Print version string")
                 ("help", po::bool_switch(&help)->default_value(false), "Produce help message")
                 ;
@@ -684,6 +866,10 @@ int main(int argc, char *argv[]) {
         gts.setInclude(include);
         gts.setWindowSize(windowSize);
         gts.setOutputAllStages(outputAllStages);
+        gts.setThreads(threads);
+        gts.setCacheDir(cacheDir);
+        gts.setLenient(lenient);
+        gts.setCompact(compact);
         gts.setVerbose(verbose);
         
         gts.execute();        
@@ -0,0 +1,184 @@
+//  ********************************************************************
+//  This file is part of GTS (Good Transcript Selector).
+//
+//  GTS is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Portculis is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with GTS.  If not, see <http://www.gnu.org/licenses/>.
+//  *******************************************************************
+
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+using std::cout;
+using std::endl;
+using std::ofstream;
+using std::string;
+using std::vector;
+
+#include <boost/foreach.hpp>
+#include <boost/timer/timer.hpp>
+#include <boost/unordered_set.hpp>
+using boost::timer::auto_cpu_timer;
+using boost::unordered_set;
+
+#include "io/text_writer.hpp"
+#include "gff.hpp"
+using gts::io::TextWriter;
+using gts::gff::GFF;
+using gts::gff::GFFArena;
+using gts::gff::GFFList;
+using gts::gff::GFFModel;
+using gts::gff::GFFPtr;
+using gts::gff::SharedSet;
+
+namespace gts {
+
+/**
+ * Copies every gene in input to output, leaving out the listed transcripts,
+ * and any gene left without transcripts.  output must share input's arena so
+ * the genes can still be written as they were read.
+ */
+inline void filterIds(GFFModel& input, const unordered_set<string>& transcriptSet, GFFModel& output) {
+
+    auto_cpu_timer timer(1, " = Wall time taken: %ws\n\n");
+
+    // Each listed id is looked up once, then transcripts are checked by key
+    GFFArena& arena = *input.getArena();
+    vector<bool> excluded;
+
+    BOOST_FOREACH(const string& id, transcriptSet) {
+
+        const uint32_t key = arena.findKey(id);
+
+        if (key != StringPool::NONE) {
+
+            if (key >= excluded.size()) {
+                excluded.resize(key + 1);
+            }
+            excluded[key] = true;
+        }
+    }
+
+    BOOST_FOREACH(GFFPtr gene, *input.getGeneList()) {
+
+        GFFList goodTranscripts;
+
+        BOOST_FOREACH(GFFPtr transcript, gene->GetChildList()) {
+
+            const uint32_t key = arena.keyOf(transcript);
+
+            if (key < excluded.size() && excluded[key]) {
+                // Do nothing
+            }
+            else {
+                goodTranscripts.push_back(transcript);
+            }
+        }
+
+        // We only want genes with 1 or more good transcript
+        if (goodTranscripts.size() >= 1) {
+
+            // Copy gene without child info
+            GFFPtr newGene = output.getArena()->copy(*gene);
+
+            BOOST_FOREACH(GFFPtr goodTranscript, goodTranscripts) {
+                newGene->addChild(goodTranscript);
+            }
+
+            output.addGene(newGene);
+        }
+    }
+    cout << " - Keeping " << output.getNbGenes() << " out of " << input.getNbGenes() << " genes" << endl;
+    cout << " - Keeping " << output.getTotalNbTranscripts() << " out of " << input.getTotalNbTranscripts() << " transcripts" << endl;
+}
+
+/**
+ * Filters each gene as it is streamed in from the input and writes anything
+ * left straight to the output, so only one gene is ever held in memory.  The
+ * output is the same as filterIds followed by GFFModel::save.
+ */
+class StreamingIdFilter {
+
+private:
+
+    const unordered_set<string>& transcriptSet;
+    ofstream out;
+    TextWriter writer;
+    string source;
+
+public:
+
+    uint32_t nbGenesIn;
+    uint32_t nbGenesOut;
+    uint32_t nbTranscriptsIn;
+    uint32_t nbTranscriptsOut;
+
+    StreamingIdFilter(const unordered_set<string>& transcriptSet, const string& outputFile) :
+        transcriptSet(transcriptSet),
+        out(outputFile.c_str()),
+        writer(out),
+        nbGenesIn(0), nbGenesOut(0), nbTranscriptsIn(0), nbTranscriptsOut(0) {
+    }
+
+    void operator()(GFFPtr gene) {
+
+        nbGenesIn++;
+        nbTranscriptsIn += gene->GetNbChildren();
+
+        GFFList goodTranscripts;
+
+        BOOST_FOREACH(GFFPtr transcript, gene->GetChildList()) {
+            if (transcriptSet.count(transcript->GetId()) == 0) {
+                goodTranscripts.push_back(transcript);
+            }
+        }
+
+        // We only want genes with 1 or more good transcript
+        if (goodTranscripts.empty()) {
+            return;
+        }
+
+        // Like GFFModel::save, use the first gene's source throughout
+        if (source.empty()) {
+            source = gene->GetSource();
+        }
+
+        // The gene is written from the arena it was read into, rather than
+        // copied, so its line is written as it was read.  The transcripts
+        // are put in the order GFF::write would sort them into.
+        std::sort(goodTranscripts.begin(), goodTranscripts.end(), GFF::GFFOrdering());
+
+        gene->write(writer, source, false);
+
+        SharedSet written;
+        BOOST_FOREACH(GFFPtr transcript, goodTranscripts) {
+
+            if (transcript->IsShared() && !written.insert(transcript).second) {
+                continue;
+            }
+
+            transcript->write(writer, source, true, true, written);
+        }
+
+        // Separate genes with an extra line
+        writer.put('\n');
+
+        nbGenesOut++;
+        nbTranscriptsOut += goodTranscripts.size();
+    }
+};
+
+}
@@ -0,0 +1,223 @@
+//  ********************************************************************
+//  This file is part of GTS (Good Transcript Selector).
+//
+//  GTS is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Portculis is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with GTS.  If not, see <http://www.gnu.org/licenses/>.
+//  *******************************************************************
+
+#pragma once
+
+#include <string.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+#include <boost/exception/all.hpp>
+#include <boost/filesystem.hpp>
+
+#include "mapped_file.hpp"
+
+namespace gts {
+namespace io {
+
+/**
+ * Accumulates binary data in memory, to be written to disk in one go.  Values
+ * are stored in native byte order, so the output is only meant to be read back
+ * on the same kind of machine, e.g. for caches.  Lengths and counts are
+ * written as LEB128 varints as they are nearly always small.
+ */
+class BinaryWriter {
+
+private:
+
+    vector<char> buffer;
+
+public:
+
+    BinaryWriter() {
+        buffer.reserve(1 << 20);
+    }
+
+    template<class T>
+    void put(T value) {
+        const char* p = reinterpret_cast<const char*>(&value);
+        buffer.insert(buffer.end(), p, p + sizeof(T));
+    }
+
+    void putVarint(uint64_t value) {
+
+        while (value >= 0x80) {
+            buffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+
+        buffer.push_back(static_cast<char>(value));
+    }
+
+    void putString(const string& s) {
+        putVarint(s.size());
+        buffer.insert(buffer.end(), s.begin(), s.end());
+    }
+
+    void putBytes(const char* data, size_t size) {
+        buffer.insert(buffer.end(), data, data + size);
+    }
+
+    size_t GetSize() const {
+        return buffer.size();
+    }
+
+    /**
+     * Writes everything to path.  The data goes to a temporary file of its
+     * own in the same directory, which is then renamed over path, so readers
+     * never see a partially written file and two runs writing the same path
+     * at once can't mix their data.  The temporary file is removed if
+     * anything goes wrong.
+     */
+    void save(const string& path) const {
+
+        const boost::filesystem::path target(path);
+        const boost::filesystem::path tmpPath = target.parent_path() /
+                boost::filesystem::unique_path(target.filename().string() + ".%%%%-%%%%-%%%%.tmp");
+
+        boost::system::error_code ignored;
+
+        {
+            std::ofstream file(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+
+            if (!buffer.empty()) {
+                file.write(&buffer[0], buffer.size());
+            }
+
+            file.close();
+
+            if (file.fail()) {
+                boost::filesystem::remove(tmpPath, ignored);
+                BOOST_THROW_EXCEPTION(IOException() << IOErrorInfo(string(
+                    "Could not write file: ") + tmpPath.string()));
+            }
+        }
+
+        try {
+            boost::filesystem::rename(tmpPath, target);
+        }
+        catch(boost::filesystem::filesystem_error& e) {
+            boost::filesystem::remove(tmpPath, ignored);
+            throw;
+        }
+    }
+};
+
+/**
+ * Reads back data produced by a BinaryWriter from memory, such as a
+ * MappedFile.  Running off the end of the data throws an IOException rather
+ * than reading garbage.
+ */
+class BinaryReader {
+
+private:
+
+    const char* p;
+    const char* end;
+
+public:
+
+    BinaryReader() : p(NULL), end(NULL) {}
+
+    BinaryReader(const char* begin, const char* end) : p(begin), end(end) {}
+
+    template<class T>
+    T get() {
+        require(sizeof(T));
+        T value;
+        memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        return value;
+    }
+
+    uint64_t getVarint() {
+
+        uint64_t value = 0;
+
+        for(uint32_t shift = 0; shift < 64; shift += 7) {
+
+            require(1);
+            const unsigned char b = static_cast<unsigned char>(*p++);
+            value |= static_cast<uint64_t>(b & 0x7f) << shift;
+
+            if (!(b & 0x80)) {
+                return value;
+            }
+        }
+
+        BOOST_THROW_EXCEPTION(IOException() << IOErrorInfo(string(
+            "Corrupt varint in binary data")));
+    }
+
+    string getString() {
+        const size_t size = getVarint();
+        require(size);
+        const char* s = p;
+        p += size;
+        return string(s, size);
+    }
+
+    void getString(string& s) {
+        const size_t size = getVarint();
+        require(size);
+        s.assign(p, size);
+        p += size;
+    }
+
+    /**
+     * Like getString, but returns the location of the characters in the
+     * underlying data rather than copying them
+     */
+    void getRange(const char*& begin, const char*& end) {
+        const size_t size = getVarint();
+        require(size);
+        begin = p;
+        end = p + size;
+        p += size;
+    }
+
+    /**
+     * Consumes size bytes, returning true if they are identical to data
+     */
+    bool matchBytes(const char* data, size_t size) {
+        require(size);
+        const bool same = memcmp(p, data, size) == 0;
+        p += size;
+        return same;
+    }
+
+    bool atEnd() const {
+        return p == end;
+    }
+
+private:
+
+    void require(size_t size) const {
+
+        if (static_cast<size_t>(end - p) < size) {
+            BOOST_THROW_EXCEPTION(IOException() << IOErrorInfo(string(
+                "Unexpected end of binary data")));
+        }
+    }
+};
+
+}
+}
@@ -0,0 +1,103 @@
+//  ********************************************************************
+//  This file is part of GTS (Good Transcript Selector).
+//
+//  GTS is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Portculis is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with GTS.  If not, see <http://www.gnu.org/licenses/>.
+//  *******************************************************************
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "mapped_file.hpp"
+#include "gzip.hpp"
+
+namespace gts {
+namespace io {
+
+/**
+ * The full contents of an input file held in memory.  Plain files are memory
+ * mapped, gzip files are inflated into a heap buffer and BGZF files have
+ * their blocks inflated in parallel.  Either way callers just see one
+ * contiguous run of bytes.  Only mapped files are paged in as they're read,
+ * compressed files take the whole inflated size of the heap up front.
+ */
+class FileBuffer : boost::noncopyable {
+
+private:
+
+    MappedFile mapped;
+    vector<char> inflated;
+    bool compressed;
+
+public:
+
+    FileBuffer(const string& path) : mapped(path), compressed(false) {
+        init(1);
+    }
+
+    FileBuffer(const string& path, uint16_t threads) : mapped(path), compressed(false) {
+        init(threads);
+    }
+
+    virtual ~FileBuffer() {}
+
+    const char* begin() const {
+        return compressed ? (inflated.empty() ? NULL : &inflated[0]) : mapped.begin();
+    }
+
+    const char* end() const {
+        return compressed ? begin() + inflated.size() : mapped.end();
+    }
+
+    size_t GetSize() const {
+        return end() - begin();
+    }
+
+    bool IsCompressed() const {
+        return compressed;
+    }
+
+private:
+
+    void init(uint16_t threads) {
+
+        const char* data = mapped.begin();
+        const size_t size = mapped.GetSize();
+
+        if (isBgzf(data, size)) {
+            cout << " - Decompressing BGZF input using " << threads << " thread(s)" << endl;
+            inflateBgzf(data, size, inflated, threads);
+            compressed = true;
+        }
+        else if (isGzip(data, size)) {
+            cout << " - Decompressing gzip input" << endl;
+            inflateGzip(data, size, inflated);
+            compressed = true;
+        }
+    }
+};
+
+typedef boost::shared_ptr<FileBuffer> FileBufferPtr;
+
+}
+}
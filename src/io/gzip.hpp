@@ -0,0 +1,287 @@
+//  ********************************************************************
+//  This file is part of GTS (Good Transcript Selector).
+//
+//  GTS is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Portculis is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with GTS.  If not, see <http://www.gnu.org/licenses/>.
+//  *******************************************************************
+
+#pragma once
+
+#include <string.h>
+#include <zlib.h>
+
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+#include <boost/bind/bind.hpp>
+#include <boost/exception/all.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "mapped_file.hpp"
+
+namespace gts {
+namespace io {
+
+// Fixed part of a gzip member header: magic, method, flags, mtime, xfl, os
+const size_t GZIP_HEADER_SIZE = 10;
+const uint8_t GZIP_FEXTRA = 0x04;
+
+// A BGZF block header is a gzip header plus a 6 byte 'BC' extra subfield
+const size_t BGZF_MIN_BLOCK_SIZE = 18 + 8;
+
+inline uint16_t readLE16(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return u[0] | (u[1] << 8);
+}
+
+inline uint32_t readLE32(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return u[0] | (u[1] << 8) | (u[2] << 16) | ((uint32_t)u[3] << 24);
+}
+
+/**
+ * Gzip files are recognised by their magic number rather than by extension
+ */
+inline bool isGzip(const char* data, size_t size) {
+    return size >= 2 && (unsigned char)data[0] == 0x1f && (unsigned char)data[1] == 0x8b;
+}
+
+/**
+ * If a BGZF block starts at data, returns the total size of the compressed
+ * block, otherwise returns 0.
+ */
+inline size_t bgzfBlockSize(const char* data, size_t size) {
+
+    if (size < BGZF_MIN_BLOCK_SIZE || !isGzip(data, size) ||
+            (unsigned char)data[2] != Z_DEFLATED || !(data[3] & GZIP_FEXTRA)) {
+        return 0;
+    }
+
+    const size_t xlen = readLE16(data + GZIP_HEADER_SIZE);
+    const char* extra = data + GZIP_HEADER_SIZE + 2;
+
+    if (GZIP_HEADER_SIZE + 2 + xlen > size) {
+        return 0;
+    }
+
+    // Walk the extra subfields looking for BC, which holds the block size - 1
+    size_t i = 0;
+    while (i + 4 <= xlen) {
+
+        const size_t slen = readLE16(extra + i + 2);
+
+        if (extra[i] == 'B' && extra[i + 1] == 'C' && slen == 2 && i + 6 <= xlen) {
+            const size_t blockSize = readLE16(extra + i + 4) + 1;
+            return blockSize <= size && blockSize >= GZIP_HEADER_SIZE + 2 + xlen + 8 ? blockSize : 0;
+        }
+
+        i += 4 + slen;
+    }
+
+    return 0;
+}
+
+inline bool isBgzf(const char* data, size_t size) {
+    return bgzfBlockSize(data, size) > 0;
+}
+
+/**
+ * Inflates a regular gzip file, including files made of several concatenated
+ * gzip members, into out.
+ */
+inline void inflateGzip(const char* data, size_t size, vector<char>& out) {
+
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+
+    // 15 + 32 means zlib will expect and strip a gzip header
+    if (inflateInit2(&strm, 15 + 32) != Z_OK) {
+        BOOST_THROW_EXCEPTION(IOException() << IOErrorInfo(string(
+            "Could not initialise zlib")));
+    }
+
+    // Annotation text typically compresses around 8-10 fold
+    out.resize(size < 1024 ? 4096 : size * 4);
+
+    size_t produced = 0;
+    strm.next_in = (Bytef*)data;
+    strm.avail_in = size;
+
+    while (true) {
+
+        if (produced == out.size()) {
+            out.resize(out.size() * 2);
+        }
+
+        strm.next_out = (Bytef*)&out[produced];
+        strm.avail_out = out.size() - produced;
+
+        const int ret = inflate(&strm, Z_NO_FLUSH);
+        produced = out.size() - strm.avail_out;
+
+        if (ret == Z_STREAM_END) {
+
+            // Skip any padding and carry on if another gzip member follows
+            if (strm.avail_in > 0 && isGzip((const char*)strm.next_in, strm.avail_in)) {
+                inflateReset(&strm);
+            }
+            else {
+                break;
+            }
+        }
+        else if (ret != Z_OK && !(ret == Z_BUF_ERROR && strm.avail_out == 0)) {
+            inflateEnd(&strm);
+            BOOST_THROW_EXCEPTION(IOException() << IOErrorInfo(string(
+                "Corrupt or truncated gzip data")));
+        }
+    }
+
+    inflateEnd(&strm);
+    out.resize(produced);
+}
+
+struct BgzfBlock {
+    const char* data;       // Start of the compressed block
+    size_t size;            // Size of the whole compressed block
+    size_t offset;          // Where the inflated block goes in the output
+    uint32_t inflatedSize;
+};
+
+/**
+ * Inflates a single BGZF block straight into its final position in out
+ */
+inline void inflateBgzfBlock(const BgzfBlock& block, char* out) {
+
+    const size_t xlen = readLE16(block.data + GZIP_HEADER_SIZE);
+    const char* cdata = block.data + GZIP_HEADER_SIZE + 2 + xlen;
+    const size_t cdataSize = block.size - (GZIP_HEADER_SIZE + 2 + xlen) - 8;
+
+    if (block.inflatedSize > 0) {
+
+        z_stream strm;
+        memset(&strm, 0, sizeof(strm));
+
+        // Negative window bits means raw deflate data, i.e. no header
+        if (inflateInit2(&strm, -15) != Z_OK) {
+            BOOST_THROW_EXCEPTION(IOException() << IOErrorInfo(string(
+                "Could not initialise zlib")));
+        }
+
+        strm.next_in = (Bytef*)cdata;
+        strm.avail_in = cdataSize;
+        strm.next_out = (Bytef*)out;
+        strm.avail_out = block.inflatedSize;
+
+        const int ret = inflate(&strm, Z_FINISH);
+        inflateEnd(&strm);
+
+        if (ret != Z_STREAM_END || strm.avail_out != 0) {
+            BOOST_THROW_EXCEPTION(IOException() << IOErrorInfo(string(
+                "Corrupt BGZF block")));
+        }
+    }
+
+    const uint32_t crc = crc32(crc32(0L, Z_NULL, 0), (const Bytef*)out, block.inflatedSize);
+
+    if (crc != readLE32(block.data + block.size - 8)) {
+        BOOST_THROW_EXCEPTION(IOException() << IOErrorInfo(string(
+            "CRC mismatch in BGZF block")));
+    }
+}
+
+inline void inflateBgzfBlocks(const BgzfBlock* blocks, size_t nbBlocks, char* out, boost::exception_ptr& error) {
+
+    try {
+        for(size_t i = 0; i < nbBlocks; i++) {
+            inflateBgzfBlock(blocks[i], out + blocks[i].offset);
+        }
+    }
+    catch(...) {
+        error = boost::current_exception();
+    }
+}
+
+/**
+ * Inflates a BGZF file into out.  BGZF blocks are independent gzip members
+ * which record both their compressed and inflated sizes, so we can index all
+ * the blocks up front, size the output exactly, and then have each thread
+ * inflate a contiguous run of blocks directly into place.
+ */
+inline void inflateBgzf(const char* data, size_t size, vector<char>& out, uint16_t threads) {
+
+    vector<BgzfBlock> blocks;
+    size_t total = 0;
+    size_t pos = 0;
+
+    while (pos < size) {
+
+        const size_t blockSize = bgzfBlockSize(data + pos, size - pos);
+
+        if (blockSize == 0) {
+            BOOST_THROW_EXCEPTION(IOException() << IOErrorInfo(string(
+                "Corrupt or truncated BGZF data")));
+        }
+
+        BgzfBlock block;
+        block.data = data + pos;
+        block.size = blockSize;
+        block.offset = total;
+        block.inflatedSize = readLE32(data + pos + blockSize - 4);
+        blocks.push_back(block);
+
+        total += block.inflatedSize;
+        pos += blockSize;
+    }
+
+    out.resize(total);
+    char* base = out.empty() ? NULL : &out[0];
+
+    const size_t nbWorkers = std::max<size_t>(1, std::min<size_t>(threads, blocks.size()));
+
+    if (nbWorkers == 1) {
+        for(size_t i = 0; i < blocks.size(); i++) {
+            inflateBgzfBlock(blocks[i], base + blocks[i].offset);
+        }
+        return;
+    }
+
+    vector<boost::exception_ptr> errors(nbWorkers);
+    boost::thread_group workers;
+
+    const size_t perWorker = (blocks.size() + nbWorkers - 1) / nbWorkers;
+
+    for(size_t i = 0; i < nbWorkers; i++) {
+
+        const size_t first = i * perWorker;
+        const size_t last = std::min(blocks.size(), first + perWorker);
+
+        if (first < last) {
+            workers.create_thread(boost::bind(&inflateBgzfBlocks,
+                    &blocks[first], last - first, base, boost::ref(errors[i])));
+        }
+    }
+
+    workers.join_all();
+
+    for(size_t i = 0; i < nbWorkers; i++) {
+        if (errors[i]) {
+            boost::rethrow_exception(errors[i]);
+        }
+    }
+}
+
+}
+}
@@ -0,0 +1,121 @@
+//  ********************************************************************
+//  This file is part of GTS (Good Transcript Selector).
+//
+//  GTS is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Portculis is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with GTS.  If not, see <http://www.gnu.org/licenses/>.
+//  *******************************************************************
+
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+using std::string;
+
+#include <boost/exception/all.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+using boost::shared_ptr;
+
+namespace gts {
+namespace io {
+
+typedef boost::error_info<struct IOError,string> IOErrorInfo;
+struct IOException: virtual boost::exception, virtual std::exception { };
+
+/**
+ * Read-only memory mapping of an entire file.  The mapping is released when
+ * this object is destroyed, so any views into the data must not outlive it.
+ */
+class MappedFile : boost::noncopyable {
+
+private:
+
+    string path;
+    int fd;
+    char* data;
+    size_t size;
+
+public:
+
+    MappedFile(const string& path) : path(path), fd(-1), data(NULL), size(0) {
+
+        fd = ::open(path.c_str(), O_RDONLY);
+
+        if (fd == -1) {
+            BOOST_THROW_EXCEPTION(IOException() << IOErrorInfo(string(
+                "Could not open file: ") + path));
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) == -1) {
+            ::close(fd);
+            BOOST_THROW_EXCEPTION(IOException() << IOErrorInfo(string(
+                "Could not stat file: ") + path));
+        }
+
+        size = st.st_size;
+
+        // mmap refuses zero length mappings, so an empty file just has no data
+        if (size > 0) {
+
+            void* addr = ::mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (addr == MAP_FAILED) {
+                ::close(fd);
+                BOOST_THROW_EXCEPTION(IOException() << IOErrorInfo(string(
+                    "Could not memory map file: ") + path));
+            }
+
+            data = static_cast<char*>(addr);
+
+            // We nearly always scan front to back, so let the kernel read ahead aggressively
+            ::madvise(data, size, MADV_SEQUENTIAL);
+        }
+    }
+
+    virtual ~MappedFile() {
+
+        if (data != NULL) {
+            ::munmap(data, size);
+        }
+
+        if (fd != -1) {
+            ::close(fd);
+        }
+    }
+
+    const char* begin() const {
+        return data;
+    }
+
+    const char* end() const {
+        return data + size;
+    }
+
+    size_t GetSize() const {
+        return size;
+    }
+
+    string GetPath() const {
+        return path;
+    }
+};
+
+typedef boost::shared_ptr<MappedFile> MappedFilePtr;
+
+}
+}
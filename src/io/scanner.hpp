@@ -0,0 +1,277 @@
+//  ********************************************************************
+//  This file is part of GTS (Good Transcript Selector).
+//
+//  GTS is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Portculis is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with GTS.  If not, see <http://www.gnu.org/licenses/>.
+//  *******************************************************************
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+using std::string;
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define GTS_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace gts {
+namespace io {
+
+/**
+ * A small set of delimiter characters to scan for, e.g. "\t" or "\n\t;= "
+ */
+class DelimSet {
+
+public:
+
+    static const size_t MAX_SIZE = 8;
+
+private:
+
+    char chars[MAX_SIZE];
+    size_t n;
+    bool table[256];
+
+public:
+
+    DelimSet(const char* delims) : n(0) {
+
+        memset(table, 0, sizeof(table));
+
+        for(; *delims != '\0' && n < MAX_SIZE; delims++) {
+            chars[n++] = *delims;
+            table[static_cast<uint8_t>(*delims)] = true;
+        }
+    }
+
+    size_t size() const {
+        return n;
+    }
+
+    char operator[](size_t i) const {
+        return chars[i];
+    }
+
+    bool contains(char c) const {
+        return table[static_cast<uint8_t>(c)];
+    }
+};
+
+/**
+ * Writes the positions of, at most, the first max delimiters in [b, e) to out,
+ * in order.  Returns how many were written, so anything less than max means
+ * the whole block was scanned.
+ */
+typedef size_t (*ScanFn)(const char* b, const char* e, const DelimSet& delims, const char** out, size_t max);
+
+enum ScanKernel {
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2
+};
+
+inline string scanKernelToString(ScanKernel kernel) {
+    switch(kernel) {
+        case SCAN_SCALAR:
+            return "scalar";
+        case SCAN_SSE2:
+            return "SSE2";
+        case SCAN_AVX2:
+            return "AVX2";
+    }
+    return "";
+}
+
+inline size_t scanScalar(const char* b, const char* e, const DelimSet& delims, const char** out, size_t max) {
+
+    size_t found = 0;
+
+    for(const char* p = b; p != e && found < max; p++) {
+        if (delims.contains(*p)) {
+            out[found++] = p;
+        }
+    }
+
+    return found;
+}
+
+#ifdef GTS_SCAN_X86
+
+/**
+ * Records the bytes flagged in mask, which covers the block starting at p.
+ * Returns false once max positions have been written.
+ */
+inline bool scanMask(uint32_t mask, const char* p, const char** out, size_t& found, size_t max) {
+
+    while (mask != 0) {
+
+        out[found++] = p + __builtin_ctz(mask);
+
+        if (found == max) {
+            return false;
+        }
+
+        mask &= mask - 1;
+    }
+
+    return true;
+}
+
+__attribute__((target("sse2")))
+inline size_t scanSse2(const char* b, const char* e, const DelimSet& delims, const char** out, size_t max) {
+
+    const size_t n = delims.size();
+
+    if (max == 0 || n == 0) {
+        return 0;
+    }
+
+    __m128i v[DelimSet::MAX_SIZE];
+
+    for(size_t i = 0; i < n; i++) {
+        v[i] = _mm_set1_epi8(delims[i]);
+    }
+
+    const char* p = b;
+    size_t found = 0;
+
+    for(; e - p >= 16; p += 16) {
+
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i m = _mm_cmpeq_epi8(x, v[0]);
+
+        for(size_t i = 1; i < n; i++) {
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(x, v[i]));
+        }
+
+        if (!scanMask(static_cast<uint32_t>(_mm_movemask_epi8(m)), p, out, found, max)) {
+            return found;
+        }
+    }
+
+    return found + scanScalar(p, e, delims, out + found, max - found);
+}
+
+__attribute__((target("avx2")))
+inline size_t scanAvx2(const char* b, const char* e, const DelimSet& delims, const char** out, size_t max) {
+
+    const size_t n = delims.size();
+
+    if (max == 0 || n == 0) {
+        return 0;
+    }
+
+    __m256i v[DelimSet::MAX_SIZE];
+
+    for(size_t i = 0; i < n; i++) {
+        v[i] = _mm256_set1_epi8(delims[i]);
+    }
+
+    const char* p = b;
+    size_t found = 0;
+
+    for(; e - p >= 32; p += 32) {
+
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i m = _mm256_cmpeq_epi8(x, v[0]);
+
+        for(size_t i = 1; i < n; i++) {
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(x, v[i]));
+        }
+
+        if (!scanMask(static_cast<uint32_t>(_mm256_movemask_epi8(m)), p, out, found, max)) {
+            return found;
+        }
+    }
+
+    // Finish the tail 16 bytes at a time before dropping to scalar
+    return found + scanSse2(p, e, delims, out + found, max - found);
+}
+
+#endif
+
+inline bool scanKernelSupported(ScanKernel kernel) {
+
+    switch(kernel) {
+        case SCAN_SCALAR:
+            return true;
+#ifdef GTS_SCAN_X86
+        case SCAN_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case SCAN_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+/**
+ * The kernel implementing the given instruction set.  Falls back to scalar
+ * when the instruction set isn't available on this machine.
+ */
+inline ScanFn scanKernel(ScanKernel kernel) {
+
+    if (!scanKernelSupported(kernel)) {
+        return scanScalar;
+    }
+
+    switch(kernel) {
+#ifdef GTS_SCAN_X86
+        case SCAN_SSE2:
+            return scanSse2;
+        case SCAN_AVX2:
+            return scanAvx2;
+#endif
+        default:
+            return scanScalar;
+    }
+}
+
+/**
+ * The widest instruction set supported by the CPU we're running on
+ */
+inline ScanKernel bestScanKernel() {
+
+    static const ScanKernel best =
+            scanKernelSupported(SCAN_AVX2) ? SCAN_AVX2 :
+            scanKernelSupported(SCAN_SSE2) ? SCAN_SSE2 :
+            SCAN_SCALAR;
+
+    return best;
+}
+
+/**
+ * Scans [b, e) with the best kernel for this CPU.  See ScanFn.
+ */
+inline size_t scan(const char* b, const char* e, const DelimSet& delims, const char** out, size_t max) {
+
+    static const ScanFn fn = scanKernel(bestScanKernel());
+    return fn(b, e, delims, out, max);
+}
+
+/**
+ * Returns the first delimiter in [b, e), or e if there are none
+ */
+inline const char* findFirst(const char* b, const char* e, const DelimSet& delims) {
+
+    const char* pos;
+    return scan(b, e, delims, &pos, 1) == 0 ? e : pos;
+}
+
+}
+}
@@ -0,0 +1,186 @@
+//  ********************************************************************
+//  This file is part of GTS (Good Transcript Selector).
+//
+//  GTS is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Portculis is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with GTS.  If not, see <http://www.gnu.org/licenses/>.
+//  *******************************************************************
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <vector>
+using std::ostream;
+using std::string;
+using std::vector;
+
+#include <boost/noncopyable.hpp>
+
+namespace gts {
+namespace io {
+
+/**
+ * Collects text output in a large buffer, which is handed to the underlying
+ * stream whenever it fills up, and when the writer is flushed or destroyed.
+ * Numbers are formatted straight into the buffer, without going through the
+ * stream or any temporary strings.  Nothing is flushed per line.
+ *
+ * A writer created without a stream keeps everything in its buffer, growing
+ * it as needed, so that text can be formatted on one thread and written out
+ * from another.
+ */
+class TextWriter : boost::noncopyable {
+
+public:
+
+    static const size_t DEFAULT_CAPACITY = 1 << 20;
+
+private:
+
+    ostream* out;
+    vector<char> buffer;
+    size_t used;
+
+public:
+
+    TextWriter() : out(NULL), buffer(4096), used(0) {}
+
+    TextWriter(ostream& out) : out(&out), buffer(DEFAULT_CAPACITY), used(0) {}
+
+    TextWriter(ostream& out, size_t capacity) : out(&out), buffer(std::max<size_t>(capacity, 64)), used(0) {}
+
+    virtual ~TextWriter() {
+        flush();
+    }
+
+    void put(char c) {
+
+        if (used == buffer.size()) {
+            makeRoom(1);
+        }
+
+        buffer[used++] = c;
+    }
+
+    void put(const char* s, size_t size) {
+
+        if (size > buffer.size() - used) {
+
+            if (out && size > buffer.size()) {
+                flush();
+                out->write(s, size);
+                return;
+            }
+
+            makeRoom(size);
+        }
+
+        memcpy(&buffer[used], s, size);
+        used += size;
+    }
+
+    void put(const char* s) {
+        put(s, strlen(s));
+    }
+
+    void put(const string& s) {
+        put(s.data(), s.size());
+    }
+
+    void putInt(int64_t value) {
+
+        char digits[24];
+        char* p = digits + sizeof(digits);
+
+        uint64_t u = value < 0 ? 0 - static_cast<uint64_t>(value) : value;
+
+        do {
+            *--p = '0' + u % 10;
+            u /= 10;
+        } while (u > 0);
+
+        if (value < 0) {
+            *--p = '-';
+        }
+
+        put(p, digits + sizeof(digits) - p);
+    }
+
+    /**
+     * Writes value exactly as lexical_cast<string> does, with 17 significant
+     * digits and no trailing zeros.  Whole numbers, by far the most common
+     * case, are written as integers.
+     */
+    void putDouble(double value) {
+
+        if (value != 0.0 && fabs(value) < 1e15 && value == floor(value)) {
+            putInt(static_cast<int64_t>(value));
+            return;
+        }
+
+        char digits[32];
+        const int size = snprintf(digits, sizeof(digits), "%.17g", value);
+        put(digits, size);
+    }
+
+    /**
+     * Hands everything buffered so far to the stream.  Does nothing on a
+     * writer without one.
+     */
+    void flush() {
+
+        if (out && used > 0) {
+            out->write(&buffer[0], used);
+            used = 0;
+        }
+    }
+
+    /**
+     * What's been buffered so far
+     */
+    const char* GetData() const {
+        return &buffer[0];
+    }
+
+    size_t GetSize() const {
+        return used;
+    }
+
+    /**
+     * Drops everything buffered so far without writing it
+     */
+    void clear() {
+        used = 0;
+    }
+
+private:
+
+    void makeRoom(size_t size) {
+
+        if (out) {
+            flush();
+        }
+        else {
+            buffer.resize(std::max(buffer.size() * 2, used + size));
+        }
+    }
+};
+
+}
+}
@@ -0,0 +1,423 @@
+//  ********************************************************************
+//  This file is part of GTS (Good Transcript Selector).
+//
+//  GTS is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Portculis is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with GTS.  If not, see <http://www.gnu.org/licenses/>.
+//  *******************************************************************
+
+#pragma once
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <limits>
+#include <string>
+using std::string;
+
+#include <boost/lexical_cast.hpp>
+
+#include "scanner.hpp"
+
+namespace gts {
+namespace io {
+
+/**
+ * A non-owning view onto a run of characters, typically inside a memory
+ * mapped file.  Only valid for as long as the underlying buffer is.
+ */
+struct StrRef {
+
+    const char* b;
+    const char* e;
+
+    StrRef() : b(NULL), e(NULL) {}
+
+    StrRef(const char* b, const char* e) : b(b), e(e) {}
+
+    size_t size() const {
+        return e - b;
+    }
+
+    bool empty() const {
+        return b == e;
+    }
+
+    char operator[](size_t i) const {
+        return b[i];
+    }
+
+    string str() const {
+        return string(b, e);
+    }
+
+    void assignTo(string& s) const {
+        s.assign(b, e);
+    }
+
+    bool equals(const char* lit) const {
+        const size_t len = strlen(lit);
+        return len == size() && memcmp(b, lit, len) == 0;
+    }
+
+    /**
+     * ASCII case-insensitive comparison against a literal.  Equivalent to
+     * boost::iequals for the keywords we compare against.
+     */
+    bool iequals(const char* lit) const {
+
+        const char* p = b;
+
+        for(; p != e && *lit != '\0'; p++, lit++) {
+            if (toLower(*p) != toLower(*lit)) {
+                return false;
+            }
+        }
+
+        return p == e && *lit == '\0';
+    }
+
+    static char toLower(char c) {
+        return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+    }
+};
+
+/**
+ * Matches the characters removed by boost::trim under the classic locale
+ */
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+inline StrRef trim(StrRef s) {
+
+    while (s.b != s.e && isSpace(*s.b)) {
+        s.b++;
+    }
+
+    while (s.e != s.b && isSpace(*(s.e - 1))) {
+        s.e--;
+    }
+
+    return s;
+}
+
+/**
+ * Returns a pointer to the newline terminating the line starting at p, or
+ * end if the last line in the buffer is unterminated.
+ */
+inline const char* findLineEnd(const char* p, const char* end) {
+
+    static const DelimSet NEWLINE("\n");
+    return findFirst(p, end, NEWLINE);
+}
+
+/**
+ * Walks the lines of a buffer in the same way as repeated calls to
+ * std::getline, i.e. a final unterminated line is still returned and a
+ * trailing newline doesn't produce an extra empty line.
+ */
+class LineReader {
+
+private:
+
+    const char* p;
+    const char* end;
+
+public:
+
+    LineReader(const char* begin, const char* end) : p(begin), end(end) {}
+
+    bool done() const {
+        return p == end;
+    }
+
+    bool next(StrRef& line) {
+
+        if (p == end) {
+            return false;
+        }
+
+        const char* lineEnd = findLineEnd(p, end);
+        line = StrRef(p, lineEnd);
+        p = lineEnd == end ? end : lineEnd + 1;
+        return true;
+    }
+
+    bool next(string& line) {
+
+        StrRef ref;
+
+        if (!next(ref)) {
+            return false;
+        }
+
+        ref.assignTo(line);
+        return true;
+    }
+};
+
+/**
+ * Splits s on any of delims, writing at most max views into out.  Returns the
+ * total number of tokens found, which may exceed max.  When compress is set,
+ * runs of adjacent delimiters are treated as one, reproducing the behaviour
+ * of boost::split with token_compress_on.
+ */
+inline size_t split(const StrRef& s, const DelimSet& delims, StrRef* out, size_t max, bool compress) {
+
+    // Delimiter positions are collected a batch at a time by the scanning kernel
+    const size_t BATCH = 32;
+    const char* pos[BATCH];
+
+    size_t n = 0;
+    const char* start = s.b;
+    const char* p = s.b;
+
+    while (p != s.e) {
+
+        const size_t nbFound = scan(p, s.e, delims, pos, BATCH);
+
+        for(size_t i = 0; i < nbFound; i++) {
+
+            // Skip delimiters swallowed by the previous one
+            if (pos[i] < start) {
+                continue;
+            }
+
+            if (n < max) {
+                out[n] = StrRef(start, pos[i]);
+            }
+            n++;
+
+            start = pos[i] + 1;
+
+            if (compress) {
+                while (start != s.e && delims.contains(*start)) {
+                    start++;
+                }
+            }
+        }
+
+        p = nbFound < BATCH ? s.e : pos[BATCH - 1] + 1;
+    }
+
+    if (n < max) {
+        out[n] = StrRef(start, s.e);
+    }
+
+    return n + 1;
+}
+
+/**
+ * As split, but stops as soon as max tokens have been found, so the rest of
+ * s isn't scanned.  Returns the number of tokens written to out.
+ */
+inline size_t splitFirst(const StrRef& s, const DelimSet& delims, StrRef* out, size_t max, bool compress) {
+
+    size_t n = 0;
+    const char* p = s.b;
+
+    while (n < max) {
+
+        const char* d = findFirst(p, s.e, delims);
+        out[n++] = StrRef(p, d);
+
+        if (d == s.e) {
+            break;
+        }
+
+        p = d + 1;
+
+        if (compress) {
+            while (p != s.e && delims.contains(*p)) {
+                p++;
+            }
+        }
+    }
+
+    return n;
+}
+
+/**
+ * Converts a plain decimal integer, i.e. digits with an optional leading
+ * minus for signed types, in the manner of std::from_chars.  Returns false,
+ * leaving value untouched, for anything else including out of range values.
+ */
+template<class T>
+inline bool parseInt(const StrRef& s, T& value) {
+
+    const char* p = s.b;
+    const bool negative = p != s.e && *p == '-' && std::numeric_limits<T>::is_signed;
+
+    if (negative) {
+        p++;
+    }
+
+    // Up to 18 digits can't overflow the accumulator
+    if (p == s.e || s.e - p > 18) {
+        return false;
+    }
+
+    int64_t v = 0;
+
+    for(; p != s.e; p++) {
+
+        const unsigned d = static_cast<unsigned char>(*p) - '0';
+
+        if (d > 9) {
+            return false;
+        }
+
+        v = v * 10 + d;
+    }
+
+    v = negative ? -v : v;
+
+    if (v < static_cast<int64_t>(std::numeric_limits<T>::min()) ||
+            v > static_cast<int64_t>(std::numeric_limits<T>::max())) {
+        return false;
+    }
+
+    value = static_cast<T>(v);
+    return true;
+}
+
+/**
+ * Converts a plain decimal floating point number: an optional minus, digits
+ * with an optional fraction, and an optional exponent.  The characters are
+ * validated without any copying, and are only then handed to strtod, which
+ * rounds correctly so agrees exactly with boost::lexical_cast.  Returns false
+ * for anything else, e.g. "inf", hex or surrounding whitespace.
+ */
+inline bool parseDouble(const StrRef& s, double& value) {
+
+    // Long enough for any sensibly written double
+    const size_t MAX_SIZE = 64;
+
+    if (s.empty() || s.size() >= MAX_SIZE) {
+        return false;
+    }
+
+    const char* p = s.b;
+    size_t nbDigits = 0;
+
+    if (*p == '-') {
+        p++;
+    }
+
+    for(; p != s.e && *p >= '0' && *p <= '9'; p++) {
+        nbDigits++;
+    }
+
+    if (p != s.e && *p == '.') {
+        for(p++; p != s.e && *p >= '0' && *p <= '9'; p++) {
+            nbDigits++;
+        }
+    }
+
+    if (nbDigits == 0) {
+        return false;
+    }
+
+    if (p != s.e && (*p == 'e' || *p == 'E')) {
+
+        p++;
+
+        if (p != s.e && (*p == '-' || *p == '+')) {
+            p++;
+        }
+
+        const char* expStart = p;
+
+        for(; p != s.e && *p >= '0' && *p <= '9'; p++) {}
+
+        if (p == expStart) {
+            return false;
+        }
+    }
+
+    if (p != s.e) {
+        return false;
+    }
+
+    // The field isn't null terminated, and may end the buffer
+    char buf[MAX_SIZE];
+    memcpy(buf, s.b, s.size());
+    buf[s.size()] = '\0';
+
+    // Leave overflow and underflow to lexical_cast, which treats them differently
+    errno = 0;
+    const double v = strtod(buf, NULL);
+
+    if (errno == ERANGE) {
+        return false;
+    }
+
+    value = v;
+    return true;
+}
+
+/**
+ * Converts s to an integer of type T, using the fast path when possible and
+ * otherwise deferring to boost::lexical_cast so unusual input is accepted, or
+ * rejected with bad_lexical_cast, exactly as before
+ */
+template<class T>
+inline T toInt(const StrRef& s) {
+    T value;
+    return parseInt(s, value) ? value : boost::lexical_cast<T>(s.b, s.size());
+}
+
+inline double toDouble(const StrRef& s) {
+    double value;
+    return parseDouble(s, value) ? value : boost::lexical_cast<double>(s.b, s.size());
+}
+
+/**
+ * Like toInt, but returns false instead of throwing when s isn't a number.
+ * Only input the fast path turns down pays for the exception.
+ */
+template<class T>
+inline bool tryToInt(const StrRef& s, T& value) {
+
+    if (parseInt(s, value)) {
+        return true;
+    }
+
+    try {
+        value = boost::lexical_cast<T>(s.b, s.size());
+        return true;
+    }
+    catch(const boost::bad_lexical_cast&) {
+        return false;
+    }
+}
+
+inline bool tryToDouble(const StrRef& s, double& value) {
+
+    if (parseDouble(s, value)) {
+        return true;
+    }
+
+    try {
+        value = boost::lexical_cast<double>(s.b, s.size());
+        return true;
+    }
+    catch(const boost::bad_lexical_cast&) {
+        return false;
+    }
+}
+
+}
+}
@@ -0,0 +1,191 @@
+//  ********************************************************************
+//  This file is part of GTS (Good Transcript Selector).
+//
+//  GTS is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Portculis is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with GTS.  If not, see <http://www.gnu.org/licenses/>.
+//  *******************************************************************
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <ostream>
+#include <string>
+#include <vector>
+using std::ostream;
+using std::string;
+using std::vector;
+
+#include <boost/foreach.hpp>
+
+namespace gts {
+
+/**
+ * Tallies records that were skipped or ignored while loading an input file,
+ * by category, keeping the first few examples of each.  Meant to replace a
+ * line of output per record with a single summary written once loading is
+ * done.
+ *
+ * Loaders that accept a ParseLog are lenient: malformed records are counted
+ * here and skipped, rather than aborting the load with an exception.
+ * Categories are few, so they're kept in the order they were first seen and
+ * looked up by a linear scan.
+ */
+class ParseLog {
+
+public:
+
+    static const size_t DEFAULT_MAX_EXAMPLES = 5;
+
+    // Long lines are cut down to this many characters in examples
+    static const size_t MAX_EXAMPLE_LENGTH = 200;
+
+private:
+
+    struct Category {
+        string name;
+        uint64_t count;
+        vector<string> examples;
+    };
+
+    vector<Category> categories;
+    size_t maxExamples;
+
+public:
+
+    ParseLog() : maxExamples(DEFAULT_MAX_EXAMPLES) {}
+
+    ParseLog(size_t maxExamples) : maxExamples(maxExamples) {}
+
+    size_t getMaxExamples() const {
+        return maxExamples;
+    }
+
+    /**
+     * Counts one record under category, keeping it as an example if we don't
+     * have enough yet
+     */
+    void add(const char* category, const char* b, const char* e) {
+
+        Category& c = find(category);
+        c.count++;
+
+        if (c.examples.size() < maxExamples) {
+            c.examples.push_back(string(b, e - b > (ptrdiff_t)MAX_EXAMPLE_LENGTH ? b + MAX_EXAMPLE_LENGTH : e));
+        }
+    }
+
+    void add(const char* category, const string& example) {
+        add(category, example.data(), example.data() + example.size());
+    }
+
+    /**
+     * The number of records counted under category
+     */
+    uint64_t count(const char* category) const {
+
+        BOOST_FOREACH(const Category& c, categories) {
+            if (c.name == category) {
+                return c.count;
+            }
+        }
+
+        return 0;
+    }
+
+    /**
+     * The examples kept for category, oldest first
+     */
+    vector<string> getExamples(const char* category) const {
+
+        BOOST_FOREACH(const Category& c, categories) {
+            if (c.name == category) {
+                return c.examples;
+            }
+        }
+
+        return vector<string>();
+    }
+
+    /**
+     * The number of records counted across all categories
+     */
+    uint64_t total() const {
+
+        uint64_t total = 0;
+
+        BOOST_FOREACH(const Category& c, categories) {
+            total += c.count;
+        }
+
+        return total;
+    }
+
+    bool empty() const {
+        return categories.empty();
+    }
+
+    /**
+     * Adds everything in other to this log.  Used to combine the logs of
+     * ranges that were parsed concurrently, so merging them in file order
+     * keeps the examples in file order.
+     */
+    void merge(const ParseLog& other) {
+
+        BOOST_FOREACH(const Category& o, other.categories) {
+
+            Category& c = find(o.name.c_str());
+            c.count += o.count;
+
+            for(size_t i = 0; i < o.examples.size() && c.examples.size() < maxExamples; i++) {
+                c.examples.push_back(o.examples[i]);
+            }
+        }
+    }
+
+    /**
+     * Writes a summary of each category, with its examples, to out.  Writes
+     * nothing if the log is empty.
+     */
+    void report(ostream& out) const {
+
+        BOOST_FOREACH(const Category& c, categories) {
+
+            out << " - " << c.name << ": " << c.count << (c.count == 1 ? " record" : " records") << std::endl;
+
+            BOOST_FOREACH(const string& example, c.examples) {
+                out << "     e.g. " << example << std::endl;
+            }
+        }
+    }
+
+private:
+
+    Category& find(const char* category) {
+
+        for(size_t i = 0; i < categories.size(); i++) {
+            if (categories[i].name == category) {
+                return categories[i];
+            }
+        }
+
+        categories.push_back(Category());
+        categories.back().name = category;
+        categories.back().count = 0;
+
+        return categories.back();
+    }
+};
+
+}
@@ -0,0 +1,325 @@
+//  ********************************************************************
+//  This file is part of GTS (Good Transcript Selector).
+//
+//  GTS is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Portculis is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with GTS.  If not, see <http://www.gnu.org/licenses/>.
+//  *******************************************************************
+
+#pragma once
+
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <boost/atomic.hpp>
+#include <boost/exception/all.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace gts {
+
+typedef boost::error_info<struct StringPoolError,string> StringPoolErrorInfo;
+struct StringPoolException: virtual boost::exception, virtual std::exception { };
+
+/**
+ * Stores one copy of each distinct string and hands out small integer handles
+ * for them.  Intended for low cardinality fields, such as sequence ids and
+ * sources, which are repeated across millions of GFF records.  Each GFFArena
+ * also keeps one for the ids of its genes and transcripts, where the handles
+ * serve as dense integer keys.
+ *
+ * Looking up a string that's already there, and resolving a handle, are lock
+ * free, so the threads parsing a file in parallel don't queue up behind each
+ * other.  Only adding a new string takes a lock.  Strings live in fixed size
+ * chunks which are never moved or freed, so a reference returned by resolve
+ * stays valid for the life of the program.  The table of chunks grows as
+ * needed, so the only limit is MAX_SIZE strings.
+ */
+class StringPool : boost::noncopyable {
+
+public:
+
+    static const uint32_t CHUNK_BITS = 12;
+    static const uint32_t CHUNK_SIZE = 1 << CHUNK_BITS;
+
+    // Keeps the index, which is twice the size of the pool, within 32 bits
+    static const uint32_t MAX_SIZE = 1u << 31;
+
+    // Handle of the empty string, which is always present
+    static const uint32_t EMPTY = 0;
+
+    // Returned by find for strings that haven't been interned
+    static const uint32_t NONE = 0xFFFFFFFF;
+
+private:
+
+    /**
+     * Open addressed hash index from strings to handles.  Each slot holds a
+     * handle plus one, so zero marks an empty slot.  A slot is only ever
+     * written once, after the string it points at is in place, so readers
+     * can probe it without the lock.  The index is never resized in place,
+     * a bigger copy is published instead.
+     */
+    struct Index : boost::noncopyable {
+
+        const uint32_t mask;
+        boost::atomic<uint32_t>* slots;
+
+        Index(uint32_t capacity) : mask(capacity - 1), slots(new boost::atomic<uint32_t>[capacity]) {
+            for(uint32_t i = 0; i < capacity; i++) {
+                slots[i].store(0, boost::memory_order_relaxed);
+            }
+        }
+
+        ~Index() {
+            delete[] slots;
+        }
+
+        uint32_t GetCapacity() const {
+            return mask + 1;
+        }
+    };
+
+    static const uint32_t INITIAL_CAPACITY = 64;
+    static const uint32_t INITIAL_CHUNKS = 16;
+
+    // Table of chunks, with room for nbChunks of them.  Unused entries are
+    // NULL.  Like the index, it's replaced by a bigger copy when full.
+    boost::atomic<string**> chunks;
+    uint32_t nbChunks;
+    vector<string**> retiredChunks;
+
+    uint32_t size;
+
+    // Identifies this pool, and the handles it has given out since it was
+    // last cleared, to anything that keeps hold of handles
+    uint32_t serial;
+
+    boost::atomic<Index*> index;
+
+    // Indexes that have been replaced by a bigger one.  Lock free readers may
+    // still be probing them, so they're kept until the pool goes.
+    vector<Index*> retired;
+
+    boost::mutex mutex;
+
+public:
+
+    StringPool() : chunks(new string*[INITIAL_CHUNKS]()), nbChunks(INITIAL_CHUNKS), size(0), serial(nextSerial()), index(new Index(INITIAL_CAPACITY)) {
+        intern(string(""));
+    }
+
+    virtual ~StringPool() {
+        string** table = chunks.load(boost::memory_order_relaxed);
+        for(uint32_t i = 0; i < nbChunks && table[i] != NULL; i++) {
+            delete[] table[i];
+        }
+        delete[] table;
+        for(size_t i = 0; i < retiredChunks.size(); i++) {
+            delete[] retiredChunks[i];
+        }
+        for(size_t i = 0; i < retired.size(); i++) {
+            delete retired[i];
+        }
+        delete index.load(boost::memory_order_relaxed);
+    }
+
+    /**
+     * The pool shared by all GFF records
+     */
+    static StringPool& global() {
+        static StringPool pool;
+        return pool;
+    }
+
+    uint32_t intern(const string& s) {
+        return intern(s.data(), s.data() + s.size());
+    }
+
+    /**
+     * Interns the characters in [begin, end) without first copying them into
+     * a string, unless they haven't been seen before
+     */
+    uint32_t intern(const char* begin, const char* end) {
+
+        const size_t hash = boost::hash_range(begin, end);
+
+        uint32_t handle = lookup(begin, end, hash);
+
+        if (handle != NONE) {
+            return handle;
+        }
+
+        boost::mutex::scoped_lock lock(mutex);
+
+        // Someone else may have added it while we waited
+        handle = lookup(begin, end, hash);
+
+        return handle != NONE ? handle : add(begin, end, hash);
+    }
+
+    /**
+     * The handle of s, or NONE if s hasn't been interned.  Unlike intern,
+     * never adds anything to the pool.
+     */
+    uint32_t find(const string& s) const {
+        return lookup(s.data(), s.data() + s.size(), boost::hash_range(s.begin(), s.end()));
+    }
+
+    /**
+     * Forgets every string, other than the empty one, so handles start from
+     * scratch.  Chunks are kept for reuse.  Only for pools whose owner also
+     * forgets every handle it was given, such as a GFFArena's ids, and which
+     * nothing else is reading at the time.
+     */
+    void clear() {
+
+        boost::mutex::scoped_lock lock(mutex);
+
+        for(size_t i = 0; i < retired.size(); i++) {
+            delete retired[i];
+        }
+        retired.clear();
+
+        delete index.exchange(new Index(INITIAL_CAPACITY));
+
+        size = 0;
+        serial = nextSerial();
+        const string empty;
+        add(empty.data(), empty.data(), boost::hash_range(empty.begin(), empty.end()));
+    }
+
+    const string& resolve(uint32_t handle) const {
+        return chunks.load(boost::memory_order_acquire)[handle >> CHUNK_BITS][handle & (CHUNK_SIZE - 1)];
+    }
+
+    uint32_t GetSize() const {
+        return size;
+    }
+
+    /**
+     * Unique to this pool, and changed by clear, so that a handle cached
+     * along with the serial of the pool it came from can be checked before
+     * it's used.  Never 0.
+     */
+    uint32_t GetSerial() const {
+        return serial;
+    }
+
+private:
+
+    static uint32_t nextSerial() {
+        static boost::atomic<uint32_t> last(0);
+        return ++last;
+    }
+
+    /**
+     * Probes the index for [begin, end) without taking the lock.  Returns
+     * NONE if it isn't there.
+     */
+    uint32_t lookup(const char* begin, const char* end, size_t hash) const {
+
+        const Index* idx = index.load(boost::memory_order_acquire);
+        const size_t len = end - begin;
+
+        for(uint32_t i = hash & idx->mask; ; i = (i + 1) & idx->mask) {
+
+            const uint32_t slot = idx->slots[i].load(boost::memory_order_acquire);
+
+            if (slot == 0) {
+                return NONE;
+            }
+
+            const string& s = resolve(slot - 1);
+
+            if (s.size() == len && memcmp(s.data(), begin, len) == 0) {
+                return slot - 1;
+            }
+        }
+    }
+
+    static void insert(Index& idx, size_t hash, uint32_t handle) {
+
+        uint32_t i = hash & idx.mask;
+
+        while (idx.slots[i].load(boost::memory_order_relaxed) != 0) {
+            i = (i + 1) & idx.mask;
+        }
+
+        idx.slots[i].store(handle + 1, boost::memory_order_release);
+    }
+
+    /**
+     * Adds [begin, end), which isn't in the pool yet.  Must hold the lock.
+     */
+    uint32_t add(const char* begin, const char* end, size_t hash) {
+
+        const uint32_t handle = size;
+        const uint32_t chunk = handle >> CHUNK_BITS;
+
+        if (handle == MAX_SIZE) {
+            BOOST_THROW_EXCEPTION(StringPoolException() << StringPoolErrorInfo(string(
+                "String pool is full.  Too many distinct values for: ") + string(begin, end)));
+        }
+
+        string** table = chunks.load(boost::memory_order_relaxed);
+
+        if (chunk == nbChunks) {
+
+            string** bigger = new string*[nbChunks * 2]();
+            std::copy(table, table + nbChunks, bigger);
+
+            chunks.store(bigger, boost::memory_order_release);
+            retiredChunks.push_back(table);
+            table = bigger;
+            nbChunks *= 2;
+        }
+
+        if (table[chunk] == NULL) {
+            table[chunk] = new string[CHUNK_SIZE];
+        }
+
+        table[chunk][handle & (CHUNK_SIZE - 1)].assign(begin, end);
+        size++;
+
+        Index* idx = index.load(boost::memory_order_relaxed);
+
+        // Keep the index at most half full, so probes stay short
+        if (size * 2 > idx->GetCapacity()) {
+
+            Index* bigger = new Index(idx->GetCapacity() * 2);
+
+            for(uint32_t h = 0; h < handle; h++) {
+                const string& s = resolve(h);
+                insert(*bigger, boost::hash_range(s.begin(), s.end()), h);
+            }
+
+            index.store(bigger, boost::memory_order_release);
+            retired.push_back(idx);
+            idx = bigger;
+        }
+
+        // Only now can readers find it
+        insert(*idx, hash, handle);
+
+        return handle;
+    }
+};
+
+}
@@ -0,0 +1,1101 @@
+//  ********************************************************************
+//  This file is part of GTS (Good Transcript Selector).
+//
+//  GTS is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Portculis is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with GTS.  If not, see <http://www.gnu.org/licenses/>.
+//  *******************************************************************
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+using std::string;
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::vector;
+
+#include <boost/exception/all.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/timer/timer.hpp>
+using boost::timer::cpu_timer;
+namespace po = boost::program_options;
+namespace bfs = boost::filesystem;
+
+#include <gff.hpp>
+using gts::gff::GFF;
+using gts::gff::GFFArena;
+using gts::gff::GFFArenaPtr;
+using gts::gff::GFFList;
+using gts::gff::GFFPtr;
+using gts::gff::GFF3;
+using gts::gff::GFFModel;
+using gts::gff::GFFModelPtr;
+using gts::ParseLog;
+using gts::StringPool;
+
+#include <fln.hpp>
+using gts::DBAnnot;
+
+#include <genbank.hpp>
+using gts::gb::Genbank;
+
+#include <io/scanner.hpp>
+using gts::io::DelimSet;
+
+
+/**
+ * Writes a transdecoder style GFF3 file containing nbGenes genes, each with a
+ * single mRNA, two exons, two CDSes and both UTRs
+ */
+size_t makeGff(const string& path, uint32_t nbGenes) {
+
+    std::ofstream out(path.c_str());
+    size_t nbRecords = 0;
+
+    for(uint32_t i = 1; i <= nbGenes; i++) {
+
+        const string seq = string("scaffold_") + lexical_cast<string>(i % 50);
+        const int32_t s = (i / 50) * 6000 + 100;
+        const string t = string("CUFF.") + lexical_cast<string>(i) + ".1";
+        const string g = t + "|g." + lexical_cast<string>(i);
+        const string m = t + "|m." + lexical_cast<string>(i);
+        const string prefix = seq + "\ttransdecoder\t";
+
+        out << prefix << "gene\t" << s << "\t" << s + 1999 << "\t.\t+\t.\tID=" << g << ";Name=ORF" << "\n"
+            << prefix << "mRNA\t" << s << "\t" << s + 1999 << "\t.\t+\t.\tID=" << m << ";Parent=" << g << ";Name=ORF" << "\n"
+            << prefix << "five_prime_UTR\t" << s << "\t" << s + 99 << "\t.\t+\t.\tID=" << m << ".utr5p1;Parent=" << m << "\n"
+            << prefix << "exon\t" << s << "\t" << s + 799 << "\t.\t+\t.\tID=" << m << ".exon1;Parent=" << m << "\n"
+            << prefix << "CDS\t" << s + 100 << "\t" << s + 799 << "\t.\t+\t0\tID=cds." << m << ";Parent=" << m << "\n"
+            << prefix << "exon\t" << s + 1200 << "\t" << s + 1999 << "\t.\t+\t.\tID=" << m << ".exon2;Parent=" << m << "\n"
+            << prefix << "CDS\t" << s + 1200 << "\t" << s + 1799 << "\t.\t+\t0\tID=cds." << m << ";Parent=" << m << "\n"
+            << prefix << "three_prime_UTR\t" << s + 1800 << "\t" << s + 1999 << "\t.\t+\t.\tID=" << m << ".utr3p1;Parent=" << m << "\n";
+
+        nbRecords += 8;
+    }
+
+    return nbRecords;
+}
+
+/**
+ * The original std::getline / boost::split based GFF3 loader, kept as the
+ * baseline for the load benchmarks
+ */
+void legacyLoad(const string& path, GFFList& gffs, GFFArena& arena) {
+
+    std::ifstream file(path.c_str());
+    string line;
+
+    while (std::getline(file, line)) {
+
+        boost::trim(line);
+
+        if (line.empty()) {
+            continue;
+        }
+
+        vector<string> parts;
+        boost::split( parts, line, boost::is_any_of("\t"), boost::token_compress_on );
+
+        GFFPtr gff = arena.create(GFF3);
+        gff->SetSeqId(parts[0]);
+        gff->SetSource(parts[1]);
+        gff->SetType(gts::gff::gffTypeFromString(parts[2]));
+        gff->SetStart(lexical_cast<int32_t>(parts[3]));
+        gff->SetEnd(lexical_cast<int32_t>(parts[4]));
+        gff->SetScore(parts[5][0] == '.' ? -1.0 : lexical_cast<double>(parts[5]));
+        gff->SetStrand(parts[6][0]);
+        gff->SetPhase(parts[7][0] == '.' ? -1 : lexical_cast<int8_t>(parts[7]));
+
+        vector<string> attrParts;
+        boost::split( attrParts, parts[8], boost::is_any_of(";"), boost::token_compress_on );
+
+        BOOST_FOREACH(string attr, attrParts) {
+
+            boost::trim(attr);
+
+            if (!attr.empty()) {
+                vector<string> attrElements;
+                boost::split( attrElements, attr, boost::is_any_of("="), boost::token_compress_on );
+
+                if (boost::iequals(attrElements[0], "ID")) {
+                    gff->SetId(attrElements[1]);
+                }
+                else if (boost::iequals(attrElements[0], "Name")) {
+                    gff->SetName(attrElements[1]);
+                }
+                else if (boost::iequals(attrElements[0], "Parent")) {
+                    gff->SetParentId(attrElements[1]);
+                }
+            }
+        }
+
+        gffs.push_back(gff);
+    }
+}
+
+void report(const string& name, const cpu_timer& timer, size_t nbRecords) {
+
+    const double secs = timer.elapsed().wall / 1e9;
+
+    cout << " * " << name << ": " << nbRecords << " records in " << secs << "s = "
+         << (size_t)(nbRecords / secs) << " records/s" << endl;
+}
+
+void benchLoad(const string& path, size_t nbRecords) {
+
+    cout << endl << "GFF3 load" << endl
+         << "---------" << endl;
+
+    {
+        GFFArena arena;
+        GFFList gffs;
+        cpu_timer timer;
+        legacyLoad(path, gffs, arena);
+        timer.stop();
+        report("getline + boost::split", timer, gffs.size());
+    }
+
+    {
+        GFFArena arena;
+        GFFList gffs;
+        cpu_timer timer;
+        GFF::load(GFF3, path, gffs, arena);
+        timer.stop();
+        report("memory mapped tokenizer", timer, gffs.size());
+    }
+
+    {
+        // Keeping only mRNAs, as gbfilter and gffids do, by filtering after
+        // every line has been parsed
+        GFFArena arena;
+        GFFList gffs, mrnas;
+        cpu_timer timer;
+        GFF::load(GFF3, path, gffs, arena);
+        BOOST_FOREACH(GFFPtr gff, gffs) {
+            if (gff->GetType() == gts::gff::MRNA) {
+                mrnas.push_back(gff);
+            }
+        }
+        timer.stop();
+        report("mRNA only, filtered after parsing", timer, nbRecords);
+    }
+
+    {
+        GFFArena arena;
+        GFFList mrnas;
+        cpu_timer timer;
+        GFF::load(GFF3, path, mrnas, arena, gts::gff::MRNA);
+        timer.stop();
+        report("mRNA only, filter pushed into the loader", timer, nbRecords);
+    }
+
+    {
+        GFFArena arena;
+        GFFList gffs;
+        cpu_timer timer;
+        GFF::load(GFF3, path, gffs, arena, gts::gff::GFFFilter().addSeqId("scaffold_7").addRegion("", 0, 100000000));
+        timer.stop();
+        report("one scaffold, filter pushed into the loader", timer, nbRecords);
+    }
+}
+
+/**
+ * Cufflinks style GTF lines, one transcript and two exons per locus
+ */
+void makeGtfLines(uint32_t nbLoci, vector<string>& lines) {
+    
+    for(uint32_t i = 1; i <= nbLoci; i++) {
+        
+        const string seq = string("scaffold_") + lexical_cast<string>(i % 50);
+        const int32_t s = (i / 50) * 6000 + 100;
+        const string attrs = string("gene_id \"CUFF.") + lexical_cast<string>(i) + "\"; transcript_id \"CUFF." + 
+                lexical_cast<string>(i) + ".1\"; FPKM \"" + lexical_cast<string>(i % 997 + 0.25) + 
+                "\"; frac \"1.000000\"; conf_lo \"0.000000\"; conf_hi \"45.750320\"; cov \"3.051204\";";
+        const string prefix = seq + "\tCufflinks\t";
+        
+        lines.push_back(prefix + "transcript\t" + lexical_cast<string>(s) + "\t" + lexical_cast<string>(s + 1999) + "\t1000\t+\t.\t" + attrs);
+        lines.push_back(prefix + "exon\t" + lexical_cast<string>(s) + "\t" + lexical_cast<string>(s + 799) + "\t1000\t+\t.\t" + attrs + " exon_number \"1\";");
+        lines.push_back(prefix + "exon\t" + lexical_cast<string>(s + 1200) + "\t" + lexical_cast<string>(s + 1999) + "\t1000\t+\t.\t" + attrs + " exon_number \"2\";");
+    }
+}
+
+void reportPerLine(const string& name, const cpu_timer& timer, size_t nbLines) {
+    
+    const double secs = timer.elapsed().wall / 1e9;
+    
+    cout << " * " << name << ": " << nbLines << " lines in " << secs << "s = "
+         << secs * 1e9 / nbLines << " ns/line" << endl;
+}
+
+/**
+ * Times GFF::parse alone on lines already held in memory, so that file access
+ * and line splitting don't hide the cost of field and attribute decoding
+ */
+void benchParse(const string& path, uint32_t nbGenes) {
+    
+    cout << endl << "GFF::parse per line" << endl
+         << "-------------------" << endl;
+    
+    vector<string> gff3Lines;
+    {
+        std::ifstream file(path.c_str());
+        string line;
+        while (std::getline(file, line)) {
+            gff3Lines.push_back(line);
+        }
+    }
+    
+    vector<string> gtfLines;
+    makeGtfLines(nbGenes, gtfLines);
+    
+    {
+        GFFArena arena;
+        cpu_timer timer;
+        BOOST_FOREACH(const string& line, gff3Lines) {
+            GFF::parse(GFF3, line, arena);
+        }
+        timer.stop();
+        reportPerLine("GFF3", timer, gff3Lines.size());
+    }
+    
+    {
+        // As above, then decoding the attributes a gene model needs for linking
+        GFFArena arena;
+        cpu_timer timer;
+        BOOST_FOREACH(const string& line, gff3Lines) {
+            GFFPtr gff = GFF::parse(GFF3, line, arena);
+            gff->GetId();
+            gff->GetParentId();
+        }
+        timer.stop();
+        reportPerLine("GFF3 + ID and Parent", timer, gff3Lines.size());
+    }
+    
+    {
+        // Clean input shouldn't cost any more to parse leniently
+        GFFArena arena;
+        ParseLog log;
+        cpu_timer timer;
+        BOOST_FOREACH(const string& line, gff3Lines) {
+            GFF::parse(GFF3, line.data(), line.data() + line.size(), arena, &log);
+        }
+        timer.stop();
+        reportPerLine("GFF3, lenient", timer, gff3Lines.size());
+    }
+    
+    {
+        // One line in a hundred malformed, skipped by catching the exception
+        // for each one or by counting them in a log
+        vector<string> broken(gff3Lines);
+        for(size_t i = 0; i < broken.size(); i += 100) {
+            broken[i] = "scaffold_1\tbench\tgene\t1\t2";
+        }
+        
+        {
+            GFFArena arena;
+            cpu_timer timer;
+            BOOST_FOREACH(const string& line, broken) {
+                try {
+                    GFF::parse(GFF3, line, arena);
+                }
+                catch(gts::gff::GFFException& e) {
+                }
+            }
+            timer.stop();
+            reportPerLine("GFF3, 1% malformed, catching exceptions", timer, broken.size());
+        }
+        
+        {
+            GFFArena arena;
+            ParseLog log;
+            cpu_timer timer;
+            BOOST_FOREACH(const string& line, broken) {
+                GFF::parse(GFF3, line.data(), line.data() + line.size(), arena, &log);
+            }
+            timer.stop();
+            reportPerLine("GFF3, 1% malformed, lenient", timer, broken.size());
+        }
+    }
+    
+    {
+        GFFArena arena;
+        cpu_timer timer;
+        BOOST_FOREACH(const string& line, gtfLines) {
+            GFF::parse(gts::gff::GTF, line, arena);
+        }
+        timer.stop();
+        reportPerLine("GTF", timer, gtfLines.size());
+    }
+}
+
+void reportThroughput(const string& name, const cpu_timer& timer, size_t nbBytes) {
+
+    const double secs = timer.elapsed().wall / 1e9;
+
+    cout << " * " << name << ": " << nbBytes / (1024 * 1024) << "MB in " << secs << "s = "
+         << nbBytes / secs / 1e9 << " GB/s" << endl;
+}
+
+/**
+ * Raw throughput of each scanning kernel over the synthetic GFF3 file, for
+ * the line delimiter alone and for the full set of GFF delimiters
+ */
+void benchScan(const string& path) {
+
+    cout << endl << "Delimiter scanning" << endl
+         << "------------------" << endl;
+
+    FileBuffer file(path);
+
+    const char* names[] = { "newline", "GFF delimiters" };
+    const DelimSet sets[] = { DelimSet("\n"), DelimSet("\n\t;= ") };
+    const gts::io::ScanKernel kernels[] = { gts::io::SCAN_SCALAR, gts::io::SCAN_SSE2, gts::io::SCAN_AVX2 };
+
+    const size_t BATCH = 1024;
+    const char* pos[BATCH];
+
+    for(size_t i = 0; i < 2; i++) {
+
+        BOOST_FOREACH(gts::io::ScanKernel kernel, kernels) {
+
+            if (!gts::io::scanKernelSupported(kernel)) {
+                cout << " * " << names[i] << ", " << gts::io::scanKernelToString(kernel) << ": not supported" << endl;
+                continue;
+            }
+
+            const gts::io::ScanFn fn = gts::io::scanKernel(kernel);
+            size_t nbFound = 0;
+
+            cpu_timer timer;
+            const char* p = file.begin();
+            while (p != file.end()) {
+                const size_t n = fn(p, file.end(), sets[i], pos, BATCH);
+                nbFound += n;
+                p = n < BATCH ? file.end() : pos[BATCH - 1] + 1;
+            }
+            timer.stop();
+
+            reportThroughput(string(names[i]) + ", " + gts::io::scanKernelToString(kernel) +
+                    " (" + lexical_cast<string>(nbFound) + " found)", timer, file.GetSize());
+        }
+    }
+
+    {
+        size_t nbFound = 0;
+        cpu_timer timer;
+        for(const char* p = file.begin(); p != file.end(); nbFound++) {
+            const void* nl = memchr(p, '\n', file.end() - p);
+            p = nl == NULL ? file.end() : static_cast<const char*>(nl) + 1;
+        }
+        timer.stop();
+        reportThroughput("newline, memchr (" + lexical_cast<string>(nbFound) + " found)", timer, file.GetSize());
+    }
+}
+
+/**
+ * Writes a full-lengther DBAnnot style TSV with nbRecords rows
+ */
+void makeDbAnnot(const string& path, uint32_t nbRecords) {
+
+    std::ofstream out(path.c_str());
+
+    out << "# Query_acc\tQuery_length\tHit_acc\tHit_length\tStatus\t...\n";
+
+    for(uint32_t i = 1; i <= nbRecords; i++) {
+        const int32_t s = i % 500 + 1;
+        out << "CUFF." << i << ".1\t" << 2000 + i % 1000 << "\tsp|P" << i << "|PROT_ARATH\t" << 600 + i % 300
+            << "\tComplete\t" << 95.5 << "\t1e-50\t1\t600\t1\t600\t-\t" << s << "\t" << s + 1800
+            << "\t" << s + 1799 << "\t" << s << "\tProtein description " << i << "\t.\n";
+    }
+}
+
+/**
+ * Writes nbRecords Genbank records, each with an mRNA and CDS feature and a
+ * 2kb sequence
+ */
+void makeGenbank(const string& path, uint32_t nbRecords) {
+
+    std::ofstream out(path.c_str());
+    const string seqLine = " aacgtcatgc tcgatcgtac gtagctagct acgatcgatc gactagctag ctagctagca";
+
+    for(uint32_t i = 1; i <= nbRecords; i++) {
+
+        out << "LOCUS       scaffold_" << i << "   2000 bp  DNA\n"
+            << "FEATURES             Location/Qualifiers\n"
+            << "     source          1..2000\n"
+            << "     mRNA            complement(join(198..563,657..722,815..886,983..1054,1154..\n"
+            << "                     1225,1314..1385))\n"
+            << "                     /gene=\"asmbl_" << i << "|m." << i << "\"\n"
+            << "     CDS             complement(join(451..563,657..722,815..886,983..1054,1154..\n"
+            << "                     1225,1314..1385))\n"
+            << "                     /gene=\"asmbl_" << i << "|m." << i << "\"\n"
+            << "BASE COUNT      500 a    500 c   500 g    500 t\n"
+            << "ORIGIN\n";
+
+        for(int32_t j = 1; j <= 2000; j += 60) {
+            out << std::setw(9) << j << seqLine << "\n";
+        }
+
+        out << "//\n";
+    }
+}
+
+/**
+ * End to end throughput of each loader built on the scanning kernel
+ */
+void benchLoaders(const string& gffPath, uint32_t nbGenes) {
+
+    cout << endl << "Loader throughput" << endl
+         << "-----------------" << endl;
+
+    {
+        GFFArena arena;
+        GFFList gffs;
+        cpu_timer timer;
+        GFF::load(GFF3, gffPath, gffs, arena);
+        timer.stop();
+        reportThroughput("GFF3", timer, bfs::file_size(gffPath));
+    }
+
+    {
+        const string path = (bfs::temp_directory_path() / bfs::unique_path("gts_bench_%%%%%%.dbannot")).string();
+        makeDbAnnot(path, nbGenes);
+
+        vector< shared_ptr<DBAnnot> > dbannots;
+        cpu_timer timer;
+        DBAnnot::load(path, dbannots);
+        timer.stop();
+        reportThroughput("FLN DBAnnot", timer, bfs::file_size(path));
+
+        bfs::remove(path);
+    }
+
+    {
+        const string path = (bfs::temp_directory_path() / bfs::unique_path("gts_bench_%%%%%%.gb")).string();
+        makeGenbank(path, nbGenes / 10);
+
+        vector< shared_ptr<Genbank> > genbank;
+        cpu_timer timer;
+        Genbank::load(path, genbank);
+        timer.stop();
+        reportThroughput("Genbank", timer, bfs::file_size(path));
+
+        bfs::remove(path);
+    }
+}
+
+/**
+ * Resident set size of this process in bytes
+ */
+size_t residentBytes() {
+
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+#ifdef __GLIBC__
+/**
+ * Bytes allocated on the heap, including large blocks that were mapped
+ */
+size_t heapBytes() {
+
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+#endif
+
+void benchMemory(const string& path, size_t nbRecords) {
+
+    cout << endl << "GFF3 gene model memory" << endl
+         << "----------------------" << endl;
+
+    const size_t before = residentBytes();
+
+    cpu_timer loadTimer;
+    GFFModelPtr geneModel = GFFModel::load(path);
+    loadTimer.stop();
+
+    const size_t after = residentBytes();
+
+    cpu_timer teardownTimer;
+    geneModel.reset();
+    teardownTimer.stop();
+
+    cout << " * sizeof(GFF): " << sizeof(GFF) << " bytes" << endl
+         << " * Resident: " << (after - before) / (1024 * 1024) << "MB for " << nbRecords << " features = "
+         << (after - before) / nbRecords << " bytes per feature" << endl;
+
+    report("Gene model load", loadTimer, nbRecords);
+    report("Gene model teardown", teardownTimer, nbRecords);
+
+    // Freed memory isn't handed back to the system straight away, so the
+    // effect of compacting is measured on the heap itself
+#ifdef __GLIBC__
+    const size_t beforeLoad = heapBytes();
+    geneModel = GFFModel::load(path);
+    const size_t loaded = heapBytes();
+
+    cpu_timer compactTimer;
+    geneModel->compact();
+    compactTimer.stop();
+
+    const size_t compacted = heapBytes();
+
+    cout << " * Heap: " << (loaded - beforeLoad) / nbRecords << " bytes per feature, "
+         << (compacted - beforeLoad) / nbRecords << " once compacted, with "
+         << gts::IdStore::global().GetBytes() / 1024 << "KB of front-coded ids" << endl;
+
+    report("Gene model compact", compactTimer, nbRecords);
+#endif
+
+    gts::io::BinaryWriter cache;
+    geneModel->writeBinary(cache);
+
+    cout << " * Binary cache: " << cache.GetSize() / nbRecords << " bytes per feature" << endl;
+}
+
+/**
+ * The original GFFOrdering, which copied and compared sequence id strings on
+ * every comparison
+ */
+struct LegacyOrdering {
+    inline bool operator ()(const GFFPtr& a, const GFFPtr& b) {
+
+        int seqId = string(a->GetSeqId()).compare(string(b->GetSeqId()));
+        if (seqId != 0) {
+            return seqId < 0;
+        }
+        else if (a->GetStart() != b->GetStart()) {
+            return a->GetStart() < b->GetStart();
+        }
+        else if (a->GetEnd() != b->GetEnd()) {
+            return a->GetEnd() > b->GetEnd();
+        }
+        else {
+            return a->GetType() < b->GetType();
+        }
+    }
+};
+
+void benchSort(const string& path) {
+
+    cout << endl << "GFF3 sort" << endl
+         << "---------" << endl;
+
+    GFFArena arena;
+    GFFList gffs;
+    GFF::load(GFF3, path, gffs, arena);
+
+    // Shuffle deterministically so both comparators get the same input
+    boost::mt19937 rng(42);
+    for(size_t i = gffs.size(); i > 1; i--) {
+        std::swap(gffs[i - 1], gffs[rng() % i]);
+    }
+
+    {
+        GFFList copy(gffs);
+        cpu_timer timer;
+        std::sort(copy.begin(), copy.end(), LegacyOrdering());
+        timer.stop();
+        report("string seqId compare", timer, copy.size());
+    }
+
+    {
+        GFFList copy(gffs);
+        cpu_timer timer;
+        std::sort(copy.begin(), copy.end(), GFF::GFFOrdering());
+        timer.stop();
+        report("interned seqId compare", timer, copy.size());
+    }
+
+    {
+        GFFList copy(gffs);
+        cpu_timer timer;
+        GFF::sortList(copy);
+        timer.stop();
+        report("precomputed integer keys", timer, copy.size());
+    }
+}
+
+/**
+ * Writes a shuffled gene model sorted nbSaves times over, as gts does for
+ * each stage output and the pass file with --all, first sorting before every
+ * save as save used to, then sorting the model once
+ */
+void benchSortedSaves(const string& path, size_t nbRecords, size_t nbSaves) {
+
+    cout << endl << "GFF3 sorted saves" << endl
+         << "-----------------" << endl;
+
+    std::ofstream devNull("/dev/null");
+
+    GFFModelPtr model = GFFModel::load(path);
+
+    boost::mt19937 rng(42);
+    GFFList& genes = *model->getGeneList();
+    for(size_t i = genes.size(); i > 1; i--) {
+        std::swap(genes[i - 1], genes[rng() % i]);
+    }
+
+    // Leave decoding attributes out of the timings
+    {
+        TextWriter writer(devNull);
+        model->write(writer, "gts", 1);
+    }
+
+    GFFList shuffled(genes);
+
+    cpu_timer legacyTimer;
+    for(size_t i = 0; i < nbSaves; i++) {
+        std::sort(genes.begin(), genes.end(), GFF::GFFOrdering());
+        TextWriter writer(devNull);
+        model->write(writer, "gts", 1);
+    }
+    legacyTimer.stop();
+
+    genes = shuffled;
+
+    cpu_timer onceTimer;
+    for(size_t i = 0; i < nbSaves; i++) {
+        model->sort();
+        TextWriter writer(devNull);
+        model->write(writer, "gts", 1);
+    }
+    onceTimer.stop();
+
+    const string label = lexical_cast<string>(nbSaves) + " saves, ";
+    report(label + "sorting every time", legacyTimer, nbRecords * nbSaves);
+    report(label + "sorted once", onceTimer, nbRecords * nbSaves);
+}
+
+/**
+ * The original GFF::GetRootId, which split the id into fresh strings on every
+ * call
+ */
+string legacyRootId(const GFFPtr& gff) {
+
+    vector<string> idElements;
+    boost::split(idElements, gff->GetId(), boost::is_any_of("|"), boost::token_compress_on);
+    size_t pos = idElements[0].find("cds");
+    return pos != std::string::npos ? idElements[0].substr(pos+4) : idElements[0];
+}
+
+/**
+ * Looks up every transcript in a map keyed by its root id, as the strand and
+ * full lengther filters do, five times over, as a gts run does across stages
+ */
+void benchRootIds(const string& path) {
+
+    cout << endl << "Root id lookups" << endl
+         << "---------------" << endl;
+
+    GFFModelPtr model = GFFModel::load(path);
+    const size_t nbTranscripts = model->getTotalNbTranscripts();
+
+    boost::unordered_map<string, GFFPtr> byString;
+    boost::unordered_map<uint32_t, GFFPtr> byHandle;
+    StringPool ids;
+
+    BOOST_FOREACH(GFFPtr gene, *model->getGeneList()) {
+        BOOST_FOREACH(GFFPtr transcript, gene->GetChildList()) {
+            byString[legacyRootId(transcript)] = transcript;
+            byHandle[ids.intern(legacyRootId(transcript))] = transcript;
+        }
+    }
+
+    size_t found = 0;
+
+    cpu_timer stringTimer;
+    for(int i = 0; i < 5; i++) {
+        BOOST_FOREACH(GFFPtr gene, *model->getGeneList()) {
+            BOOST_FOREACH(GFFPtr transcript, gene->GetChildList()) {
+                found += byString.count(legacyRootId(transcript));
+            }
+        }
+    }
+    stringTimer.stop();
+
+    cpu_timer handleTimer;
+    for(int i = 0; i < 5; i++) {
+        BOOST_FOREACH(GFFPtr gene, *model->getGeneList()) {
+            BOOST_FOREACH(GFFPtr transcript, gene->GetChildList()) {
+                found += byHandle.count(transcript->GetRootIdHandle(ids));
+            }
+        }
+    }
+    handleTimer.stop();
+
+    report("split root id, string keys", stringTimer, nbTranscripts * 5);
+    report("cached root id handle", handleTimer, nbTranscripts * 5);
+    cout << "   found " << found << " of " << nbTranscripts * 10 << endl;
+}
+
+/**
+ * Times linking alone, on records in file order and on the same records in
+ * reverse, where every child arrives before its parent and must be held back.
+ * More than one thread links in parallel phases.
+ */
+void benchLink(const string& path, uint16_t maxThreads) {
+
+    cout << endl << "GFF3 gene model linking" << endl
+         << "-----------------------" << endl;
+
+    for(int reverse = 0; reverse < 2; reverse++) {
+
+        double base = 0.0;
+
+        for(uint16_t threads = 1; threads <= std::max<uint16_t>(maxThreads, 2); threads *= 2) {
+
+            // Linking modifies the records, so each run needs its own
+            GFFArenaPtr arena = make_shared<GFFArena>();
+            GFFList gffs;
+            GFF::load(GFF3, path, gffs, *arena);
+
+            if (reverse) {
+                std::reverse(gffs.begin(), gffs.end());
+            }
+
+            GFFModel model(arena);
+            ParseLog log;
+            cpu_timer timer;
+            model.linkAll(gffs, log, false, threads);
+            timer.stop();
+
+            const double secs = timer.elapsed().wall / 1e9;
+            base = threads == 1 ? secs : base;
+
+            report(string(reverse ? "children before parents, " : "parents before children, ") + 
+                    lexical_cast<string>(threads) + " thread(s)", timer, gffs.size());
+            cout << "   speedup: " << base / secs << "x, held back at most " << model.getPeakOrphans() << " records" << endl;
+        }
+    }
+}
+
+/**
+ * Writes gene, followed by just the given transcripts of it, as GTS::output
+ * does
+ */
+void writeGeneWith(gts::io::TextWriter& out, GFFPtr gene, const GFFList& transcripts, gts::gff::SharedSet& written) {
+
+    gene->write(out, "gts", false);
+
+    BOOST_FOREACH(GFFPtr transcript, transcripts) {
+
+        if (transcript->IsShared() && !written.insert(transcript).second) {
+            continue;
+        }
+
+        transcript->write(out, "gts", true, false, written);
+    }
+
+    out.put('\n');
+}
+
+string readAll(const string& path) {
+
+    std::ifstream in(path.c_str());
+    return string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+/**
+ * Mimics the GTS pipeline: each stage copies every gene into a new model over
+ * the same arena, marking the transcripts it drops, then the pass and fail
+ * files are written
+ */
+void benchStages(const string& path, size_t nbStages) {
+
+    cout << endl << "GFF3 filter stages" << endl
+         << "------------------" << endl;
+
+    GFFModelPtr model = GFFModel::load(path);
+    const size_t nbTranscripts = model->getTotalNbTranscripts();
+    GFFArena& arena = *model->getArena();
+
+    vector<GFFModelPtr> stages(1, model);
+    vector<uint8_t> failed(arena.GetSize(), 0);
+
+    size_t n = 0;
+
+    cpu_timer stageTimer;
+    for(size_t i = 0; i < nbStages; i++) {
+
+        stages.push_back(make_shared<GFFModel>(model->getArena()));
+
+        BOOST_FOREACH(GFFPtr gene, *stages[i]->getGeneList()) {
+
+            GFFPtr newGene = model->getArena()->copy(*gene);
+
+            // Drop every tenth transcript at the first stage
+            BOOST_FOREACH(GFFPtr transcript, gene->GetChildList()) {
+                if (i > 0 || n++ % 10 != 0) {
+                    newGene->addChild(transcript);
+                }
+                else {
+                    failed[arena.keyOf(transcript)] = i + 1;
+                }
+            }
+
+            if (newGene->GetNbChildren() > 0) {
+                stages[i + 1]->addGene(newGene);
+            }
+        }
+    }
+    stageTimer.stop();
+
+    const string savedPass = (bfs::temp_directory_path() / bfs::unique_path("gts_bench_%%%%%%.pass.gff3")).string();
+    const string savedFail = (bfs::temp_directory_path() / bfs::unique_path("gts_bench_%%%%%%.fail.gff3")).string();
+    const string walkedPass = (bfs::temp_directory_path() / bfs::unique_path("gts_bench_%%%%%%.pass.gff3")).string();
+    const string walkedFail = (bfs::temp_directory_path() / bfs::unique_path("gts_bench_%%%%%%.fail.gff3")).string();
+
+    // Save the last stage, then walk the first stage again for the failures
+    GFFModel& last = *stages.back();
+
+    // The first save decodes every attribute, leave that out of the timings
+    model->save(walkedPass, false, "gts");
+
+    cpu_timer saveTimer;
+    last.save(savedPass, true, "gts");
+    {
+        std::ofstream file(savedFail.c_str());
+        gts::io::TextWriter out(file);
+
+        BOOST_FOREACH(GFFPtr gene, *model->getGeneList()) {
+
+            GFFList failedTranscripts;
+            BOOST_FOREACH(GFFPtr transcript, gene->GetChildList()) {
+                if (failed[arena.keyOf(transcript)]) {
+                    failedTranscripts.push_back(transcript);
+                }
+            }
+
+            if (!last.containsGene(gene)) {
+                gene->write(out, "gts", true);
+                out.put('\n');
+            }
+            else if (!failedTranscripts.empty()) {
+                gts::gff::SharedSet written;
+                writeGeneWith(out, gene, failedTranscripts, written);
+            }
+        }
+    }
+    saveTimer.stop();
+
+    // As gts does now: one sorted walk of the first stage writes both
+    cpu_timer walkTimer;
+    {
+        std::ofstream passFile(walkedPass.c_str());
+        std::ofstream failFile(walkedFail.c_str());
+        gts::io::TextWriter pass(passFile);
+        gts::io::TextWriter fail(failFile);
+        gts::gff::SharedSet passWritten;
+        gts::gff::SharedSet failWritten;
+
+        model->sort();
+
+        GFFList passedTranscripts;
+        GFFList failedTranscripts;
+
+        BOOST_FOREACH(GFFPtr gene, *model->getGeneList()) {
+
+            passedTranscripts.clear();
+            failedTranscripts.clear();
+
+            BOOST_FOREACH(GFFPtr transcript, gene->GetChildList()) {
+                (failed[arena.keyOf(transcript)] ? failedTranscripts : passedTranscripts).push_back(transcript);
+            }
+
+            if (!passedTranscripts.empty()) {
+                writeGeneWith(pass, gene, passedTranscripts, passWritten);
+            }
+
+            if (!failedTranscripts.empty()) {
+                writeGeneWith(fail, gene, failedTranscripts, failWritten);
+            }
+        }
+    }
+    walkTimer.stop();
+
+    report(lexical_cast<string>(nbStages) + " stages", stageTimer, nbTranscripts * nbStages);
+    report("Save, then walk for failures", saveTimer, nbTranscripts);
+    report("One sorted walk", walkTimer, nbTranscripts);
+    cout << "   pass files match: " << (readAll(savedPass) == readAll(walkedPass) ? "yes" : "no") << endl;
+
+    bfs::remove(savedPass);
+    bfs::remove(savedFail);
+    bfs::remove(walkedPass);
+    bfs::remove(walkedFail);
+}
+
+void benchLoadScaling(const string& path, uint16_t maxThreads) {
+
+    cout << endl << "GFF3 load thread scaling" << endl
+         << "------------------------" << endl;
+
+    double base = 0.0;
+
+    for(uint16_t threads = 1; threads <= maxThreads; threads *= 2) {
+
+        GFFArena arena;
+        GFFList gffs;
+        cpu_timer timer;
+        GFF::load(GFF3, path, gffs, arena, gts::gff::ANY, threads);
+        timer.stop();
+
+        const double secs = timer.elapsed().wall / 1e9;
+        base = threads == 1 ? secs : base;
+
+        report(lexical_cast<string>(threads) + " thread(s)", timer, gffs.size());
+        cout << "   speedup: " << base / secs << "x" << endl;
+    }
+}
+
+/**
+ * Times writing a gene model, and the same records as a flat list, back out
+ * as GFF3
+ */
+void benchSave(const string& path, size_t nbRecords) {
+
+    cout << endl << "GFF3 save" << endl
+         << "---------" << endl;
+
+    const string out = path + ".out";
+
+    GFFModelPtr model = GFFModel::load(path);
+
+    cpu_timer modelTimer;
+    model->save(out, false);
+    modelTimer.stop();
+
+    GFFArena arena;
+    GFFList gffs;
+    GFF::load(GFF3, path, gffs, arena);
+
+    cpu_timer listTimer;
+    GFF::save(out, gffs);
+    listTimer.stop();
+
+    report("gene model", modelTimer, nbRecords);
+    report("record list", listTimer, nbRecords);
+    cout << "   " << bfs::file_size(out) / (1024 * 1024) << "MB written" << endl;
+
+    bfs::remove(out);
+}
+
+void benchSaveScaling(const string& path, size_t nbRecords, uint16_t maxThreads) {
+
+    cout << endl << "GFF3 save thread scaling" << endl
+         << "------------------------" << endl;
+
+    const string out = path + ".out";
+
+    GFFModelPtr model = GFFModel::load(path);
+
+    // The first save decodes every attribute, leave that out of the timings
+    model->save(out, false, "gts");
+
+    double base = 0.0;
+
+    for(uint16_t threads = 1; threads <= std::max<uint16_t>(maxThreads, 2); threads *= 2) {
+
+        cpu_timer timer;
+        model->save(out, false, "gts", threads);
+        timer.stop();
+
+        const double secs = timer.elapsed().wall / 1e9;
+        base = threads == 1 ? secs : base;
+
+        report(lexical_cast<string>(threads) + " thread(s)", timer, nbRecords);
+        cout << "   speedup: " << base / secs << "x" << endl;
+    }
+
+    bfs::remove(out);
+}
+
+string helpHeader() {
+    return string("\nGTS Benchmarks.\n\n") +
+                  "Times the GTS parsers and writers on a synthetic transdecoder style GFF3 file\n\n" +
+                  "Usage: bench_gts [options]\n\n" +
+                 "\nAvailable options";
+}
+
+int main(int argc, char *argv[]) {
+
+    try {
+        uint32_t nbGenes;
+        uint16_t maxThreads;
+        bool help;
+
+        po::options_description generic_options(helpHeader());
+        generic_options.add_options()
+                ("genes,g", po::value<uint32_t>(&nbGenes)->default_value(250000),
+                    "Number of genes in the synthetic GFF3 file")
+                ("threads,t", po::value<uint16_t>(&maxThreads)->default_value(boost::thread::hardware_concurrency()),
+                    "Maximum number of threads to use in the scaling benchmarks")
+                ("help", po::bool_switch(&help)->default_value(false), "Produce help message")
+                ;
+
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(generic_options).run(), vm);
+        po::notify(vm);
+
+        if (help) {
+            cout << generic_options << endl;
+            return 1;
+        }
+
+        const string path = (bfs::temp_directory_path() / bfs::unique_path("gts_bench_%%%%%%.gff3")).string();
+
+        cout << "Generating synthetic GFF3 with " << nbGenes << " genes: " << path << endl;
+        const size_t nbRecords = makeGff(path, nbGenes);
+
+        benchMemory(path, nbRecords);
+        benchParse(path, nbGenes);
+        benchScan(path);
+        benchLoaders(path, nbGenes);
+        benchLink(path, maxThreads);
+        benchStages(path, 7);
+        benchRootIds(path);
+        benchLoad(path, nbRecords);
+        benchSave(path, nbRecords);
+        benchSaveScaling(path, nbRecords, maxThreads);
+        benchLoadScaling(path, maxThreads);
+        benchSort(path);
+        benchSortedSaves(path, nbRecords, 8);
+
+        bfs::remove(path);
+
+    } catch (boost::exception &e) {
+        std::cerr << boost::diagnostic_information(e);
+        return 4;
+    } catch (exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 5;
+    }
+
+    return 0;
+}
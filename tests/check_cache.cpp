@@ -0,0 +1,185 @@
+//  ********************************************************************
+//  This file is part of GTS (Good Transcript Selector).
+//
+//  GTS is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Portculis is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Portculis.  If not, see <http://www.gnu.org/licenses/>.
+//  *******************************************************************
+
+#define BOOST_TEST_DYN_LINK
+#ifdef STAND_ALONE
+#define BOOST_TEST_MODULE GTS
+#endif
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+using std::cout;
+using std::endl;
+
+#include <boost/filesystem.hpp>
+namespace bfs = boost::filesystem;
+
+#include <cache.hpp>
+using gts::InputCache;
+using gts::gff::GFFModel;
+using gts::gff::GFFModelPtr;
+using gts::gff::GFFPtr;
+
+#include "temp_path.hpp"
+
+BOOST_AUTO_TEST_SUITE(cache)
+
+string writeModel(GFFModel& geneModel) {
+    std::ostringstream out;
+    BOOST_FOREACH(GFFPtr gene, *geneModel.getGeneList()) {
+        gene->write(out, true);
+    }
+    return out.str();
+}
+
+BOOST_AUTO_TEST_CASE(cacheGFFModel) {
+    
+    const bfs::path dir = tempPath("gts_cache_%%%%%%");
+    const string path = (dir / "test_tair10_head.gff").string();
+    
+    bfs::create_directories(dir);
+    bfs::copy_file("resources/test_tair10_head.gff", path);
+    
+    InputCache inputCache((dir / "cache").string());
+    
+    GFFModelPtr parsed = GFFModel::load(path);
+    
+    // First load builds the cache, second load comes from it
+    GFFModelPtr first = inputCache.loadGFFModel(path, 1);
+    BOOST_CHECK(!bfs::is_empty(dir / "cache"));
+    
+    GFFModelPtr cached = inputCache.loadGFFModel(path, 1);
+    
+    BOOST_CHECK(cached->getNbGenes() == 6);
+    BOOST_CHECK(cached->getTotalNbTranscripts() == 8);
+    BOOST_CHECK_EQUAL(writeModel(*cached), writeModel(*parsed));
+    BOOST_CHECK_EQUAL(writeModel(*first), writeModel(*parsed));
+    
+    // Cached records still have their lines
+    BOOST_CHECK(!cached->getGeneList()->at(0)->IsModified());
+    
+    // Dropping the last gene from the source must invalidate the cache
+    {
+        std::ifstream in("resources/test_tair10_head.gff");
+        std::ofstream out(path.c_str());
+        string line;
+        while (std::getline(in, line) && line.find("ID=AT1G01050;") == string::npos) {
+            out << line << endl;
+        }
+    }
+    
+    GFFModelPtr reloaded = inputCache.loadGFFModel(path, 1);
+    BOOST_CHECK(reloaded->getNbGenes() == GFFModel::load(path)->getNbGenes());
+    BOOST_CHECK(reloaded->getNbGenes() < 6);
+    
+    // The rebuilt cache replaced the old one, and left no temporary file
+    BOOST_CHECK(std::distance(bfs::directory_iterator(dir / "cache"), bfs::directory_iterator()) == 1);
+    
+    // A cache that can't be written leaves nothing behind
+    gts::io::BinaryWriter out;
+    out.putString("data");
+    BOOST_CHECK_THROW(out.save((dir / "missing" / "cache").string()), std::exception);
+    BOOST_CHECK(std::distance(bfs::directory_iterator(dir), bfs::directory_iterator()) == 2);
+    
+    bfs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(cacheSharedFeatures) {
+    
+    const bfs::path dir = tempPath("gts_cache_%%%%%%");
+    const string path = (dir / "shared.gff").string();
+    
+    bfs::create_directories(dir);
+    
+    // One exon shared by transcripts of different genes
+    {
+        std::ofstream out(path.c_str());
+        out << "Chr1\ttest\tgene\t100\t900\t.\t+\t.\tID=g1" << endl
+            << "Chr1\ttest\tmRNA\t100\t900\t.\t+\t.\tID=t1;Parent=g1" << endl
+            << "Chr1\ttest\tgene\t100\t800\t.\t+\t.\tID=g2" << endl
+            << "Chr1\ttest\tmRNA\t100\t800\t.\t+\t.\tID=t2;Parent=g2" << endl
+            << "Chr1\ttest\texon\t100\t200\t.\t+\t.\tID=e1;Parent=t1,t2" << endl;
+    }
+    
+    InputCache inputCache((dir / "cache").string());
+    
+    GFFModelPtr parsed = inputCache.loadGFFModel(path, 1);
+    GFFModelPtr cached = inputCache.loadGFFModel(path, 1);
+    
+    BOOST_CHECK_EQUAL(writeModel(*cached), writeModel(*parsed));
+    
+    string g1 = "g1", g2 = "g2";
+    GFFPtr e1 = cached->getGeneById(g1)->GetChildList()[0]->GetChildList()[0];
+    GFFPtr e2 = cached->getGeneById(g2)->GetChildList()[0]->GetChildList()[0];
+    BOOST_CHECK(e1 == e2);
+    BOOST_CHECK(e1->IsShared());
+    
+    bfs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(cacheCorrupt) {
+    
+    const bfs::path dir = tempPath("gts_cache_%%%%%%");
+    const string path = (dir / "test_tair10_head.gff").string();
+    
+    bfs::create_directories(dir);
+    bfs::copy_file("resources/test_tair10_head.gff", path);
+    
+    InputCache inputCache((dir / "cache").string());
+    
+    const string expected = writeModel(*inputCache.loadGFFModel(path, 1));
+    
+    BOOST_REQUIRE(!bfs::is_empty(dir / "cache"));
+    const bfs::path cachePath = bfs::directory_iterator(dir / "cache")->path();
+    
+    string pristine;
+    {
+        std::ifstream in(cachePath.string().c_str(), std::ios::binary);
+        pristine.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+    
+    // Damaged caches can fail while reading or while linking, but either way
+    // the model is rebuilt from the source rather than the run aborting
+    for(size_t i = pristine.size() / 2; i < pristine.size(); i += 7) {
+        
+        string damaged = pristine;
+        damaged[i] = static_cast<char>(~damaged[i]);
+        if (i % 2 == 0) {
+            damaged.resize(i + 1);
+        }
+        
+        {
+            std::ofstream out(cachePath.string().c_str(), std::ios::binary | std::ios::trunc);
+            out << damaged;
+        }
+        
+        GFFModelPtr geneModel;
+        BOOST_REQUIRE_NO_THROW(geneModel = inputCache.loadGFFModel(path, 1));
+        BOOST_CHECK(geneModel->getNbGenes() > 0);
+    }
+    
+    // Some damage still decodes, so only a fresh cache is known to be good
+    bfs::remove(cachePath);
+    inputCache.loadGFFModel(path, 1);
+    BOOST_CHECK_EQUAL(writeModel(*inputCache.loadGFFModel(path, 1)), expected);
+    
+    bfs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -22,7 +22,9 @@
 #endif
 #include <boost/test/unit_test.hpp>
 
+#include <fstream>
 #include <iostream>
+#include <sstream>
 using std::cout;
 using std::endl;
 
@@ -30,6 +32,9 @@ using std::endl;
 
 #include <genbank.hpp>
 using gts::gb::Genbank;
+using gts::ParseLog;
+
+#include "temp_path.hpp"
 
 BOOST_AUTO_TEST_SUITE(genbank)
 
@@ -44,5 +49,57 @@ BOOST_AUTO_TEST_CASE(genBankLoad) {
     Genbank::save("resources/test_make.gb", genbank);
 }
 
+BOOST_AUTO_TEST_CASE(genBankLoadGzip) {
+    
+    std::vector<shared_ptr<Genbank> > plain;
+    Genbank::load("resources/test.gb", plain);
+    
+    std::vector<shared_ptr<Genbank> > compressed;
+    Genbank::load("resources/test.gb.gz", compressed);
+    BOOST_REQUIRE(compressed.size() == plain.size());
+    
+    for(size_t i = 0; i < plain.size(); i++) {
+        std::ostringstream a, b;
+        plain[i]->write(a);
+        compressed[i]->write(b);
+        BOOST_CHECK_EQUAL(a.str(), b.str());
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(genBankLenient) {
+    
+    const string path = tempPath("gts_unknown_block_%%%%%%.gb");
+    {
+        std::ifstream in("resources/test.gb");
+        std::ofstream out(path.c_str());
+        out << "COMMENT     Not a block type we know about" << endl
+            << "            spanning two lines" << endl
+            << in.rdbuf();
+    }
+    
+    std::vector<shared_ptr<Genbank> > strict;
+    BOOST_CHECK_THROW(Genbank::load(path, strict), gts::gb::GenbankException);
+    
+    std::vector<shared_ptr<Genbank> > plain;
+    Genbank::load("resources/test.gb", plain);
+    
+    ParseLog log;
+    std::vector<shared_ptr<Genbank> > lenient;
+    Genbank::load(path, lenient, 1, &log);
+    BOOST_REQUIRE(lenient.size() == plain.size());
+    BOOST_CHECK_EQUAL(log.count("Unknown block type"), 1);
+    BOOST_CHECK_EQUAL(log.getExamples("Unknown block type")[0], "COMMENT");
+    
+    for(size_t i = 0; i < plain.size(); i++) {
+        std::ostringstream a, b;
+        plain[i]->write(a);
+        lenient[i]->write(b);
+        BOOST_CHECK_EQUAL(a.str(), b.str());
+    }
+    
+    boost::filesystem::remove(path);
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
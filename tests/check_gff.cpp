@@ -26,13 +26,35 @@
 using std::cout;
 using std::endl;
 
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <boost/bind/bind.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/random/mersenne_twister.hpp>
+
+#include "temp_path.hpp"
 
 #include <gff.hpp>
+#include <id_filter.hpp>
+using gts::gff::GFF;
+using gts::gff::GFFArena;
+using gts::gff::GFFList;
+using gts::gff::GFFListPtr;
 using gts::gff::GFFModel;
+using gts::gff::GFFPtr;
+using gts::gff::GffType;
+using gts::FrontCodedDictionary;
+using gts::ParseLog;
 
 BOOST_AUTO_TEST_SUITE(gff)
 
+void writeGene(GFFPtr gene, vector<string>& genes) {
+    std::ostringstream out;
+    gene->write(out, true);
+    genes.push_back(out.str());
+}
+
 BOOST_AUTO_TEST_CASE(gffLoad) {
     
     shared_ptr<GFFModel> geneModel = GFFModel::load("resources/test_tair10_head.gff");
@@ -42,5 +64,1439 @@ BOOST_AUTO_TEST_CASE(gffLoad) {
     BOOST_CHECK(1 == 1);
 }
 
+BOOST_AUTO_TEST_CASE(gffParse) {
+    
+    GFFArena arena;
+    
+    GFFPtr gff = GFF::parse(gts::gff::GFF3, 
+            "Chr1\tTAIR10\tCDS\t3760\t3913\t.\t+\t0\tParent=AT1G01010.1,AT1G01010.1-Protein; Name=x;;", arena);
+    
+    BOOST_CHECK(gff->GetSeqId() == "Chr1");
+    BOOST_CHECK(gff->GetSource() == "TAIR10");
+    BOOST_CHECK(gff->GetType() == gts::gff::CDS);
+    BOOST_CHECK(gff->GetStart() == 3760);
+    BOOST_CHECK(gff->GetEnd() == 3913);
+    BOOST_CHECK(gff->GetScore() == -1.0);
+    BOOST_CHECK(gff->GetStrand() == '+');
+    BOOST_CHECK(gff->GetParentId() == "AT1G01010.1,AT1G01010.1-Protein");
+    BOOST_CHECK(gff->GetName() == "x");
+    BOOST_CHECK(gff->GetId().empty());
+    
+    GFFPtr gtf = GFF::parse(gts::gff::GTF, 
+            "s1\tCufflinks\ttranscript\t108\t1541\t1000\t-\t.\tgene_id \"CUFF.1\"; transcript_id \"CUFF.1.1\"; FPKM \"24.5\";", arena);
+    
+    BOOST_CHECK(gtf->GetType() == gts::gff::TRANSCRIPT);
+    BOOST_CHECK(gtf->GetScore() == 1000.0);
+    BOOST_CHECK(gtf->GetStrand() == '-');
+    BOOST_CHECK(gtf->GetGeneId() == "CUFF.1");
+    BOOST_CHECK(gtf->GetTranscriptId() == "CUFF.1.1");
+    BOOST_CHECK(gtf->GetFpkm() == 24.5);
+    
+    BOOST_CHECK_THROW(GFF::parse(gts::gff::GFF3, "Chr1\tTAIR10\tgene\t1\t2", arena), gts::gff::GFFException);
+    
+    // Empty score, strand and phase columns are malformed, not '.'
+    BOOST_CHECK_THROW(GFF::parse(gts::gff::GFF3, "Chr1\tTAIR10\tgene\t1\t2\t\t+\t.\tID=g", arena), gts::gff::GFFException);
+    BOOST_CHECK_THROW(GFF::parse(gts::gff::GFF3, "Chr1\tTAIR10\tgene\t1\t2\t.\t\t.\tID=g", arena), gts::gff::GFFException);
+    BOOST_CHECK_THROW(GFF::parse(gts::gff::GFF3, "Chr1\tTAIR10\tgene\t1\t2\t.\t+\t\tID=g", arena), gts::gff::GFFException);
+}
+
+BOOST_AUTO_TEST_CASE(gffTypesAndKeys) {
+    
+    const char* types[] = { "gene", "mRNA", "miRNA", "protein", "five_prime_utr", "three_prime_utr",
+                            "CDS", "transcript", "exon", "tss", "tts" };
+    
+    for(int i = 0; i < 11; i++) {
+        GffType type = static_cast<GffType>(i);
+        BOOST_CHECK(gts::gff::gffTypeFromString(string(types[i])) == type);
+        BOOST_CHECK(gts::gff::gffTypeFromString(boost::to_upper_copy(string(types[i]))) == type);
+    }
+    
+    BOOST_CHECK(gts::gff::gffTypeFromString(string("")) == gts::gff::OTHER);
+    BOOST_CHECK(gts::gff::gffTypeFromString(string("genes")) == gts::gff::OTHER);
+    BOOST_CHECK(gts::gff::gffTypeFromString(string("ncRNA")) == gts::gff::OTHER);
+    BOOST_CHECK(gts::gff::gffTypeFromString(string("tRNA")) == gts::gff::OTHER);
+    
+    // Keys are only recognised in their own format
+    GFFArena arena;
+    GFFPtr gff = GFF::parse(gts::gff::GFF3, 
+            "c\ts\tgene\t1\t2\t.\t+\t.\tid=g1;PARENT=p1;gene_id=x;Index=3;Gap=M8;Derives_from=d", arena);
+    BOOST_CHECK_EQUAL(gff->GetId(), "g1");
+    BOOST_CHECK_EQUAL(gff->GetParentId(), "p1");
+    BOOST_CHECK_EQUAL(gff->GetGeneId(), "");
+    BOOST_CHECK_EQUAL(gff->GetIndex(), "3");
+    BOOST_CHECK_EQUAL(gff->GetGap(), "M8");
+    BOOST_CHECK_EQUAL(gff->GetDerivesFrom(), "d");
+    
+    GFFPtr gtf = GFF::parse(gts::gff::GTF, 
+            "c\ts\texon\t1\t2\t.\t+\t.\tID \"x\"; gene_id \"g\"; conf_lo \"1.5\"; conf_hi \"2.5\"; coverage \"3\"; exon_number \"4\";", arena);
+    BOOST_CHECK_EQUAL(gtf->GetId(), "");
+    BOOST_CHECK_EQUAL(gtf->GetGeneId(), "g");
+    BOOST_CHECK(gtf->GetConfLo() == 1.5);
+    BOOST_CHECK(gtf->GetConfHigh() == 2.5);
+    BOOST_CHECK(gtf->GetCoverage() == 3.0);
+    BOOST_CHECK(gtf->GetExonNumber() == 4);
+}
+
+BOOST_AUTO_TEST_CASE(gffNumberParsing) {
+    
+    using gts::io::StrRef;
+    
+    const char* ints[] = { "0", "42", "-17", "007", "2147483647", "-2147483648" };
+    BOOST_FOREACH(const char* i, ints) {
+        BOOST_CHECK_EQUAL(gts::io::toInt<int32_t>(StrRef(i, i + strlen(i))), lexical_cast<int32_t>(i));
+    }
+    
+    // Anything unusual is left to lexical_cast, which keeps its behaviour
+    const char* badInts[] = { "", "-", "1.5", "2147483648", " 1", "1a" };
+    BOOST_FOREACH(const char* i, badInts) {
+        int32_t v;
+        BOOST_CHECK(!gts::io::parseInt(StrRef(i, i + strlen(i)), v));
+        BOOST_CHECK_THROW(gts::io::toInt<int32_t>(StrRef(i, i + strlen(i))), boost::bad_lexical_cast);
+        BOOST_CHECK(!gts::io::tryToInt(StrRef(i, i + strlen(i)), v));
+    }
+    
+    // tryToInt still takes what lexical_cast takes
+    const char* plusFive = "+5";
+    int32_t plus = 0;
+    BOOST_CHECK(gts::io::tryToInt(StrRef(plusFive, plusFive + 2), plus));
+    BOOST_CHECK_EQUAL(plus, 5);
+    
+    const char* doubles[] = { "0", "1000", "24.5", "-0.125", ".5", "1.", "1e5", "1.25E-3", 
+                              "45.750320", "0.10000000000000001", "5e-324" };
+    BOOST_FOREACH(const char* d, doubles) {
+        BOOST_CHECK_EQUAL(gts::io::toDouble(StrRef(d, d + strlen(d))), lexical_cast<double>(d));
+    }
+    
+    const char* badDoubles[] = { "", ".", "-", "e5", "1e", "1e400", "1.5x" };
+    BOOST_FOREACH(const char* d, badDoubles) {
+        double v;
+        BOOST_CHECK(!gts::io::parseDouble(StrRef(d, d + strlen(d)), v));
+        BOOST_CHECK(!gts::io::tryToDouble(StrRef(d, d + strlen(d)), v));
+    }
+    
+    // Phase is still read as a single character
+    GFFArena arena;
+    GFFPtr cds = GFF::parse(gts::gff::GFF3, "c\ts\tCDS\t1\t2\t0.5\t+\t2\tID=c1", arena);
+    BOOST_CHECK(cds->GetPhase() == '2');
+    BOOST_CHECK(cds->GetScore() == 0.5);
+}
+
+BOOST_AUTO_TEST_CASE(gffScanKernels) {
+
+    using gts::io::DelimSet;
+    using gts::io::StrRef;
+
+    // Lengths either side of the 16 and 32 byte vector widths
+    string text;
+    for(int i = 0; i < 300; i++) {
+        text += "\t;= \nabcdefg"[(i * 7 + i / 5) % 12];
+    }
+
+    const DelimSet sets[] = { DelimSet("\n"), DelimSet("\t;= \n"), DelimSet("") };
+    const gts::io::ScanKernel kernels[] = { gts::io::SCAN_SCALAR, gts::io::SCAN_SSE2, gts::io::SCAN_AVX2 };
+
+    BOOST_FOREACH(const DelimSet& delims, sets) {
+
+        for(size_t len = 0; len < text.size(); len += 13) {
+
+            const char* b = text.data() + len % 7;
+            const char* e = text.data() + len;
+            b = b > e ? e : b;
+
+            vector<const char*> expected;
+            for(const char* p = b; p != e; p++) {
+                if (delims.contains(*p)) {
+                    expected.push_back(p);
+                }
+            }
+
+            BOOST_FOREACH(gts::io::ScanKernel kernel, kernels) {
+
+                const gts::io::ScanFn fn = gts::io::scanKernel(kernel);
+
+                vector<const char*> all(text.size());
+                BOOST_REQUIRE_EQUAL(fn(b, e, delims, all.empty() ? NULL : &all[0], all.size()), expected.size());
+                for(size_t i = 0; i < expected.size(); i++) {
+                    BOOST_CHECK(all[i] == expected[i]);
+                }
+
+                // Stops once max positions have been found
+                const char* first[3];
+                const size_t nbFirst = fn(b, e, delims, first, 3);
+                BOOST_REQUIRE_EQUAL(nbFirst, std::min(expected.size(), (size_t)3));
+                for(size_t i = 0; i < nbFirst; i++) {
+                    BOOST_CHECK(first[i] == expected[i]);
+                }
+            }
+        }
+    }
+
+    // Splitting must match boost::split, including across scan batches
+    const string line = "a\t\tb" + string(80, '\t') + "c\t" + string(40, 'x') + "\t\td\t";
+    const DelimSet tab("\t");
+    for(int c = 0; c < 2; c++) {
+
+        const bool compress = c == 0;
+
+        vector<string> expected;
+        boost::split(expected, line, boost::is_any_of("\t"),
+                compress ? boost::token_compress_on : boost::token_compress_off);
+
+        vector<StrRef> parts(200);
+        BOOST_REQUIRE_EQUAL(gts::io::split(StrRef(line.data(), line.data() + line.size()), tab, &parts[0], parts.size(), compress),
+                expected.size());
+        for(size_t i = 0; i < expected.size(); i++) {
+            BOOST_CHECK_EQUAL(parts[i].str(), expected[i]);
+        }
+    }
+
+    // Lines are returned just as std::getline would
+    const char* inputs[] = { "", "\n", "a", "a\n", "a\n\nb", "a\nb\n\n" };
+    BOOST_FOREACH(const char* input, inputs) {
+
+        std::istringstream in(input);
+        vector<string> expected;
+        string line;
+        while (std::getline(in, line)) {
+            expected.push_back(line);
+        }
+
+        gts::io::LineReader reader(input, input + strlen(input));
+        vector<string> actual;
+        while (reader.next(line)) {
+            actual.push_back(line);
+        }
+
+        BOOST_CHECK(actual == expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(gffLoadMatchesLineParse) {
+    
+    const string path = "resources/test_tair10_head.gff";
+    
+    GFFArena arena;
+    GFFList loaded;
+    GFF::load(gts::gff::GFF3, path, loaded, arena);
+    
+    GFFList expected;
+    std::ifstream file(path.c_str());
+    string line;
+    while (std::getline(file, line)) {
+        boost::trim(line);
+        if (!line.empty()) {
+            expected.push_back(GFF::parse(gts::gff::GFF3, line, arena));
+        }
+    }
+    
+    BOOST_REQUIRE(loaded.size() == expected.size());
+    
+    for(size_t i = 0; i < loaded.size(); i++) {
+        
+        // Compare the parsed fields rather than the line as read
+        BOOST_CHECK(!loaded[i]->IsModified());
+        loaded[i]->markModified();
+        
+        std::ostringstream a, b;
+        loaded[i]->write(a);
+        expected[i]->write(b);
+        BOOST_CHECK_EQUAL(a.str(), b.str());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(gffLoadThreaded) {
+    
+    const string path = "resources/test_tair10_head.gff";
+    
+    GFFArena arena;
+    GFFList serial;
+    GFF::load(gts::gff::GFF3, path, serial, arena);
+    
+    // Use more threads than we'd sensibly want for a file this size to make sure
+    // chunks get snapped to line boundaries properly
+    for(uint16_t threads = 2; threads <= 16; threads *= 2) {
+        
+        GFFList threaded;
+        GFF::load(gts::gff::GFF3, path, threaded, arena, gts::gff::ANY, threads);
+
+        BOOST_REQUIRE(threaded.size() == serial.size());
+
+        for(size_t i = 0; i < serial.size(); i++) {
+            std::ostringstream a, b;
+            serial[i]->write(a);
+            threaded[i]->write(b);
+            BOOST_CHECK_EQUAL(a.str(), b.str());
+        }
+    }
+    
+    shared_ptr<GFFModel> geneModel = GFFModel::load(path, 4);
+    
+    BOOST_CHECK(geneModel->getNbGenes() == 6);
+    BOOST_CHECK(geneModel->getTotalNbTranscripts() == 8);
+}
+
+
+BOOST_AUTO_TEST_CASE(gffLoadFilter) {
+    
+    const string path = "resources/test_tair10_head.gff";
+    
+    GFFArena arena;
+    GFFList all;
+    GFF::load(gts::gff::GFF3, path, all, arena);
+    
+    gts::gff::GFFFilter filter;
+    filter.addType(gts::gff::MRNA).addType(gts::gff::EXON).addRegion("Chr1", 5000, 9000).addRegion("", 30000, 30100);
+    
+    GFFList expected;
+    BOOST_FOREACH(GFFPtr gff, all) {
+        if ((gff->GetType() == gts::gff::MRNA || gff->GetType() == gts::gff::EXON) &&
+                ((gff->GetStart() <= 9000 && gff->GetEnd() >= 5000) || (gff->GetStart() <= 30100 && gff->GetEnd() >= 30000))) {
+            expected.push_back(gff);
+        }
+    }
+    BOOST_REQUIRE(!expected.empty() && expected.size() < all.size());
+    
+    for(uint16_t threads = 1; threads <= 4; threads *= 2) {
+        
+        GFFList filtered;
+        GFF::load(gts::gff::GFF3, path, filtered, arena, filter, threads);
+        
+        BOOST_REQUIRE_EQUAL(filtered.size(), expected.size());
+        for(size_t i = 0; i < expected.size(); i++) {
+            std::ostringstream a, b;
+            expected[i]->write(a);
+            filtered[i]->write(b);
+            BOOST_CHECK_EQUAL(a.str(), b.str());
+        }
+    }
+    
+    // Sequence ids
+    GFFList chr1, chr2;
+    GFF::load(gts::gff::GFF3, path, chr1, arena, gts::gff::GFFFilter().addSeqId("Chr1"));
+    GFF::load(gts::gff::GFF3, path, chr2, arena, gts::gff::GFFFilter().addSeqId("Chr2").addSeqId("Chr"));
+    BOOST_CHECK_EQUAL(chr1.size(), all.size());
+    BOOST_CHECK(chr2.empty());
+    
+    // Rejected lines are never parsed, but malformed ones still get reported
+    const string line = "Chr1\tTAIR10\tgene\t1\t2";
+    BOOST_CHECK(gts::gff::GFFFilter(gts::gff::MRNA).matches(StrRef(line.data(), line.data() + line.size())) == false);
+    BOOST_CHECK(gts::gff::GFFFilter(gts::gff::MRNA).matches(StrRef(line.data(), line.data() + 12)));
+}
+
+BOOST_AUTO_TEST_CASE(gffLenientLoad) {
+    
+    const string path = "resources/test_tair10_head.gff";
+    const string malformedPath = tempPath("gts_malformed_%%%%%%.gff");
+    
+    const char* COLUMNS = "Incorrect number of columns. Expected 9 columns";
+    const char* COORDS = "Invalid start or end coordinate";
+    
+    // Break a couple of lines after every transcript, and add a transcript with
+    // no gene
+    uint32_t nbProteins = 0;
+    uint32_t nbBroken = 0;
+    {
+        std::ifstream in(path.c_str());
+        std::ofstream out(malformedPath.c_str());
+        
+        string line;
+        while (std::getline(in, line)) {
+            out << line << endl;
+            if (line.find("\tmRNA\t") != string::npos) {
+                out << "Chr1\tTAIR10\texon\t1\t2" << endl
+                    << "Chr1\tTAIR10\texon\tx\t10\t.\t+\t.\tParent=AT1G01010.1" << endl;
+                nbBroken++;
+            }
+            if (line.find("\tprotein\t") != string::npos) {
+                nbProteins++;
+            }
+        }
+        out << "Chr1\tTAIR10\tmRNA\t1\t10\t.\t+\t.\tID=orphan.1;Parent=orphan" << endl;
+    }
+    BOOST_REQUIRE(nbProteins > 0 && nbBroken > 0);
+    
+    GFFArena arena;
+    GFFList gffs;
+    BOOST_CHECK_THROW(GFF::load(gts::gff::GFF3, malformedPath, gffs, arena), gts::gff::GFFException);
+    BOOST_CHECK_THROW(GFFModel::load(malformedPath), gts::gff::GFFException);
+    
+    for(uint16_t threads = 1; threads <= 4; threads *= 2) {
+        
+        ParseLog log(2);
+        shared_ptr<GFFModel> geneModel = GFFModel::load(malformedPath, threads, log, true);
+        
+        BOOST_CHECK(geneModel->getNbGenes() == 6);
+        BOOST_CHECK(geneModel->getTotalNbTranscripts() == 8);
+        
+        BOOST_CHECK_EQUAL(log.count(COLUMNS), nbBroken);
+        BOOST_CHECK_EQUAL(log.count(COORDS), nbBroken);
+        BOOST_CHECK_EQUAL(log.count("Transcript without a parent gene"), 1);
+        BOOST_CHECK_EQUAL(log.count("Ignored protein"), nbProteins);
+        BOOST_CHECK_EQUAL(log.total(), 2 * nbBroken + 1 + nbProteins);
+        
+        // Only the first couple of examples are kept, in file order
+        const vector<string> examples = log.getExamples("Ignored protein");
+        BOOST_REQUIRE_EQUAL(examples.size(), 2);
+        BOOST_CHECK_EQUAL(examples[0], "AT1G01010.1-Protein");
+        BOOST_CHECK_EQUAL(log.getExamples(COLUMNS)[0], "Chr1\tTAIR10\texon\t1\t2");
+        
+        std::ostringstream report;
+        log.report(report);
+        BOOST_CHECK(report.str().find(" - Ignored protein: ") != string::npos);
+    }
+    
+    // Streaming skips the same records
+    ParseLog log;
+    vector<string> streamed;
+    uint32_t nbGenes = GFFModel::stream(malformedPath, boost::bind(&writeGene, boost::placeholders::_1, boost::ref(streamed)), 1, log, true);
+    BOOST_CHECK(nbGenes == 6);
+    BOOST_CHECK_EQUAL(log.count(COLUMNS) + log.count(COORDS), 2 * nbBroken);
+    BOOST_CHECK_EQUAL(log.count("Transcript without a parent gene"), 1);
+    
+    // Ignored records are still summarised when loading strictly
+    ParseLog ignored;
+    GFFModel::load(path, 1, ignored, false);
+    BOOST_CHECK_EQUAL(ignored.total(), ignored.count("Ignored protein"));
+    BOOST_CHECK_EQUAL(ignored.count("Ignored protein"), nbProteins);
+    
+    boost::filesystem::remove(malformedPath);
+}
+
+BOOST_AUTO_TEST_CASE(gffLoadUnsorted) {
+    
+    const string path = "resources/test_tair10_head.gff";
+    const string reversedPath = tempPath("gts_reversed_%%%%%%.gff");
+    
+    // Every child now comes before its parent
+    {
+        std::ifstream in(path.c_str());
+        vector<string> lines;
+        string line;
+        while (std::getline(in, line)) {
+            lines.push_back(line);
+        }
+        
+        std::ofstream out(reversedPath.c_str());
+        for(size_t i = lines.size(); i > 0; i--) {
+            out << lines[i - 1] << endl;
+        }
+    }
+    
+    shared_ptr<GFFModel> sorted = GFFModel::load(path);
+    BOOST_CHECK(sorted->getPeakOrphans() == 0);
+    
+    for(uint16_t threads = 1; threads <= 4; threads *= 2) {
+        
+        shared_ptr<GFFModel> reversed = GFFModel::load(reversedPath, threads);
+        
+        BOOST_CHECK(reversed->getNbGenes() == 6);
+        BOOST_CHECK(reversed->getTotalNbTranscripts() == 8);
+        BOOST_CHECK(reversed->getPeakOrphans() > 0);
+        BOOST_CHECK(reversed->getNbOrphans() == 0);
+        
+        BOOST_FOREACH(GFFPtr gene, *sorted->getGeneList()) {
+            
+            string id = gene->GetId();
+            BOOST_REQUIRE(reversed->containsGene(id));
+            
+            vector<string> a, b;
+            writeGene(gene, a);
+            writeGene(reversed->getGeneById(id), b);
+            BOOST_CHECK_EQUAL(a[0], b[0]);
+        }
+    }
+    
+    // Far too unsorted for the limit
+    ParseLog log;
+    BOOST_CHECK_THROW(GFFModel::load(reversedPath, 1, log, false, 10), gts::gff::GFFException);
+    
+    boost::filesystem::remove(reversedPath);
+}
+
+/**
+ * Writes gff and its descendants in the order they were linked, unlike
+ * GFF::write which sorts them
+ */
+void writeLinked(GFFPtr gff, std::ostream& out) {
+    
+    gff->write(out);
+    
+    BOOST_FOREACH(GFFPtr child, gff->GetChildList()) {
+        writeLinked(child, out);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(gffLinkParallel) {
+    
+    const string path = "resources/test_tair10_head.gff";
+    const string shuffledPath = tempPath("gts_shuffled_%%%%%%.gff");
+    const string duplicatesPath = tempPath("gts_duplicates_%%%%%%.gff");
+    
+    // Interleave the lines so children and parents are all over the place,
+    // then add a record with no parent, and to the second file a duplicate
+    // gene, which forces a serial link
+    {
+        std::ifstream in(path.c_str());
+        vector<string> lines;
+        string line;
+        while (std::getline(in, line)) {
+            lines.push_back(line);
+        }
+        
+        std::ofstream shuffled(shuffledPath.c_str());
+        std::ofstream duplicates(duplicatesPath.c_str());
+        for(size_t j = 0; j < 5; j++) {
+            for(size_t i = 4 - j; i < lines.size(); i += 5) {
+                shuffled << lines[i] << endl;
+                duplicates << lines[i] << endl;
+            }
+        }
+        
+        const string orphan = "Chr1\tTAIR10\texon\t1\t10\t.\t+\t.\tParent=missing.1";
+        shuffled << orphan << endl;
+        duplicates << orphan << endl << lines[0] << endl;
+    }
+    
+    const string paths[] = { path, shuffledPath, duplicatesPath };
+    
+    BOOST_FOREACH(const string& p, paths) {
+        
+        ParseLog serialLog;
+        shared_ptr<GFFModel> serial = GFFModel::load(p, 1, serialLog, true);
+        BOOST_REQUIRE(serial->getNbGenes() == 6);
+        
+        std::ostringstream expected, expectedLog;
+        BOOST_FOREACH(GFFPtr gene, *serial->getGeneList()) {
+            writeLinked(gene, expected);
+        }
+        serialLog.report(expectedLog);
+        
+        for(uint16_t threads = 2; threads <= 4; threads++) {
+            
+            ParseLog log;
+            shared_ptr<GFFModel> parallel = GFFModel::load(p, threads, log, true);
+            
+            BOOST_CHECK_EQUAL(parallel->getNbGenes(), serial->getNbGenes());
+            BOOST_CHECK_EQUAL(parallel->getTotalNbTranscripts(), serial->getTotalNbTranscripts());
+            BOOST_CHECK_EQUAL(parallel->getPeakOrphans(), serial->getPeakOrphans());
+            
+            std::ostringstream linked, linkedLog;
+            BOOST_FOREACH(GFFPtr gene, *parallel->getGeneList()) {
+                writeLinked(gene, linked);
+            }
+            log.report(linkedLog);
+            
+            BOOST_CHECK_EQUAL(linked.str(), expected.str());
+            BOOST_CHECK_EQUAL(linkedLog.str(), expectedLog.str());
+        }
+        
+        // Strict loads fail the same way too
+        if (p != path) {
+            for(uint16_t threads = 1; threads <= 2; threads++) {
+                ParseLog log;
+                try {
+                    GFFModel::load(p, threads, log, false);
+                    BOOST_ERROR("Expected a GFFException");
+                }
+                catch(gts::gff::GFFException& e) {
+                    const string* msg = boost::get_error_info<gts::gff::GFFErrorInfo>(e);
+                    BOOST_REQUIRE(msg != NULL);
+                    BOOST_CHECK_EQUAL(*msg, p == shuffledPath ? 
+                        "Invalid GFF: Could not find parent transcript for GFF entry: " :
+                        "Invalid GFF: Already loaded gene with this Id: AT1G01010");
+                }
+            }
+        }
+    }
+    
+    boost::filesystem::remove(shuffledPath);
+    boost::filesystem::remove(duplicatesPath);
+}
+
+BOOST_AUTO_TEST_CASE(gffSharedFeatures) {
+
+    const string path = tempPath("gts_shared_%%%%%%.gff");
+
+    // The first exon is shared by both transcripts, and turns up before t2
+    const string shared = "Chr1\ttest\texon\t100\t200\t.\t+\t.\tID=e1;Parent=t1,t2";
+    {
+        std::ofstream out(path.c_str());
+        out << "Chr1\ttest\tgene\t100\t900\t.\t+\t.\tID=g1" << endl
+            << "Chr1\ttest\tmRNA\t100\t900\t.\t+\t.\tID=t1;Parent=g1" << endl
+            << shared << endl
+            << "Chr1\ttest\texon\t700\t900\t.\t+\t.\tID=e2;Parent=t1" << endl
+            << "Chr1\ttest\tmRNA\t100\t800\t.\t+\t.\tID=t2;Parent=g1" << endl
+            << "Chr1\ttest\texon\t600\t800\t.\t+\t.\tID=e3;Parent=t2" << endl
+            << "Chr1\ttest\tCDS\t150\t200\t.\t+\t0\tID=c1;Parent=t1,t1-Protein" << endl;
+    }
+
+    for(uint16_t threads = 1; threads <= 2; threads++) {
+
+        ParseLog log;
+        shared_ptr<GFFModel> model = GFFModel::load(path, threads, log, false);
+
+        BOOST_CHECK(log.empty());
+        BOOST_REQUIRE(model->getNbGenes() == 1);
+
+        string id = "g1";
+        GFFPtr gene = model->getGeneById(id);
+        GFFPtr t1 = gene->GetChildMap().at("t1");
+        GFFPtr t2 = gene->GetChildMap().at("t2");
+
+        GFFListPtr exons1 = t1->GetAllOfType(gts::gff::EXON);
+        GFFListPtr exons2 = t2->GetAllOfType(gts::gff::EXON);
+        BOOST_REQUIRE(exons1->size() == 2);
+        BOOST_REQUIRE(exons2->size() == 2);
+
+        // Held once, parented by the transcript it was first attached to
+        BOOST_CHECK((*exons1)[0] == (*exons2)[0]);
+        BOOST_CHECK((*exons1)[0]->IsShared());
+        BOOST_CHECK((*exons1)[0]->GetParent() == t1);
+        BOOST_CHECK_EQUAL(t1->GetAllOfType(gts::gff::CDS)->size(), 1);
+
+        // Written once, with all its parents
+        std::ostringstream out;
+        gene->write(out, true);
+        const string written = out.str();
+
+        const size_t first = written.find(shared + "\n");
+        BOOST_CHECK(first != string::npos);
+        BOOST_CHECK(written.find(shared + "\n", first + 1) == string::npos);
+    }
+
+    // A shared feature missing several parents is only held, and reported,
+    // once
+    {
+        std::ofstream out(path.c_str());
+        out << "Chr1\ttest\texon\t100\t200\t.\t+\t.\tID=e1;Parent=t1,t2,t3" << endl
+            << "Chr1\ttest\texon\t300\t400\t.\t+\t.\tID=e2;Parent=t1,t2" << endl
+            << "Chr1\ttest\tgene\t100\t900\t.\t+\t.\tID=g1" << endl
+            << "Chr1\ttest\tmRNA\t100\t900\t.\t+\t.\tID=t1;Parent=g1" << endl;
+    }
+
+    ParseLog log;
+    shared_ptr<GFFModel> model = GFFModel::load(path, 1, log, true);
+    BOOST_CHECK_EQUAL(model->getPeakOrphans(), 2);
+    BOOST_CHECK_EQUAL(log.count("Feature without a parent transcript"), 2);
+    BOOST_CHECK_EQUAL(log.total(), 2);
+
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(gffCompact) {
+
+    shared_ptr<GFFModel> model = GFFModel::load("resources/test_tair10_head.gff");
+
+    vector<string> before, ids, parentIds;
+    BOOST_FOREACH(GFFPtr gene, *model->getGeneList()) {
+        writeGene(gene, before);
+        GFFListPtr children = gene->GetAllChildren();
+        BOOST_FOREACH(GFFPtr child, *children) {
+            ids.push_back(child->GetId());
+            parentIds.push_back(child->GetParentId());
+        }
+    }
+
+    model->compact();
+
+    vector<string> after;
+    size_t i = 0;
+    BOOST_FOREACH(GFFPtr gene, *model->getGeneList()) {
+        writeGene(gene, after);
+        GFFListPtr children = gene->GetAllChildren();
+        BOOST_FOREACH(GFFPtr child, *children) {
+            BOOST_CHECK_EQUAL(child->GetId(), ids[i]);
+            BOOST_CHECK_EQUAL(child->GetParentId(), parentIds[i]);
+            i++;
+        }
+    }
+
+    BOOST_CHECK(before == after);
+
+    // IDs are rebuilt from the parent, and setting one stops that
+    GFFArena arena;
+    GFFPtr transcript = GFF::parse(gts::gff::GFF3, "c\ts\tmRNA\t1\t90\t.\t+\t.\tID=t1", arena);
+    GFFPtr exon = GFF::parse(gts::gff::GFF3, "c\ts\texon\t1\t50\t.\t+\t.\tID=t1.exon1;Parent=t1", arena);
+    transcript->addChild(exon, true);
+    exon->compact();
+
+    BOOST_CHECK_EQUAL(exon->GetId(), "t1.exon1");
+    BOOST_CHECK_EQUAL(exon->GetParentId(), "t1");
+
+    transcript->SetId("t2");
+    BOOST_CHECK_EQUAL(exon->GetId(), "t2.exon1");
+
+    exon->SetId("e1");
+    BOOST_CHECK_EQUAL(exon->GetId(), "e1");
+    BOOST_CHECK_EQUAL(exon->GetParentId(), "t2");
+
+    GFF copy(*exon);
+    BOOST_CHECK_EQUAL(copy.GetParentId(), "t2");
+
+    // Stored IDs decode back the same, and setting one replaces it
+    GFFList exons(1, exon);
+    GFF::storeIds(exons);
+    BOOST_CHECK_EQUAL(exon->GetId(), "e1");
+
+    exon->SetId("e2");
+    BOOST_CHECK_EQUAL(exon->GetId(), "e2");
+}
+
+BOOST_AUTO_TEST_CASE(gffKeys) {
+
+    shared_ptr<GFFModel> model = GFFModel::load("resources/test_tair10_head.gff");
+    GFFArena& arena = *model->getArena();
+
+    // Every gene and transcript has a distinct key, found again from its id
+    vector<bool> seen(arena.GetSize());
+    BOOST_FOREACH(GFFPtr gene, *model->getGeneList()) {
+
+        BOOST_REQUIRE(gene->GetKey() < seen.size());
+        BOOST_CHECK(!seen[gene->GetKey()]);
+        seen[gene->GetKey()] = true;
+        BOOST_CHECK_EQUAL(arena.findKey(gene->GetId()), gene->GetKey());
+
+        BOOST_FOREACH(GFFPtr transcript, gene->GetChildList()) {
+            BOOST_REQUIRE(transcript->GetKey() < seen.size());
+            BOOST_CHECK(!seen[transcript->GetKey()]);
+            seen[transcript->GetKey()] = true;
+            BOOST_CHECK(model->containsTranscript(transcript));
+        }
+    }
+
+    BOOST_CHECK(arena.findKey("AT1G01010") != gts::StringPool::NONE);
+    BOOST_CHECK(arena.findKey("nothing") == gts::StringPool::NONE);
+    BOOST_CHECK(model->getTotalNbTranscripts() == 8);
+
+    // Copies match by id, so a stage model finds the original gene
+    GFFModel stage(model->getArena());
+    GFFPtr first = model->getGeneByIndex(0);
+    GFFPtr copy = arena.copy(*first);
+    BOOST_CHECK(copy->GetKey() == gts::StringPool::NONE);
+    stage.addGene(copy);
+    BOOST_CHECK(stage.containsGene(first));
+    BOOST_CHECK(!stage.containsGene(model->getGeneByIndex(1)));
+    BOOST_CHECK(copy->GetKey() == first->GetKey());
+
+    // Renaming a gene gives it the key of its new id
+    copy->SetId("renamed");
+    BOOST_CHECK(copy->GetKey() == gts::StringPool::NONE);
+    stage.rebuildGeneMap();
+    BOOST_CHECK(stage.containsGene(string("renamed")));
+    BOOST_CHECK(!stage.containsGene(first));
+}
+
+BOOST_AUTO_TEST_CASE(gffWrite) {
+
+    GFFArena arena;
+    const string gff3 = "Chr1\tTAIR10\tCDS\t3760\t3913\t0.1\t-\t2\tID=cds1;Parent=t1;Name=c1;Note=x y";
+    const string gtf = "c\tCufflinks\texon\t1\t90\t1000\t+\t.\tgene_id \"g1\"; transcript_id \"t1\"; exon_number \"3\"; FPKM \"2.5\"; frac \"-1\";";
+
+    // A tiny buffer so lines are split across flushes
+    std::ostringstream out;
+    {
+        gts::io::TextWriter writer(out, 16);
+        GFF::parse(gts::gff::GFF3, gff3, arena)->write(writer);
+        GFF::parse(gts::gff::GTF, gtf, arena)->write(writer, "gts", false);
+        GFF::parse(gts::gff::GTF, "c\tCufflinks\ttranscript\t1\t90\t.\t+\t.\tgene_id \"g1\"; transcript_id \"t1\";", arena)->write(writer, "gts", false);
+        writer.putInt(-1234567890123LL);
+        writer.put(' ');
+        writer.putDouble(-0.0);
+        writer.put(' ');
+        writer.putDouble(1e20);
+    }
+
+    BOOST_CHECK_EQUAL(out.str(),
+        "Chr1\tTAIR10\tCDS\t3760\t3913\t0.10000000000000001\t-\t2\tID=cds1;Parent=t1;Name=c1;Note=x y\n"
+        "c\tgts\texon\t1\t90\t1000\t+\t.\tgene_id \"g1\";transcript_id \"t1\";exon_number \"3\";FPKM \"2.5\";frac \"-1\"\n"
+        "c\tgts\ttranscript\t1\t90\t.\t+\t.\tgene_id \"g1\";transcript_id \"t1\"\n"
+        "-1234567890123 -0 1e+20");
+}
+
+BOOST_AUTO_TEST_CASE(gffWriteVerbatim) {
+
+    // Attributes we don't model, and numbers we'd format differently
+    const string lines =
+        "Chr1\tTAIR10\tgene\t100\t900\t1.50\t+\t.\tID=g1;Note=x;Ontology_term=GO:0005634\n"
+        "Chr1\tTAIR10\tmRNA\t100\t900\t.\t+\t.\tID=t1;Parent=g1;conf_class=A\n"
+        "Chr1\tTAIR10\texon\t100\t900\t.\t+\t.\tParent=t1\n";
+
+    const boost::filesystem::path path = tempPath("gts_verbatim_%%%%%%.gff3");
+    {
+        std::ofstream out(path.string().c_str());
+        out << lines;
+    }
+
+    GFFArena arena;
+    GFFList gffs;
+    GFF::load(gts::gff::GFF3, path.string(), gffs, arena);
+    boost::filesystem::remove(path);
+
+    BOOST_REQUIRE(gffs.size() == 3);
+    BOOST_CHECK(!gffs[0]->IsModified());
+
+    std::ostringstream out;
+    {
+        gts::io::TextWriter writer(out);
+        BOOST_FOREACH(GFFPtr gff, gffs) {
+            gff->write(writer);
+        }
+
+        // Copies into the arena that keeps the input share the line...
+        GFF* copy = arena.copy(*gffs[1]);
+        BOOST_CHECK(!copy->IsModified());
+        copy->write(writer, "gts", false);
+
+        // ... changing the copy leaves the original as it was read...
+        copy->SetEnd(800);
+        copy->write(writer, "gts", false);
+        gffs[1]->write(writer, "gts", false);
+
+        // ... and copies into any other arena are written from their fields
+        GFFArena other;
+        GFF* outside = other.copy(*gffs[1]);
+        BOOST_CHECK(outside->IsModified());
+        outside->write(writer, "gts", false);
+
+        // Anything set means the line is out of date
+        gffs[2]->SetStart(101);
+        BOOST_CHECK(gffs[2]->IsModified());
+        gffs[2]->write(writer, "gts", false);
+
+        gffs[0]->SetName("G1");
+        gffs[0]->write(writer);
+    }
+
+    BOOST_CHECK_EQUAL(out.str(), lines +
+        "Chr1\tgts\tmRNA\t100\t900\t.\t+\t.\tID=t1;Parent=g1;conf_class=A\n"
+        "Chr1\tgts\tmRNA\t100\t800\t.\t+\t.\tID=t1;Parent=g1\n"
+        "Chr1\tgts\tmRNA\t100\t900\t.\t+\t.\tID=t1;Parent=g1;conf_class=A\n"
+        "Chr1\tgts\tmRNA\t100\t900\t.\t+\t.\tID=t1;Parent=g1\n"
+        "Chr1\tgts\texon\t101\t900\t.\t+\t.\tID=;Parent=t1\n"
+        "Chr1\tTAIR10\tgene\t100\t900\t1.5\t+\t.\tID=g1;Name=G1;Note=x\n");
+}
+
+BOOST_AUTO_TEST_CASE(gffWriteParallel) {
+
+    // Enough genes for several batches per thread
+    const boost::filesystem::path path = tempPath("gts_write_%%%%%%.gff3");
+    {
+        std::ofstream out(path.string().c_str());
+        for(int i = 0; i < 5000; i++) {
+            const string g = "g" + lexical_cast<string>(i);
+            const string s = lexical_cast<string>(i * 100 + 1);
+            const string e = lexical_cast<string>(i * 100 + 90);
+            out << "c\ts\tgene\t" << s << "\t" << e << "\t.\t+\t.\tID=" << g << "\n"
+                << "c\ts\tmRNA\t" << s << "\t" << e << "\t.\t+\t.\tID=" << g << ".t1;Parent=" << g << "\n"
+                << "c\ts\texon\t" << s << "\t" << e << "\t.\t+\t.\tID=" << g << ".t1.exon1;Parent=" << g << ".t1\n";
+            
+            // Some features shared with the gene before, including across batches
+            if (i % 64 == 0 && i > 0) {
+                out << "c\ts\texon\t" << s << "\t" << e << "\t.\t+\t.\tID=shared" << i 
+                    << ";Parent=g" << (i - 1) << ".t1," << g << ".t1\n";
+            }
+        }
+    }
+
+    shared_ptr<GFFModel> model = GFFModel::load(path.string());
+    boost::filesystem::remove(path);
+
+    std::ostringstream out;
+    {
+        gts::io::TextWriter writer(out);
+        model->write(writer, "gts", 1);
+    }
+    const string serial = out.str();
+
+    for(uint16_t threads = 2; threads <= 8; threads *= 2) {
+        std::ostringstream parallel;
+        {
+            gts::io::TextWriter writer(parallel);
+            model->write(writer, "gts", threads);
+        }
+        BOOST_CHECK(serial == parallel.str());
+    }
+
+    // Each shared feature is written once
+    BOOST_CHECK_EQUAL(std::count(serial.begin(), serial.end(), '\n'), 20000 + 78);
+}
+
+BOOST_AUTO_TEST_CASE(gffRootIds) {
+
+    GFFArena arena;
+    GFFPtr transcript = GFF::parse(gts::gff::GFF3, "c\ts\tmRNA\t1\t90\t.\t+\t.\tID=cds.CUFF.1.1|m.1", arena);
+    BOOST_CHECK_EQUAL(transcript->GetRootId(), "CUFF.1.1");
+    
+    // Handles come from the pool given, not the global one
+    gts::StringPool ids;
+    const uint32_t globalSize = gts::StringPool::global().GetSize();
+    const uint32_t rootId = transcript->GetRootIdHandle(ids);
+    BOOST_CHECK_EQUAL(rootId, ids.find("CUFF.1.1"));
+    BOOST_CHECK_EQUAL(gts::StringPool::global().GetSize(), globalSize);
+
+    // Follows the id when it's set
+    transcript->SetId("CUFF.2.1|m.2");
+    BOOST_CHECK_EQUAL(transcript->GetRootId(), "CUFF.2.1");
+
+    transcript->SetId("|cds.CUFF.3.1");
+    BOOST_CHECK_EQUAL(transcript->GetRootId(), "");
+
+    transcript->SetId("CUFF.4.1");
+    BOOST_CHECK_EQUAL(transcript->GetRootId(), "CUFF.4.1");
+    BOOST_CHECK_EQUAL(ids.resolve(transcript->GetRootIdHandle(ids)), "CUFF.4.1");
+    
+    // A handle kept from one pool is never handed out for another, or for
+    // the same pool once it's been cleared
+    gts::StringPool others;
+    others.intern("padding");
+    BOOST_CHECK_EQUAL(others.resolve(transcript->GetRootIdHandle(others)), "CUFF.4.1");
+    BOOST_CHECK_EQUAL(ids.resolve(transcript->GetRootIdHandle(ids)), "CUFF.4.1");
+    ids.clear();
+    ids.intern("padding");
+    BOOST_CHECK_EQUAL(ids.resolve(transcript->GetRootIdHandle(ids)), "CUFF.4.1");
+
+    GFFPtr gtf = GFF::parse(gts::gff::GTF, "c\ts\ttranscript\t1\t90\t.\t+\t.\tgene_id \"g1\"; transcript_id \"asmbl_1|CUFF.1.1\";", arena);
+    BOOST_CHECK_EQUAL(gtf->GetRootTranscriptId(), "CUFF.1.1");
+
+    gtf->SetTranscriptId("CUFF.1.1");
+    BOOST_CHECK_EQUAL(gtf->GetRootTranscriptId(), "CUFF.1.1");
+
+    gtf->SetTranscriptId("a||b");
+    BOOST_CHECK_EQUAL(gtf->GetRootTranscriptId(), "b");
+    BOOST_CHECK_EQUAL(ids.resolve(gtf->GetRootTranscriptIdHandle(ids)), "b");
+
+    gtf->SetTranscriptId("a|b|c");
+    BOOST_CHECK_EQUAL(gtf->GetRootTranscriptId(), "");
+
+    gtf->SetTranscriptId("a|");
+    BOOST_CHECK_EQUAL(gtf->GetRootTranscriptId(), "");
+}
+
+BOOST_AUTO_TEST_CASE(gffFrontCodedDictionary) {
+
+    vector<string> strings;
+    for(int i = 0; i < 100; i++) {
+        strings.push_back("AT1G01010.1.exon" + lexical_cast<string>(i));
+        strings.push_back("AT1G01010.1.exon" + lexical_cast<string>(i));
+    }
+    strings.push_back("");
+    strings.push_back("b");
+
+    FrontCodedDictionary dictionary(strings);
+    BOOST_REQUIRE_EQUAL(dictionary.GetSize(), 102);
+    BOOST_CHECK_EQUAL(strings.size(), 102);
+
+    string buffer;
+    for(uint32_t i = 0; i < strings.size(); i++) {
+        dictionary.decode(i, buffer);
+        BOOST_CHECK_EQUAL(buffer, strings[i]);
+        BOOST_CHECK_EQUAL(dictionary.find(strings[i]), i);
+    }
+
+    BOOST_CHECK(dictionary.find("AT1G01010.1.exon") == FrontCodedDictionary::NONE);
+    BOOST_CHECK(dictionary.find("a") == FrontCodedDictionary::NONE);
+    BOOST_CHECK(dictionary.find("c") == FrontCodedDictionary::NONE);
+
+    // Round trips through the binary format
+    const boost::filesystem::path path = tempPath("gts_ids_%%%%%%");
+    gts::io::BinaryWriter writer;
+    dictionary.writeBinary(writer);
+    writer.save(path.string());
+
+    std::ifstream file(path.string().c_str(), std::ios::binary);
+    const string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+    boost::filesystem::remove(path);
+
+    gts::io::BinaryReader reader(data.data(), data.data() + data.size());
+    FrontCodedDictionary read;
+    read.readBinary(reader);
+
+    BOOST_REQUIRE_EQUAL(read.GetSize(), dictionary.GetSize());
+    for(uint32_t i = 0; i < strings.size(); i++) {
+        read.decode(i, buffer);
+        BOOST_CHECK_EQUAL(buffer, strings[i]);
+    }
+    
+    // Corrupt data is either rejected or still decodes within its bytes
+    size_t nbRejected = 0;
+    for(size_t i = 0; i < data.size(); i++) {
+        
+        const char values[] = { '\x00', '\x7f', '\xff' };
+        for(size_t v = 0; v < sizeof(values); v++) {
+            
+            string corrupt = data;
+            corrupt[i] = values[v];
+            
+            gts::io::BinaryReader corruptReader(corrupt.data(), corrupt.data() + corrupt.size());
+            FrontCodedDictionary corruptRead;
+            
+            try {
+                corruptRead.readBinary(corruptReader);
+            }
+            catch(gts::io::IOException& e) {
+                nbRejected++;
+                continue;
+            }
+            
+            for(uint32_t j = 0; j < corruptRead.GetSize(); j++) {
+                corruptRead.decode(j, buffer);
+                corruptRead.find(buffer);
+            }
+        }
+    }
+    BOOST_CHECK(nbRejected > 0);
+    
+    // A length running off the end, and a prefix longer than the string before
+    const string malformed[] = { 
+        string("\x01\x01\x80", 3), 
+        string("\x02\x04\x01" "a" "\x05\x00", 6) 
+    };
+    BOOST_FOREACH(const string& m, malformed) {
+        gts::io::BinaryReader malformedReader(m.data(), m.data() + m.size());
+        FrontCodedDictionary malformedRead;
+        BOOST_CHECK_THROW(malformedRead.readBinary(malformedReader), gts::io::IOException);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(gffLoadCompressed) {
+    
+    GFFArena arena;
+    GFFList plain;
+    GFF::load(gts::gff::GFF3, "resources/test_tair10_head.gff", plain, arena);
+    
+    // The BGZF file is made of small blocks, so plenty of lines straddle
+    // block boundaries
+    const string paths[] = {
+        "resources/test_tair10_head.gff.gz",
+        "resources/test_tair10_head.gff.bgz"
+    };
+    
+    BOOST_FOREACH(const string& path, paths) {
+        
+        for(uint16_t threads = 1; threads <= 4; threads *= 2) {
+            
+            GFFList compressed;
+            GFF::load(gts::gff::GFF3, path, compressed, arena, gts::gff::ANY, threads);
+
+            BOOST_REQUIRE(compressed.size() == plain.size());
+
+            for(size_t i = 0; i < plain.size(); i++) {
+                std::ostringstream a, b;
+                plain[i]->write(a);
+                compressed[i]->write(b);
+                BOOST_CHECK_EQUAL(a.str(), b.str());
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(gffStream) {
+    
+    const string path = "resources/test_tair10_head.gff";
+    
+    shared_ptr<GFFModel> geneModel = GFFModel::load(path);
+    
+    vector<string> expected;
+    BOOST_FOREACH(GFFPtr gene, *geneModel->getGeneList()) {
+        writeGene(gene, expected);
+    }
+    
+    vector<string> streamed;
+    uint32_t nbGenes = GFFModel::stream(path, boost::bind(&writeGene, boost::placeholders::_1, boost::ref(streamed)));
+    
+    BOOST_CHECK(nbGenes == 6);
+    BOOST_REQUIRE(streamed.size() == expected.size());
+    
+    for(size_t i = 0; i < expected.size(); i++) {
+        BOOST_CHECK_EQUAL(streamed[i], expected[i]);
+    }
+    
+    // Same again with comments and "###" directives between genes
+    const string directivesPath = tempPath("gts_directives_%%%%%%.gff");
+    {
+        std::ifstream in(path.c_str());
+        std::ofstream out(directivesPath.c_str());
+        out << "##gff-version 3" << endl;
+        
+        string line;
+        while (std::getline(in, line)) {
+            if (line.find("\tgene\t") != string::npos) {
+                out << "###" << endl << "# Next gene" << endl;
+            }
+            out << line << endl;
+        }
+        out << "###" << endl;
+    }
+    
+    vector<string> withDirectives;
+    nbGenes = GFFModel::stream(directivesPath, boost::bind(&writeGene, boost::placeholders::_1, boost::ref(withDirectives)));
+    
+    BOOST_CHECK(nbGenes == 6);
+    BOOST_REQUIRE(withDirectives.size() == expected.size());
+    
+    for(size_t i = 0; i < expected.size(); i++) {
+        BOOST_CHECK_EQUAL(withDirectives[i], expected[i]);
+    }
+    
+    boost::filesystem::remove(directivesPath);
+}
+
+BOOST_AUTO_TEST_CASE(gffStreamFilter) {
+    
+    const string path = "resources/test_tair10_head.gff";
+    
+    boost::unordered_set<string> ids;
+    ids.insert("AT1G01020.1");
+    
+    // gff_filter without --stream
+    shared_ptr<GFFModel> geneModel = GFFModel::load(path);
+    GFFModel filtered(geneModel->getArena());
+    gts::filterIds(*geneModel, ids, filtered);
+    
+    const string loadedPath = tempPath("gts_filter_loaded_%%%%%%.gff");
+    filtered.save(loadedPath);
+    
+    // gff_filter with --stream
+    const string streamedPath = tempPath("gts_filter_streamed_%%%%%%.gff");
+    {
+        gts::StreamingIdFilter streamingFilter(ids, streamedPath);
+        GFFModel::stream(path, boost::ref(streamingFilter));
+        
+        BOOST_CHECK(streamingFilter.nbGenesOut == filtered.getNbGenes());
+        BOOST_CHECK(streamingFilter.nbTranscriptsOut == filtered.getTotalNbTranscripts());
+    }
+    
+    std::ifstream loadedFile(loadedPath.c_str());
+    const string loaded((std::istreambuf_iterator<char>(loadedFile)), std::istreambuf_iterator<char>());
+    
+    std::ifstream streamedFile(streamedPath.c_str());
+    const string streamed((std::istreambuf_iterator<char>(streamedFile)), std::istreambuf_iterator<char>());
+    
+    BOOST_CHECK(!loaded.empty());
+    BOOST_CHECK(loaded.find("AT1G01020.1;") == string::npos);
+    BOOST_CHECK_EQUAL(streamed, loaded);
+    
+    boost::filesystem::remove(loadedPath);
+    boost::filesystem::remove(streamedPath);
+}
+
+BOOST_AUTO_TEST_CASE(gffInternedOrdering) {
+    
+    gts::StringPool& pool = gts::StringPool::global();
+    
+    const string chr = "test_pool_chr";
+    const uint32_t handle = pool.intern(chr);
+    BOOST_CHECK(pool.intern(chr.c_str(), chr.c_str() + chr.size()) == handle);
+    BOOST_CHECK_EQUAL(pool.resolve(handle), chr);
+    BOOST_CHECK_EQUAL(pool.resolve(gts::StringPool::EMPTY), "");
+    
+    // Intern in reverse order so handle order disagrees with string order
+    GFFArena arena;
+    GFFList gffs;
+    const char* seqIds[] = { "test_pool_z", "test_pool_m", "test_pool_a" };
+    for(size_t i = 0; i < 3; i++) {
+        GFFPtr gff = arena.create(gts::gff::GFF3);
+        gff->SetSeqId(seqIds[i]);
+        gff->SetStart(10);
+        gff->SetEnd(20);
+        gffs.push_back(gff);
+    }
+    
+    BOOST_CHECK(gffs[0]->GetSeqIdHandle() < gffs[2]->GetSeqIdHandle());
+    
+    std::sort(gffs.begin(), gffs.end(), GFF::GFFOrdering());
+    
+    BOOST_CHECK_EQUAL(gffs[0]->GetSeqId(), "test_pool_a");
+    BOOST_CHECK_EQUAL(gffs[1]->GetSeqId(), "test_pool_m");
+    BOOST_CHECK_EQUAL(gffs[2]->GetSeqId(), "test_pool_z");
+}
+
+void internAll(gts::StringPool& pool, const vector<string>& strings, vector<uint32_t>& handles) {
+    for(size_t i = 0; i < strings.size(); i++) {
+        handles[i] = pool.intern(strings[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(gffInternConcurrent) {
+    
+    // Enough strings for the index, and the table of chunks, to be replaced
+    // while threads are reading them
+    const uint32_t nbDistinct = 4 * gts::StringPool::CHUNK_SIZE * 5;
+    vector<string> strings;
+    for(uint32_t i = 0; i < 2 * nbDistinct; i++) {
+        std::ostringstream ss;
+        ss << "seq" << (i % nbDistinct);
+        strings.push_back(ss.str());
+    }
+    
+    gts::StringPool pool;
+    
+    const size_t nbThreads = 4;
+    vector<vector<uint32_t> > handles(nbThreads, vector<uint32_t>(strings.size()));
+    boost::thread_group workers;
+    for(size_t t = 0; t < nbThreads; t++) {
+        workers.create_thread(boost::bind(&internAll, boost::ref(pool), boost::cref(strings), boost::ref(handles[t])));
+    }
+    workers.join_all();
+    
+    BOOST_CHECK_EQUAL(pool.GetSize(), nbDistinct + 1);
+    for(size_t i = 0; i < strings.size(); i++) {
+        for(size_t t = 1; t < nbThreads; t++) {
+            BOOST_REQUIRE_EQUAL(handles[t][i], handles[0][i]);
+        }
+        BOOST_REQUIRE_EQUAL(pool.resolve(handles[0][i]), strings[i]);
+        BOOST_REQUIRE_EQUAL(pool.find(strings[i]), handles[0][i]);
+    }
+    BOOST_CHECK(pool.find("seq-1") == gts::StringPool::NONE);
+    
+    pool.clear();
+    BOOST_CHECK_EQUAL(pool.GetSize(), 1);
+    BOOST_CHECK(pool.find("seq1") == gts::StringPool::NONE);
+    BOOST_CHECK(pool.intern("seq1") == 1);
+}
+
+string storedName(uint32_t i) {
+    std::ostringstream ss;
+    ss << "exon" << i;
+    return ss.str();
+}
+
+void addStored(gts::IdStore& store, uint32_t nbDictionaries, vector<uint32_t>& bases, boost::atomic<uint32_t>& nbAdded) {
+    
+    for(uint32_t i = 0; i < nbDictionaries; i++) {
+        vector<string> ids(1, storedName(i));
+        bases[i] = store.add(new FrontCodedDictionary(ids));
+        nbAdded.store(i + 1, boost::memory_order_release);
+    }
+}
+
+void decodeStored(const gts::IdStore& store, uint32_t nbDictionaries, const vector<uint32_t>& bases, const boost::atomic<uint32_t>& nbAdded, bool& ok) {
+    
+    string buffer;
+    uint32_t n = 0;
+    
+    while (n < nbDictionaries) {
+        
+        n = nbAdded.load(boost::memory_order_acquire);
+        
+        for(uint32_t i = n > 64 ? n - 64 : 0; i < n; i++) {
+            store.decode(bases[i], buffer);
+            ok = ok && buffer == storedName(i);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(gffIdStore) {
+    
+    // More dictionaries than the store used to have room for, decoded from
+    // while the table of them is replaced
+    const uint32_t nbDictionaries = 5000;
+    
+    gts::IdStore store;
+    vector<uint32_t> bases(nbDictionaries);
+    boost::atomic<uint32_t> nbAdded(0);
+    
+    const size_t nbReaders = 3;
+    bool ok[nbReaders] = { true, true, true };
+    
+    boost::thread_group workers;
+    for(size_t t = 0; t < nbReaders; t++) {
+        workers.create_thread(boost::bind(&decodeStored, boost::cref(store), nbDictionaries, boost::cref(bases), boost::cref(nbAdded), boost::ref(ok[t])));
+    }
+    addStored(store, nbDictionaries, bases, nbAdded);
+    workers.join_all();
+    
+    for(size_t t = 0; t < nbReaders; t++) {
+        BOOST_CHECK(ok[t]);
+    }
+    
+    string buffer;
+    for(uint32_t i = 0; i < nbDictionaries; i++) {
+        BOOST_CHECK_EQUAL(bases[i], i);
+        store.decode(bases[i], buffer);
+        BOOST_REQUIRE_EQUAL(buffer, storedName(i));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(gffSortList) {
+    
+    // Every field of the ordering, negative coordinates and sequence ids
+    // whose handles disagree with their names
+    GFFArena arena;
+    GFFList gffs;
+    const char* seqIds[] = { "test_sort_z", "test_sort_a" };
+    const int32_t coords[][2] = { { -5, 10 }, { 1, 10 }, { 1, 20 }, { 1, 20 }, { 2147483647, 2147483647 } };
+    for(size_t s = 0; s < 2; s++) {
+        for(size_t c = 0; c < 5; c++) {
+            GFFPtr gff = arena.create(gts::gff::GFF3);
+            gff->SetSeqId(seqIds[s]);
+            gff->SetStart(coords[c][0]);
+            gff->SetEnd(coords[c][1]);
+            gff->SetType(c == 3 ? gts::gff::EXON : gts::gff::MRNA);
+            gffs.push_back(gff);
+        }
+    }
+    
+    boost::mt19937 rng(7);
+    for(size_t i = gffs.size(); i > 1; i--) {
+        std::swap(gffs[i - 1], gffs[rng() % i]);
+    }
+    
+    GFFList expected(gffs);
+    std::sort(expected.begin(), expected.end(), GFF::GFFOrdering());
+    
+    GFF::sortList(gffs);
+    BOOST_CHECK(gffs == expected);
+}
+
+BOOST_AUTO_TEST_CASE(gffModelSort) {
+    
+    const string path = "resources/test_tair10_head.gff";
+    
+    // Sorted as save used to, genes up front and children as they're written
+    shared_ptr<GFFModel> legacy = GFFModel::load(path);
+    std::reverse(legacy->getGeneList()->begin(), legacy->getGeneList()->end());
+    std::sort(legacy->getGeneList()->begin(), legacy->getGeneList()->end(), GFF::GFFOrdering());
+    
+    std::ostringstream a;
+    {
+        gts::io::TextWriter writer(a);
+        legacy->write(writer, "gts", 1);
+    }
+    
+    shared_ptr<GFFModel> model = GFFModel::load(path);
+    std::reverse(model->getGeneList()->begin(), model->getGeneList()->end());
+    BOOST_CHECK(!model->isSorted());
+    model->sort();
+    BOOST_CHECK(model->isSorted());
+    
+    std::ostringstream b;
+    {
+        gts::io::TextWriter writer(b);
+        model->write(writer, "gts", 1);
+    }
+    
+    BOOST_CHECK_EQUAL(a.str(), b.str());
+}
+
+BOOST_AUTO_TEST_CASE(gffSparseAttributes) {
+    
+    GFFArena arena;
+    
+    GFFPtr exon = GFF::parse(gts::gff::GTF, 
+            "chr1\tCufflinks\texon\t100\t200\t.\t+\t.\tgene_id \"G1\"; transcript_id \"G1.1\";", arena);
+    
+    BOOST_CHECK_EQUAL(exon->GetGeneId(), "G1");
+    BOOST_CHECK_EQUAL(exon->GetTranscriptId(), "G1.1");
+    BOOST_CHECK_EQUAL(exon->GetName(), "");
+    BOOST_CHECK(exon->GetFpkm() == 0.0);
+    BOOST_CHECK(exon->GetExonNumber() == 0);
+    
+    // Leaf records share an empty child list rather than owning one
+    BOOST_CHECK(exon->GetNbChildren() == 0);
+    BOOST_CHECK(exon->GetChildList().empty());
+    BOOST_CHECK(exon->GetChildMap().empty());
+    
+    exon->SetFpkm(2.5);
+    BOOST_CHECK(exon->GetFpkm() == 2.5);
+    BOOST_CHECK(exon->GetFrac() == 0.0);
+    
+    // Copies keep GFF3 attributes
+    GFFPtr gene = GFF::parse(gts::gff::GFF3, 
+            "chr1\tsrc\tgene\t100\t200\t.\t+\t.\tID=g1;Name=gene1;Note=test", arena);
+    GFFPtr copy = arena.copy(*gene);
+    
+    BOOST_CHECK_EQUAL(copy->GetName(), "gene1");
+    BOOST_CHECK_EQUAL(copy->GetNote(), "test");
+}
+
+BOOST_AUTO_TEST_CASE(gffLazyAttributes) {
+
+    GFFArena arena;
+
+    // Attributes aren't decoded by parse, but numeric ones are checked there
+    // so a bad value is rejected like any other malformed field
+    const string badFpkm = "chr1\tCufflinks\texon\t100\t200\t.\t+\t.\tgene_id \"G1\"; FPKM \"high\"; transcript_id \"G1.1\";";
+    BOOST_CHECK_THROW(GFF::parse(gts::gff::GTF, badFpkm, arena), gts::gff::GFFException);
+    
+    ParseLog log;
+    BOOST_CHECK(GFF::parse(gts::gff::GTF, badFpkm.data(), badFpkm.data() + badFpkm.size(), arena, &log) == NULL);
+    BOOST_CHECK(log.total() == 1);
+    
+    const string badExon = "chr1\tCufflinks\texon\t100\t200\t.\t+\t.\tgene_id \"G1\"; exon_number \"\";";
+    BOOST_CHECK(GFF::parse(gts::gff::GTF, badExon.data(), badExon.data() + badExon.size(), arena, &log) == NULL);
+    BOOST_CHECK(log.total() == 2);
+    
+    GFFPtr gtf = GFF::parse(gts::gff::GTF,
+            "chr1\tCufflinks\texon\t100\t200\t.\t+\t.\tgene_id \"G1\"; FPKM \"2.5\"; exon_number \"3\"; transcript_id \"G1.1\";", arena);
+
+    BOOST_CHECK(gtf->GetType() == gts::gff::EXON);
+    BOOST_CHECK(gtf->GetStart() == 100);
+    BOOST_CHECK_EQUAL(gtf->GetTranscriptId(), "G1.1");
+    BOOST_CHECK_EQUAL(gtf->GetFpkm(), 2.5);
+    BOOST_CHECK_EQUAL(gtf->GetExonNumber(), 3);
+
+    // Values set directly win over the raw attributes, and the last of
+    // repeated keys wins
+    GFFPtr gff = GFF::parse(gts::gff::GFF3,
+            "chr1\tsrc\tmRNA\t100\t200\t.\t+\t.\tID=m1;Name=a;Parent=g1;Name=b", arena);
+
+    gff->SetParentId("g2");
+    BOOST_CHECK_EQUAL(gff->GetParentId(), "g2");
+    BOOST_CHECK_EQUAL(gff->GetName(), "b");
+    BOOST_CHECK_EQUAL(gff->GetId(), "m1");
+
+    std::ostringstream out;
+    gff->write(out);
+    BOOST_CHECK_EQUAL(out.str(), "chr1\tsrc\tmRNA\t100\t200\t.\t+\t.\tID=m1;Parent=g2;Name=b\n");
+}
+
+BOOST_AUTO_TEST_CASE(gffArena) {
+    
+    GFFArena arena;
+    
+    // Enough records to need more than one block
+    GFFPtr gene = arena.create(gts::gff::GFF3);
+    gene->SetId("g1");
+    gene->SetType(gts::gff::GENE);
+    
+    for(uint32_t i = 0; i < 10000; i++) {
+        GFFPtr mrna = arena.create(gts::gff::GFF3);
+        mrna->SetId(string("m") + lexical_cast<string>(i));
+        gene->addChild(mrna);
+    }
+    
+    BOOST_CHECK(arena.GetSize() == 10001);
+    BOOST_CHECK(gene->GetNbChildren() == 10000);
+    BOOST_CHECK(gene->GetChildList()[9999]->GetParent() == gene);
+    BOOST_CHECK(gene->GetChildMap().find("m42")->second->GetId() == "m42");
+    
+    // Filtered records are given straight back
+    arena.create(gts::gff::GFF3);
+    arena.discardLast();
+    BOOST_CHECK(arena.GetSize() == 10001);
+    
+    GFFArena other;
+    GFFPtr adopted = other.copy(*gene);
+    arena.adopt(other);
+    
+    BOOST_CHECK(other.GetSize() == 0);
+    BOOST_CHECK(arena.GetSize() == 10002);
+    BOOST_CHECK_EQUAL(adopted->GetId(), "g1");
+    BOOST_CHECK(adopted->GetNbChildren() == 0);
+    
+    arena.clear();
+    BOOST_CHECK(arena.GetSize() == 0);
+    
+    // Models derived from another share its arena, so records can be moved
+    // between them freely
+    shared_ptr<GFFModel> geneModel = GFFModel::load("resources/test_tair10_head.gff");
+    shared_ptr<GFFModel> derived = boost::make_shared<GFFModel>(geneModel->getArena());
+    
+    derived->addGene(geneModel->getArena()->copy(*geneModel->getGeneByIndex(0)));
+    BOOST_CHECK(derived->getArena() == geneModel->getArena());
+    BOOST_CHECK(geneModel->getArena()->GetSize() == 185);
+}
 
 BOOST_AUTO_TEST_SUITE_END()
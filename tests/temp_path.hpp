@@ -0,0 +1,32 @@
+//  ********************************************************************
+//  This file is part of GTS (Good Transcript Selector).
+//
+//  GTS is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Portculis is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Portculis.  If not, see <http://www.gnu.org/licenses/>.
+//  *******************************************************************
+
+#pragma once
+
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+/**
+ * A unique path in the system temp directory for a scratch file or directory
+ * made by a test.  Each '%' in model is replaced by a random hex digit.  Tests
+ * mustn't write into resources, which may be read only, e.g. under make
+ * distcheck.  Removing what's made there is left to the test.
+ */
+inline std::string tempPath(const std::string& model) {
+    return (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path(model)).string();
+}